@@ -0,0 +1,185 @@
+// Headless pathfinding benchmark.
+// Runs random ground and air queries on the real map and on generated platform maps.
+// It also checks that Pathfinding::LineOfSight agrees with SegmentCast on every map,
+// and fails if it doesn't.
+//
+// Usage: PathfindingBenchmark [--map file.tmx] [--size WIDTHxHEIGHT]... [--queries N] [--seed N]
+
+#define SDL_MAIN_HANDLED
+
+#include "App.h"
+#include "Pathfinding.h"
+#include "PathfindingBenchmark.h"
+
+#include "Defs.h"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+std::unique_ptr<App> app = nullptr;
+
+// ---------- Allocation counting ----------
+// Replacing the global operator new lets us count every allocation done by a search
+namespace
+{
+	uint64 allocationCount = 0;
+}
+
+uint64 GetAllocationCount()
+{
+	return allocationCount;
+}
+
+void *operator new(std::size_t size)
+{
+	++allocationCount;
+	if(void *ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+// ---------- Benchmark ----------
+int main(int argc, char *args[])
+{
+	std::string mapPath = "Assets/Maps/Mountain/Mountain64.tmx";
+	std::vector<iPoint> sizes;
+	int queries = 200;
+	uint seed = 1234;
+	int landmarks = -1;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(args[i], "--map") && i + 1 < argc) mapPath = args[++i];
+		else if(!strcmp(args[i], "--queries") && i + 1 < argc) queries = atoi(args[++i]);
+		else if(!strcmp(args[i], "--seed") && i + 1 < argc) seed = static_cast<uint>(atoi(args[++i]));
+		else if(!strcmp(args[i], "--landmarks") && i + 1 < argc) landmarks = atoi(args[++i]);
+		else if(!strcmp(args[i], "--size") && i + 1 < argc)
+		{
+			iPoint size;
+			if(sscanf(args[++i], "%dx%d", &size.x, &size.y) == 2 && size.x > 2 && size.y > 4)
+				sizes.push_back(size);
+		}
+		else
+		{
+			printf("Usage: %s [--map file.tmx] [--size WIDTHxHEIGHT]... [--queries N] [--seed N] [--landmarks N]\n", args[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if(sizes.empty()) sizes = {{256, 64}, {1000, 250}, {2000, 500}};
+
+	// Modules are only constructed, nothing is awaken.
+	// Pathfinding is the only one used and it doesn't need SDL.
+	app = std::make_unique<App>(argc, args);
+	if(landmarks >= 0) app->pathfinding->SetLandmarkCount(landmarks);
+
+	PathfindingBenchmark benchmark(seed);
+
+	// Every search the module offers goes here
+	benchmark.AddStrategy({
+		"astar", PathfindTerrain::GROUND,
+		[](Pathfinding const &pathfinding, iPoint origin, iPoint destination)
+		{
+			return pathfinding.AStarSearch(origin, destination, PathfindTerrain::GROUND);
+		}
+	});
+	// Same search the enemies run, sliced in small steps and reusing its node records
+	auto slicedSearch = std::make_shared<PathSearch>(app->pathfinding.get());
+	benchmark.AddStrategy({
+		"astar-sliced", PathfindTerrain::GROUND,
+		[slicedSearch](Pathfinding const &pathfinding, iPoint origin, iPoint destination)
+		{
+			slicedSearch->Start(origin, destination, PathfindTerrain::GROUND);
+			while(slicedSearch->Step(pathfinding.GetExpansionsPerFrame()) == SearchStatus::IN_PROGRESS) {}
+			return slicedSearch->TakePath();
+		}
+	});
+	// Same search chasing enemies keep, replanning while the map changes: after the
+	// first path, TILE_EDITS tiles in its middle are closed one after the other and it
+	// replans after each one. Found means there is still a path after every edit.
+	// Only the searches are timed, not the edits nor putting the map back.
+	constexpr int TILE_EDITS = 4;
+	auto chaseSearch = std::make_shared<IncrementalSearch>(app->pathfinding.get());
+	benchmark.AddStrategy({
+		.name = "lpa-edits",
+		.terrain = PathfindTerrain::GROUND,
+		.editSearch = [chaseSearch](Pathfinding &pathfinding, iPoint origin, iPoint destination, BenchmarkStopwatch &stopwatch)
+		{
+			auto finish = [&chaseSearch, &pathfinding, &stopwatch, origin]()
+			{
+				stopwatch.Start();
+				while(chaseSearch->Step(pathfinding.GetExpansionsPerFrame()) == SearchStatus::IN_PROGRESS) {}
+				auto path = chaseSearch->GetPathFrom(origin);
+				stopwatch.Stop();
+				return path;
+			};
+
+			chaseSearch->Start(origin, destination, PathfindTerrain::GROUND);
+			auto path = finish();
+
+			struct TileEdit
+			{
+				iPoint tile;
+				std::array<uchar, TERRAIN_COST_LAYERS> costs;
+			};
+			std::array<TileEdit, TILE_EDITS> edits;
+			int editCount = 0;
+			for(; editCount < TILE_EDITS && path && path->size() > 2; editCount++)
+			{
+				TileEdit &edit = edits[editCount];
+				edit.tile = (*path)[path->size() / 2];
+				for(int layer = 0; layer < TERRAIN_COST_LAYERS; layer++)
+					edit.costs[layer] = pathfinding.SetTerrainCost(edit.tile, layer, BLOCKED_TERRAIN_COST);
+
+				chaseSearch->OnLinksChanged(edit.tile);
+				path = finish();
+			}
+
+			// The map is left as it was for the next query, last edit first
+			for(int i = editCount - 1; i >= 0; i--)
+			{
+				for(int layer = 0; layer < TERRAIN_COST_LAYERS; layer++)
+					pathfinding.SetTerrainCost(edits[i].tile, layer, edits[i].costs[layer]);
+			}
+			chaseSearch->Cancel();
+			return path;
+		}
+	});
+	benchmark.AddStrategy({
+		"jps", PathfindTerrain::AIR,
+		[](Pathfinding const &pathfinding, iPoint origin, iPoint destination)
+		{
+			return pathfinding.JumpPointSearch(origin, destination);
+		}
+	});
+
+	if(!benchmark.Run("Mountain64", benchmark.LoadTmxNavGrid(mapPath), queries))
+		printf("Skipping %s\n", mapPath.c_str());
+
+	for(auto const &size : sizes)
+	{
+		std::string name = std::to_string(size.x) + "x" + std::to_string(size.y);
+		benchmark.Run(name, benchmark.GeneratePlatformMap(size.x, size.y), queries);
+	}
+
+	benchmark.PrintReport();
+
+	int failures = benchmark.GetLineOfSightFailures();
+	if(failures > 0) printf("\nLineOfSight disagreed with SegmentCast on %d maps\n", failures);
+
+	app.reset();
+	return (failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,377 @@
+#include "PathfindingBenchmark.h"
+#include "App.h"
+
+#include "BitMaskNavType.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+#include "PugiXml/src/pugixml.hpp"
+
+namespace
+{
+	template<typename T>
+	T Percentile(std::vector<T> values, double percentile)
+	{
+		if(values.empty()) return T();
+		std::ranges::sort(values);
+		auto index = static_cast<size_t>(percentile * static_cast<double>(values.size() - 1) + 0.5);
+		return values[std::min(index, values.size() - 1)];
+	}
+
+	// The values of the queries whose reachable entry is bReachable
+	template<typename T>
+	std::vector<T> Select(std::vector<T> const &values, std::vector<uchar> const &reachable, bool bReachable)
+	{
+		std::vector<T> ret;
+		for(size_t i = 0; i < values.size() && i < reachable.size(); i++)
+		{
+			if((reachable[i] != 0) == bReachable) ret.push_back(values[i]);
+		}
+		return ret;
+	}
+
+	bool IsGroundNode(CL::NavType type)
+	{
+		using enum CL::NavType;
+		return (type & (SOLO | LEFT | RIGHT | PLATFORM)) != NONE;
+	}
+}
+
+void BenchmarkStopwatch::Start()
+{
+	allocationsAtStart = GetAllocationCount();
+	start = std::chrono::steady_clock::now();
+}
+
+void BenchmarkStopwatch::Stop()
+{
+	auto end = std::chrono::steady_clock::now();
+	allocations += GetAllocationCount() - allocationsAtStart;
+	microseconds += std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+PathfindingBenchmark::PathfindingBenchmark(uint seed) : rng(seed) {}
+
+void PathfindingBenchmark::AddStrategy(BenchmarkStrategy const &strategy)
+{
+	strategies.push_back(strategy);
+}
+
+std::unique_ptr<NavGrid> PathfindingBenchmark::LoadTmxNavGrid(std::string const &path) const
+{
+	pugi::xml_document mapFile;
+	if(auto result = mapFile.load_file(path.c_str()); !result)
+	{
+		printf("Could not load map %s. pugi error: %s\n", path.c_str(), result.description());
+		return nullptr;
+	}
+
+	pugi::xml_node mapNode = mapFile.child("map");
+	int width = mapNode.attribute("width").as_int();
+	int height = mapNode.attribute("height").as_int();
+
+	std::string folder = path.substr(0, path.find_last_of("/\\") + 1);
+
+	// <gid, walkability flags>
+	std::unordered_map<uint, uchar> gidFlags;
+	// <gid, terrain costs>, only for tiles that have any
+	std::unordered_map<uint, std::array<uchar, TERRAIN_COST_LAYERS>> gidCosts;
+	for(auto const &tilesetNode : mapNode.children("tileset"))
+	{
+		uint firstGid = tilesetNode.attribute("firstgid").as_uint();
+
+		// External tilesets live in their own .tsx file
+		pugi::xml_document tsxFile;
+		pugi::xml_node tileset = tilesetNode;
+		if(auto source = tilesetNode.attribute("source"); source)
+		{
+			if(!tsxFile.load_file((folder + source.as_string()).c_str())) continue;
+			tileset = tsxFile.child("tileset");
+		}
+
+		for(auto const &tile : tileset.children("tile"))
+		{
+			uchar flags = TILE_PRESENT;
+			for(auto const &property : tile.child("properties").children("property"))
+			{
+				if(StrEquals(property.attribute("name").as_string(), "Walkability") && property.attribute("value").as_bool())
+					flags |= TILE_WALKABLE;
+				if(StrEquals(property.attribute("name").as_string(), "Terrain") && property.attribute("value").as_bool())
+					flags |= TILE_TERRAIN;
+			}
+			uint gid = firstGid + tile.attribute("id").as_uint();
+			gidFlags[gid] = flags;
+
+			// Same defaults as Map::GetTerrainCosts
+			auto properties = tile.child("properties");
+			std::array<uchar, TERRAIN_COST_LAYERS> costs = {};
+			costs[0] = static_cast<uchar>(std::clamp(properties.find_child_by_attribute("name", TERRAIN_COST_PROPERTIES[0]).attribute("value").as_int(0), 0, 255));
+			for(int i = 1; i < TERRAIN_COST_LAYERS; i++)
+				costs[i] = static_cast<uchar>(std::clamp(properties.find_child_by_attribute("name", TERRAIN_COST_PROPERTIES[i]).attribute("value").as_int(costs[0]), 0, 255));
+			if(std::ranges::any_of(costs, [](uchar cost) { return cost != 0; }))
+				gidCosts[gid] = costs;
+		}
+	}
+
+	std::vector<WalkabilityLayer> layers;
+	for(auto const &layerNode : mapNode.children("layer"))
+	{
+		WalkabilityLayer &layer = layers.emplace_back();
+		layer.width = layerNode.attribute("width").as_int();
+		layer.height = layerNode.attribute("height").as_int();
+		layer.flags.reserve(layer.width * layer.height);
+		if(!gidCosts.empty()) layer.costs.reserve(layer.width * layer.height * TERRAIN_COST_LAYERS);
+
+		for(auto const &tile : layerNode.child("data").children("tile"))
+		{
+			uint gid = tile.attribute("gid").as_uint();
+			if(!gidCosts.empty())
+			{
+				auto costs = gidCosts.find(gid);
+				for(int i = 0; i < TERRAIN_COST_LAYERS; i++)
+					layer.costs.push_back(costs != gidCosts.end() ? costs->second[i] : 0);
+			}
+			if(gid == 0)
+			{
+				layer.flags.push_back(0);
+				continue;
+			}
+			auto it = gidFlags.find(gid);
+			layer.flags.push_back(it != gidFlags.end() ? it->second : TILE_PRESENT);
+		}
+		layer.flags.resize(layer.width * layer.height, 0);
+		if(!gidCosts.empty()) layer.costs.resize(layer.width * layer.height * TERRAIN_COST_LAYERS, 0);
+	}
+
+	return Map::ClassifyWalkability(width, height, layers);
+}
+
+std::unique_ptr<NavGrid> PathfindingBenchmark::GeneratePlatformMap(int width, int height)
+{
+	WalkabilityLayer layer;
+	layer.width = width;
+	layer.height = height;
+	layer.flags.assign(width * height, 0);
+
+	auto set = [&layer](int x, int y, uchar flags)
+	{
+		if(x >= 0 && x < layer.width && y >= 0 && y < layer.height)
+			layer.flags[y * layer.width + x] = flags;
+	};
+	auto randomInt = [this](int min, int max)
+	{
+		return std::uniform_int_distribution<int>(min, max)(rng);
+	};
+
+	// Ground floor: a walkable surface over terrain, with some pits
+	for(int x = 0; x < width; x++)
+	{
+		if(x > 2 && randomInt(0, 99) < 4)
+		{
+			x += randomInt(1, 4);
+			continue;
+		}
+		set(x, height - 2, TILE_PRESENT | TILE_WALKABLE);
+		set(x, height - 1, TILE_PRESENT | TILE_TERRAIN);
+	}
+
+	// Walls standing on the floor
+	for(int i = 0; i < width / 16; i++)
+	{
+		int x = randomInt(0, width - 1);
+		int top = height - 2 - randomInt(1, std::min(6, height - 3));
+		set(x, top, TILE_PRESENT | TILE_WALKABLE);
+		for(int y = top + 1; y < height - 1; y++)
+			set(x, y, TILE_PRESENT | TILE_TERRAIN);
+	}
+
+	// Floating platforms, about one tile every sixty
+	for(int i = 0; i < width * height / 60; i++)
+	{
+		int length = randomInt(2, 10);
+		int x = randomInt(0, width - length);
+		int y = randomInt(2, std::max(2, height - 5));
+		for(int j = 0; j < length; j++)
+			set(x + j, y, TILE_PRESENT | TILE_WALKABLE);
+	}
+
+	return Map::ClassifyWalkability(width, height, {layer});
+}
+
+std::vector<std::pair<iPoint, iPoint>> PathfindingBenchmark::CreateQueries(NavGrid const &navGrid, PathfindTerrain terrain, int queries)
+{
+	std::vector<int> candidates;
+	for(int i = 0; i < navGrid.types.size(); i++)
+	{
+		if(terrain == PathfindTerrain::GROUND && IsGroundNode(navGrid.types[i]))
+			candidates.push_back(i);
+		else if(terrain == PathfindTerrain::AIR && navGrid.types[i] == CL::NavType::NONE)
+			candidates.push_back(i);
+	}
+
+	std::vector<std::pair<iPoint, iPoint>> ret;
+	if(candidates.size() < 2) return ret;
+
+	std::uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+	auto toPoint = [&navGrid](int i) { return iPoint(i % navGrid.width, i / navGrid.width); };
+	for(int i = 0; i < queries; i++)
+		ret.emplace_back(toPoint(candidates[pick(rng)]), toPoint(candidates[pick(rng)]));
+
+	return ret;
+}
+
+std::vector<uchar> PathfindingBenchmark::FindReachable(Pathfinding const &pathfinding, PathfindTerrain terrain, std::vector<std::pair<iPoint, iPoint>> const &queries) const
+{
+	std::vector<uchar> ret(queries.size(), 0);
+	auto reference = std::ranges::find(strategies, terrain, &BenchmarkStrategy::terrain);
+	if(reference == strategies.end() || !reference->search) return ret;
+
+	for(size_t i = 0; i < queries.size(); i++)
+		ret[i] = reference->search(pathfinding, queries[i].first, queries[i].second) ? 1 : 0;
+
+	return ret;
+}
+
+bool PathfindingBenchmark::CheckLineOfSight(Pathfinding const &pathfinding, int rays)
+{
+	// Half of them as short as the aggro radius of the enemies, the rest across the whole map.
+	// Some start and end outside it, some are axis aligned and some have no length.
+	auto width = static_cast<float>(pathfinding.GetWidth());
+	auto height = static_cast<float>(pathfinding.GetHeight());
+	std::uniform_real_distribution<float> x(-4.0f, width + 4.0f);
+	std::uniform_real_distribution<float> y(-4.0f, height + 4.0f);
+	std::uniform_real_distribution<float> aggro(-8.0f, 8.0f);
+
+	std::vector<fPoint> from(rays);
+	std::vector<fPoint> to(rays);
+	for(int i = 0; i < rays; i++)
+	{
+		from[i] = fPoint(x(rng), y(rng));
+		if(i % 2 == 0) to[i] = fPoint(from[i].x + aggro(rng), from[i].y + aggro(rng));
+		else to[i] = fPoint(x(rng), y(rng));
+
+		if(i % 11 == 0) to[i].y = from[i].y;
+		if(i % 13 == 0) to[i].x = from[i].x;
+	}
+
+	std::vector<uchar> batch(rays);
+	auto start = std::chrono::steady_clock::now();
+	pathfinding.LineOfSight(from, to, batch);
+	auto middle = std::chrono::steady_clock::now();
+
+	std::vector<uchar> single(rays);
+	for(int i = 0; i < rays; i++)
+	{
+		float fraction = 0.0f;
+		iPoint hitTile;
+		single[i] = pathfinding.SegmentCast(from[i], to[i], fraction, hitTile) ? 0 : 1;
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	int mismatches = 0;
+	for(int i = 0; i < rays; i++)
+	{
+		if(batch[i] != single[i]) mismatches++;
+	}
+
+	printf("  line of sight: %d rays, %d mismatches, LineOfSight %.0f us, SegmentCast %.0f us\n",
+		   rays, mismatches,
+		   std::chrono::duration<double, std::micro>(middle - start).count(),
+		   std::chrono::duration<double, std::micro>(end - middle).count());
+
+	return mismatches == 0;
+}
+
+bool PathfindingBenchmark::Run(std::string const &mapName, std::unique_ptr<NavGrid> navGrid, int queries)
+{
+	if(!navGrid) return false;
+
+	// Queries are generated before the grid is moved into the module
+	auto groundQueries = CreateQueries(*navGrid, PathfindTerrain::GROUND, queries);
+	auto airQueries = CreateQueries(*navGrid, PathfindTerrain::AIR, queries);
+
+	printf("%s: %dx%d, %zu ground and %zu air queries\n", mapName.c_str(), navGrid->width, navGrid->height, groundQueries.size(), airQueries.size());
+
+	if(!app->pathfinding->SetWalkabilityMap(std::move(navGrid))) return false;
+	Pathfinding const &pathfinding = *app->pathfinding;
+
+	auto groundReachable = FindReachable(pathfinding, PathfindTerrain::GROUND, groundQueries);
+	auto airReachable = FindReachable(pathfinding, PathfindTerrain::AIR, airQueries);
+	printf("  reachable: %td ground, %td air\n", std::ranges::count(groundReachable, 1), std::ranges::count(airReachable, 1));
+
+	if(!CheckLineOfSight(pathfinding, 10000)) lineOfSightFailures++;
+
+	for(auto const &strategy : strategies)
+	{
+		bool bAir = (strategy.terrain == PathfindTerrain::AIR);
+		auto const &strategyQueries = bAir ? airQueries : groundQueries;
+
+		BenchmarkResult &result = results.emplace_back();
+		result.mapName = mapName;
+		result.strategyName = strategy.name;
+		result.reachable = bAir ? airReachable : groundReachable;
+
+		for(size_t i = 0; i < strategyQueries.size(); i++)
+		{
+			auto const &[origin, destination] = strategyQueries[i];
+			BenchmarkStopwatch stopwatch;
+			std::unique_ptr<std::vector<iPoint>> path;
+			if(strategy.editSearch)
+				path = strategy.editSearch(*app->pathfinding, origin, destination, stopwatch);
+			else
+			{
+				stopwatch.Start();
+				path = strategy.search(pathfinding, origin, destination);
+				stopwatch.Stop();
+			}
+
+			if(path) result.found++;
+			if(path && !result.reachable[i]) result.foundUnreachable++;
+			result.expanded.push_back(pathfinding.GetLastSearchStats().expanded);
+			result.microseconds.push_back(stopwatch.microseconds);
+			result.allocations.push_back(stopwatch.allocations);
+		}
+	}
+
+	return true;
+}
+
+int PathfindingBenchmark::GetLineOfSightFailures() const
+{
+	return lineOfSightFailures;
+}
+
+void PathfindingBenchmark::PrintReport() const
+{
+	printf("\n%-16s %-12s %-11s %8s %8s | %-26s | %-32s | %-26s\n",
+		   "map", "strategy", "queries", "count", "found",
+		   "expanded p50/p90/p99/max", "us p50/p90/p99/max", "allocs p50/p90/p99/max");
+
+	for(auto const &result : results)
+	{
+		// Failed searches usually cost the most, so they are kept apart from the rest
+		for(bool bReachable : {true, false})
+		{
+			auto expanded = Select(result.expanded, result.reachable, bReachable);
+			if(expanded.empty()) continue;
+
+			auto microseconds = Select(result.microseconds, result.reachable, bReachable);
+			auto allocations = Select(result.allocations, result.reachable, bReachable);
+			int found = bReachable ? result.found - result.foundUnreachable : result.foundUnreachable;
+
+			printf("%-16s %-12s %-11s %8zu %8d | %5d %6d %6d %6d | %7.1f %7.1f %7.1f %7.1f | %5llu %6llu %6llu %6llu\n",
+				   result.mapName.c_str(), result.strategyName.c_str(), bReachable ? "reachable" : "unreachable",
+				   expanded.size(), found,
+				   Percentile(expanded, 0.5), Percentile(expanded, 0.9),
+				   Percentile(expanded, 0.99), Percentile(expanded, 1.0),
+				   Percentile(microseconds, 0.5), Percentile(microseconds, 0.9),
+				   Percentile(microseconds, 0.99), Percentile(microseconds, 1.0),
+				   Percentile(allocations, 0.5), Percentile(allocations, 0.9),
+				   Percentile(allocations, 0.99), Percentile(allocations, 1.0));
+		}
+	}
+}
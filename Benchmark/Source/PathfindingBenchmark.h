@@ -0,0 +1,102 @@
+#ifndef __PATHFINDINGBENCHMARK_H__
+#define __PATHFINDINGBENCHMARK_H__
+
+#include "Map.h"
+#include "Pathfinding.h"
+
+#include "Defs.h"
+#include "Point.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Number of calls to operator new since the program started.
+// Defined in Main.cpp, where the global allocation functions are replaced.
+uint64 GetAllocationCount();
+
+// Time and allocations of the parts of a query a strategy chooses to measure
+struct BenchmarkStopwatch
+{
+	void Start();
+	void Stop();
+
+	double microseconds = 0.0;
+	uint64 allocations = 0;
+
+private:
+	std::chrono::steady_clock::time_point start;
+	uint64 allocationsAtStart = 0;
+};
+
+using BenchmarkSearch = std::function<std::unique_ptr<std::vector<iPoint>>(Pathfinding const &, iPoint, iPoint)>;
+// Searches that change the map between replans. They get the module to edit it
+// and only measure their replans, so setting up and undoing the edits isn't counted.
+using BenchmarkEditSearch = std::function<std::unique_ptr<std::vector<iPoint>>(Pathfinding &, iPoint, iPoint, BenchmarkStopwatch &)>;
+
+// A search strategy to measure, with either search or editSearch. Every strategy
+// of a given terrain runs the same queries, so their results can be compared directly.
+// The first one of each terrain also decides which queries can be reached,
+// so it has to be an exact search that doesn't edit the map.
+struct BenchmarkStrategy
+{
+	std::string name;
+	PathfindTerrain terrain = PathfindTerrain::GROUND;
+	BenchmarkSearch search;
+	BenchmarkEditSearch editSearch;
+};
+
+struct BenchmarkResult
+{
+	std::string mapName;
+	std::string strategyName;
+	int found = 0;
+	// Paths found for queries the reference strategy couldn't reach, 0 unless a strategy is wrong
+	int foundUnreachable = 0;
+	// One entry per query in every array
+	std::vector<uchar> reachable;
+	std::vector<int> expanded;
+	std::vector<double> microseconds;
+	std::vector<uint64> allocations;
+};
+
+class PathfindingBenchmark
+{
+public:
+	explicit PathfindingBenchmark(uint seed);
+
+	void AddStrategy(BenchmarkStrategy const &strategy);
+
+	// --- Nav grids
+	// Reads the walkability properties of a Tiled map without loading textures or colliders
+	std::unique_ptr<NavGrid> LoadTmxNavGrid(std::string const &path) const;
+	// Random platforms over a ground floor with pits and walls
+	std::unique_ptr<NavGrid> GeneratePlatformMap(int width, int height);
+
+	// Runs every strategy over the same random queries.
+	// Ground maps have no jump links, so many ground queries can't be reached and
+	// the report shows the reachable and unreachable ones apart.
+	bool Run(std::string const &mapName, std::unique_ptr<NavGrid> navGrid, int queries);
+
+	void PrintReport() const;
+	// Maps where LineOfSight and SegmentCast didn't agree on every ray
+	int GetLineOfSightFailures() const;
+
+private:
+	std::vector<std::pair<iPoint, iPoint>> CreateQueries(NavGrid const &navGrid, PathfindTerrain terrain, int queries);
+	// 1 for every query the first strategy of the terrain finds a path for
+	std::vector<uchar> FindReachable(Pathfinding const &pathfinding, PathfindTerrain terrain, std::vector<std::pair<iPoint, iPoint>> const &queries) const;
+	// Casts random rays with Pathfinding::LineOfSight and one by one with SegmentCast.
+	// Both have to agree on every ray. Prints the mismatches and the time of each.
+	bool CheckLineOfSight(Pathfinding const &pathfinding, int rays);
+
+	std::mt19937 rng;
+	std::vector<BenchmarkStrategy> strategies;
+	std::vector<BenchmarkResult> results;
+	int lineOfSightFailures = 0;
+};
+
+#endif // __PATHFINDINGBENCHMARK_H__
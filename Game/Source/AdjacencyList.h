@@ -6,6 +6,17 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <climits>
+#include <functional>
+#include <numeric>
+#include <span>
+#include <unordered_map>
+
+struct GraphEdge
+{
+	int destination = -1;
+	int weight = 1;
+};
 
 template <typename T>
 struct Vertex
@@ -14,31 +25,29 @@ public:
 	explicit Vertex() = default;
 	explicit Vertex(T name) : value(name) {};
 
-	int AddEdge(int destination)
-	{
-		// Check if destination is already on the array
-		for(auto i = 0; auto const &elem : edges)
-		{
-			if(elem == destination)
-				return i;
-			i++;
-		}
-		// If it's not, add it
-		edges.push_back(destination);
-		return static_cast<int>(edges.size()) - 1;
-	}
-
 	T value;
-	std::vector<int> edges;
+	// Only filled while the graph is not frozen
+	std::vector<GraphEdge> edges;
 };
 
 /* Directed Graph */
-template <typename T>
+// Vertices are found by value through a hash index, and edges are deduplicated
+// the same way, so building a graph is linear in its size.
+// Freeze() packs every edge in a single array (CSR), which is what the
+// searches walk. Adding to a frozen graph unpacks it again.
+template <typename T, typename Hash = std::hash<T>, typename KeyEqual = std::equal_to<T>>
 class AdjacencyList
 {
 public:
 	using graph2d = std::vector<Vertex<T>>;
 
+	// A vertex and the edges that leave it, frozen or not
+	struct VertexView
+	{
+		T const &value;
+		std::span<const GraphEdge> edges;
+	};
+
 	AdjacencyList() = default;
 	~AdjacencyList() = default;
 
@@ -47,65 +56,229 @@ public:
 		if(auto i = GetIndex(value); i >= 0)
 			return i;
 
+		vertexIndex.try_emplace(value, static_cast<int>(graph.size()));
 		graph.push_back(Vertex<T>(value));
+		if(bFrozen) edgeOffsets.push_back(edgeOffsets.back());
 		return static_cast<int>(graph.size()) - 1;
 	}
 
-	int AddEdge(T origin, T destination)
+	// Returns the position of the edge in the origin's list.
+	// An edge that already exists keeps the lowest of both weights.
+	int AddEdge(T origin, T destination, int weight = 1)
+	{
+		int iOrigin = AddVertex(origin);
+		int iDestination = AddVertex(destination);
+		return AddEdgeByIndex(iOrigin, iDestination, weight);
+	}
+
+	// Same as AddEdge, with the indices of vertices that already exist
+	int AddEdgeByIndex(int origin, int destination, int weight = 1)
 	{
-		auto iEdge = GetIndex(destination);
+		if(bFrozen) Thaw();
 
-		// If destination does not exist in graph
-		if(iEdge == -1)
+		auto &edges = graph[origin].edges;
+		auto [it, bInserted] = edgeIndex.try_emplace(EdgeKey(origin, destination), static_cast<int>(edges.size()));
+		if(bInserted)
 		{
-			// Add the Vertex and update iEdge value with the new index
-			iEdge = AddVertex(destination);
+			edges.push_back({destination, weight});
+			edgeCount++;
 		}
+		else edges[it->second].weight = std::min(edges[it->second].weight, weight);
 
-		auto v = At(origin);
-		// Add the edge to the Vertex array
-		return v->AddEdge(iEdge);
+		return it->second;
 	}
 
 	// Returns index if action is on the array, -1 if no match
-	int GetIndex(T value) const
+	int GetIndex(T const &value) const
 	{
-		for(int i = 0; auto const &elem : graph)
-		{
-			if(elem.value == value)
-				return i;
-			i++;
-		}
+		if(auto it = vertexIndex.find(value); it != vertexIndex.end())
+			return it->second;
 		return -1;
 	}
 
-	// Returns iterator to element, iterator == graph.last() if no match
-	graph2d::iterator Find(T value)
+	// Returns iterator to element, iterator == graph.end() if no match.
+	// Use GetEdges for its edges, they aren't in the vertex once frozen.
+	graph2d::const_iterator Find(T const &value) const
 	{
-		if(auto it = std::ranges::find_if(graph.begin(), graph.end(),
-										  [value](Vertex<T> const &v)
-										  {
-											  return v.value == value;
-										  }
-		); it != graph.end())
-			return it;
+		if(auto i = GetIndex(value); i >= 0)
+			return graph.begin() + i;
 
 		return graph.end();
 	}
 
-	// Returns vertex of action, adds vertex if no match
-	Vertex<T> *At(T value)
+	// Returns vertex of action, adds vertex if no match.
+	// Read only, edges are added through AddEdge so the index stays right.
+	VertexView At(T value)
+	{
+		int index = AddVertex(value);
+		return {graph[index].value, GetEdges(index)};
+	}
+
+	T const &GetValue(int index) const
+	{
+		return graph[index].value;
+	}
+
+	int GetVertexCount() const
+	{
+		return static_cast<int>(graph.size());
+	}
+
+	int GetEdgeCount() const
+	{
+		return edgeCount;
+	}
+
+	bool IsFrozen() const
+	{
+		return bFrozen;
+	}
+
+	// Edges that leave vertex index, in the order they were added
+	std::span<const GraphEdge> GetEdges(int index) const
+	{
+		if(!bFrozen) return graph[index].edges;
+		return std::span<const GraphEdge>(frozenEdges.data() + edgeOffsets[index], frozenEdges.data() + edgeOffsets[index + 1]);
+	}
+
+	// Packs the edges of every vertex one after the other. The hash index of the
+	// edges is dropped, vertices can still be looked up by value.
+	void Freeze()
+	{
+		if(bFrozen) return;
+
+		edgeOffsets.assign(graph.size() + 1, 0);
+		for(int i = 0; i < graph.size(); i++)
+			edgeOffsets[i + 1] = edgeOffsets[i] + static_cast<int>(graph[i].edges.size());
+
+		frozenEdges.clear();
+		frozenEdges.reserve(edgeCount);
+		for(auto &vertex : graph)
+		{
+			frozenEdges.insert(frozenEdges.end(), vertex.edges.begin(), vertex.edges.end());
+			std::vector<GraphEdge>().swap(vertex.edges);
+		}
+
+		edgeIndex = {};
+		bFrozen = true;
+	}
+
+	// ------ Searches, only on a frozen graph
+	// Number of edges from source to every vertex, INT_MAX if it can't be reached.
+	// parents, if not null, gets the vertex each one was reached from. The source is its own parent.
+	bool BreadthFirst(int source, std::vector<int> &hops, std::vector<int> *parents = nullptr) const
+	{
+		if(!bFrozen || source < 0 || source >= graph.size()) return false;
+
+		hops.assign(graph.size(), INT_MAX);
+		if(parents) parents->assign(graph.size(), -1);
+
+		// hops doubles as the visited set, so the queue is a plain vector read in order
+		std::vector<int> queue;
+		queue.reserve(graph.size());
+		queue.push_back(source);
+		hops[source] = 0;
+		if(parents) (*parents)[source] = source;
+
+		for(int head = 0; head < queue.size(); head++)
+		{
+			int current = queue[head];
+			for(auto const &edge : GetEdges(current))
+			{
+				if(hops[edge.destination] != INT_MAX) continue;
+				hops[edge.destination] = hops[current] + 1;
+				if(parents) (*parents)[edge.destination] = current;
+				queue.push_back(edge.destination);
+			}
+		}
+		return true;
+	}
+
+	// Sum of the weights of the cheapest way from source to every vertex, INT_MAX if it
+	// can't be reached. Weights must not be negative. parents works as in BreadthFirst.
+	bool Dijkstra(int source, std::vector<int> &distances, std::vector<int> *parents = nullptr) const
+	{
+		if(!bFrozen || source < 0 || source >= graph.size()) return false;
+
+		distances.assign(graph.size(), INT_MAX);
+		if(parents) parents->assign(graph.size(), -1);
+
+		// <distance, vertex>, smallest distance on top
+		std::vector<std::pair<int, int>> open;
+		open.emplace_back(0, source);
+		distances[source] = 0;
+		if(parents) (*parents)[source] = source;
+
+		while(!open.empty())
+		{
+			std::ranges::pop_heap(open, std::greater<>());
+			auto [distance, current] = open.back();
+			open.pop_back();
+
+			// Stale entry, the vertex was already reached with a better distance
+			if(distance > distances[current]) continue;
+
+			for(auto const &edge : GetEdges(current))
+			{
+				int newDistance = distance + edge.weight;
+				if(newDistance >= distances[edge.destination]) continue;
+				distances[edge.destination] = newDistance;
+				if(parents) (*parents)[edge.destination] = current;
+				open.emplace_back(newDistance, edge.destination);
+				std::ranges::push_heap(open, std::greater<>());
+			}
+		}
+		return true;
+	}
+
+	// Vertices from the source of a search to target, following its parents. Empty if target wasn't reached.
+	static std::vector<int> GetPath(std::vector<int> const &parents, int target)
 	{
-		for(int i = 0; auto const &elem : graph)
+		std::vector<int> path;
+		if(target < 0 || target >= parents.size() || parents[target] < 0) return path;
+
+		for(int i = target; ; i = parents[i])
 		{
-			if(elem.value == value)
-				return &graph[i];
-			i++;
+			path.push_back(i);
+			if(parents[i] == i) break;
 		}
-		return &graph[AddVertex(value)];
+		std::ranges::reverse(path);
+		return path;
 	}
 
 private:
+	static uint64 EdgeKey(int origin, int destination)
+	{
+		return (static_cast<uint64>(static_cast<uint32>(origin)) << 32) | static_cast<uint32>(destination);
+	}
+
+	// Moves the packed edges back to their vertices so more can be added
+	void Thaw()
+	{
+		edgeIndex.reserve(frozenEdges.size());
+		for(int i = 0; i < graph.size(); i++)
+		{
+			auto edges = GetEdges(i);
+			graph[i].edges.assign(edges.begin(), edges.end());
+			for(int j = 0; j < edges.size(); j++)
+				edgeIndex.try_emplace(EdgeKey(i, edges[j].destination), j);
+		}
+
+		std::vector<GraphEdge>().swap(frozenEdges);
+		std::vector<int>().swap(edgeOffsets);
+		bFrozen = false;
+	}
+
 	std::vector<Vertex<T>> graph;
+	// <value, vertex index>
+	std::unordered_map<T, int, Hash, KeyEqual> vertexIndex;
+	// <origin and destination, position in the origin's edges>
+	std::unordered_map<uint64, int> edgeIndex;
+	int edgeCount = 0;
+
+	// CSR form: the edges of vertex i are frozenEdges[edgeOffsets[i]] .. frozenEdges[edgeOffsets[i + 1]]
+	bool bFrozen = false;
+	std::vector<int> edgeOffsets;
+	std::vector<GraphEdge> frozenEdges;
 };
 #endif	// __ADJACENCYLIST_H__
@@ -11,6 +11,8 @@
 #include "Fonts.h"
 #include "UI.h"
 #include "Pathfinding.h"
+#include "ProjectileManager.h"
+#include "FrameBudget.h"
 
 #include "Defs.h"
 #include "Log.h"
@@ -32,9 +34,11 @@ App::App(int argc, char* args[]) : argc(argc), args(args)
 	pathfinding = std::make_unique<Pathfinding>();
 	scene = std::make_unique<Scene>();
 	entityManager = std::make_unique<EntityManager>();
+	projectiles = std::make_unique<ProjectileManager>();
 	map = std::make_unique<Map>();
 	fonts = std::make_unique<Fonts>();
 	ui = std::make_unique<UI>();
+	budget = std::make_unique<FrameBudget>();
 
 	// Ordered for awake / Start / Update
 	// Reverse order of CleanUp
@@ -46,6 +50,7 @@ App::App(int argc, char* args[]) : argc(argc), args(args)
 	AddModule(pathfinding.get());
 	AddModule(scene.get());
 	AddModule(entityManager.get());
+	AddModule(projectiles.get());
 	AddModule(map.get());
 	AddModule(fonts.get());
 	AddModule(ui.get());
@@ -69,6 +74,7 @@ bool App::Awake()
 	if(!LoadConfig()) return false;
 
 	title = configNode.child("app").child("title").child_value(); 
+	budget->Load(configNode.child("app").child("budget"));
 
 	for(auto const &item : modules)
 	{
@@ -134,14 +140,32 @@ bool App::LoadConfig()
 // ---------------------------------------------
 void App::PrepareUpdate()
 {
+	uint64 now = SDL_GetPerformanceCounter();
+	if(lastFrameCounter != 0)
+		dt = static_cast<float>(now - lastFrameCounter) / static_cast<float>(SDL_GetPerformanceFrequency());
+	lastFrameCounter = now;
+	frames++;
+
+	// Recordings and replays must step the world the same way, whatever the real frame time was
+	if(input->IsFixedTimestep()) dt = physics->GetFixedStep();
+
+	budget->SetLocked(input->IsFixedTimestep());
+	budget->BeginFrame();
 }
 
 // ---------------------------------------------
 void App::FinishUpdate()
 {
+	// Saving and loading read and move bodies, so the step of this frame has to be done
+	if (loadGameRequested || saveGameRequested || resetLevelRequested) physics->WaitForStep();
+
 	if (loadGameRequested) LoadFromFile();
 	if (saveGameRequested) SaveToFile();
 	if(resetLevelRequested) entityManager->RestartLevel();
+
+	// The FPS cap and vsync waits aren't work
+	budget->AddIdleTime(render->name, render->GetIdleTime());
+	budget->EndFrame(render->GetFrameTime());
 }
 
 // Call modules before each loop iteration
@@ -150,7 +174,9 @@ bool App::PreUpdate()
 	for(auto const &item : modules)
 	{
 		if(!item->active) continue;
+		uint64 start = SDL_GetPerformanceCounter();
 		if(!item->PreUpdate()) return false;
+		budget->AddCost(item->name, start);
 	}
 
 	return true;
@@ -162,7 +188,9 @@ bool App::DoUpdate()
 	for(auto const &item : modules)
 	{
 		if(!item->active) continue;
+		uint64 start = SDL_GetPerformanceCounter();
 		if(!item->Update(dt)) return false;
+		budget->AddCost(item->name, start);
 	}
 
 	return true;
@@ -174,7 +202,9 @@ bool App::PostUpdate()
 	for(auto const &item : modules)
 	{
 		if(!item->active) continue;
+		uint64 start = SDL_GetPerformanceCounter();
 		if(!item->PostUpdate()) return false;
+		budget->AddCost(item->name, start);
 	}
 
 	return true;
@@ -335,6 +365,9 @@ bool App::SaveAttributeToConfig(std::string const &moduleName, std::string const
 
 bool App::DoPaused()
 {
+	// Let the step sent before pausing finish, the world stays idle while paused
+	physics->WaitForStep();
+
 	// PreUpdate
 	int phase = 1;
 	input->Pause(phase);
@@ -385,6 +418,11 @@ uint App::GetLevelNumber() const
 	return levelNumber;
 }
 
+float App::GetDt() const
+{
+	return dt;
+}
+
 bool App::AppendFragment(pugi::xml_node target, const char *data) const
 {
 	pugi::xml_document doc;
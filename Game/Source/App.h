@@ -29,6 +29,8 @@ class Physics;
 class Fonts;
 class UI;
 class Pathfinding;
+class ProjectileManager;
+class FrameBudget;
 
 template <typename... Args>
 std::string AddSaveData(std::string_view format, Args&&... args)
@@ -69,6 +71,8 @@ public:
 	std::string GetTitle() const;
 	std::string GetOrganization() const;
 	uint GetLevelNumber() const;
+	// Seconds since the previous frame started
+	float GetDt() const;
 
 	bool AppendFragment(pugi::xml_node target, const char *data) const;
 	
@@ -102,6 +106,10 @@ public:
 	std::unique_ptr<Fonts> fonts;
 	std::unique_ptr<UI> ui;
 	std::unique_ptr<Pathfinding> pathfinding;
+	std::unique_ptr<ProjectileManager> projectiles;
+
+	// Not a module, it times them
+	std::unique_ptr<FrameBudget> budget;
 
 private:
 
@@ -137,7 +145,8 @@ private:
 	pugi::xml_node configNode;
 
 	uint frames = 0;
-	float dt;
+	float dt = 0.0f;
+	uint64 lastFrameCounter = 0;
 
 	bool saveGameRequested;
 	bool loadGameRequested;
@@ -2,10 +2,13 @@
 #include "App.h"
 
 #include "Render.h"
+#include "EntityManager.h"
+#include "ProjectileManager.h"
 
 #include "Log.h"
 
 #include <regex>
+#include <format>
 
 
 constexpr uint Character_SIZE = 30;
@@ -29,12 +32,12 @@ void Character::SetPaths()
 
 void Character::InitializeTexture() const
 {
-	if(!texture) return;
+	if(!GetAnimation()) return;
 
-	if(!texture->Start("idle"))
+	if(!GetAnimation()->Start("idle"))
 		LOG("Couldnt start anim");
-	if(texture->GetAnimStyle() != AnimIteration::LOOP_FROM_START)
-		texture->SetAnimStyle(AnimIteration::LOOP_FROM_START);
+	if(GetAnimation()->GetAnimStyle() != AnimIteration::LOOP_FROM_START)
+		GetAnimation()->SetAnimStyle(AnimIteration::LOOP_FROM_START);
 }
 
 //---------- Create character
@@ -44,12 +47,19 @@ bool Character::Start()
 	SpawnEntity();
 	InitializeTexture();
 
+	// Projectiles are drawn with the animation of the same name
+	if(GetAnimation())
+	{
+		for(auto const &[pName, projectileType] : projectileTypes)
+			app->projectiles->SetProjectileFrames(projectileType, GetAnimation()->GetAnim(pName));
+	}
+
 	return true;
 }
 
 void Character::AddTexturesAndAnimationFrames()
 {
-	texture = std::make_unique<Animation>();
+	GetAnimation() = std::make_unique<Animation>();
 	
 	std::string entityFolder = "";
 	if(!CreateEntityPath(entityFolder)) return;
@@ -61,7 +71,7 @@ void Character::AddTexturesAndAnimationFrames()
 		.y = animDataNode.child("properties").attribute("pivoty").as_int()
 	};
 
-	texture->setPivot(textureOffset);
+	GetAnimation()->setPivot(textureOffset);
 	
 	struct dirent **folderList;
 	const char *dirPath = entityFolder.c_str();
@@ -101,12 +111,12 @@ void Character::AddTexturesAndAnimationFrames()
 			action[0] = std::tolower(action[0], std::locale());
 
 			//if it's not the first frame with such name we continue looping
-			if(texture->AddFrame(framesPath.c_str(), action) != 1) [[likely]]
+			if(GetAnimation()->AddFrame(framesPath.c_str(), action) != 1) [[likely]]
 				continue;
 
 			//if it's the first frame we set the action animation parameters 
 			// (or default them in case they don't exist)
-			texture->SetCurrentAnimation(action);
+			GetAnimation()->SetCurrentAnimation(action);
 			SetAnimationParameters(animDataNode, action);
 
 			free(nameList[nAnimationContents]);
@@ -118,27 +128,62 @@ void Character::AddTexturesAndAnimationFrames()
 }
 
 void Character::CreatePhysBody() 
-{ 
+{
+	// Characters of the same class share their archetype, only the first one reads the config
+	if(!bodyArchetype)
+	{
+		std::string archetypeName = std::format("{}/{}", name, parameters.attribute("class").as_string());
+		bodyArchetype = app->entityManager->GetBodyArchetype(archetypeName);
+		if(!bodyArchetype)
+		{
+			bodyArchetype = CompileBodyArchetype();
+			if(!bodyArchetype) return;
+			app->entityManager->AddBodyArchetype(archetypeName, bodyArchetype);
+		}
+	}
+
+	type = bodyArchetype->type;
+	colliderOffset = bodyArchetype->colliderOffset;
+
+	SetBody(app->physics->CreatePhysBody(*bodyArchetype, GetPosition()));
+	pBody->listener = this;
+}
+
+std::shared_ptr<BodyArchetype const> Character::CompileBodyArchetype() const
+{
+	auto archetype = std::make_shared<BodyArchetype>();
+
 	// <physics>
 	auto currentNode = parameters.child("physics");
 	
 	if(currentNode.empty()) [[unlikely]]
 	{
 		LOG("Entity %s has no physics node", name.c_str());
-		return;
+		return nullptr;
 	}
 	
-	type = static_cast<CL::ColliderLayers>(currentNode.attribute("colliderlayers").as_int());
-	
-	float32 gravity = currentNode.attribute("gravityscale") ? currentNode.attribute("gravityscale").as_float() : 1.0f;
+	archetype->type = static_cast<CL::ColliderLayers>(currentNode.attribute("colliderlayers").as_int());
+	archetype->gravityScale = currentNode.attribute("gravityscale") ? currentNode.attribute("gravityscale").as_float() : 1.0f;
 	float32 restitution = currentNode.attribute("restitution") ? currentNode.attribute("restitution").as_float() : 1.0f;
+
+	// <controller/>
+	if(auto controllerNode = currentNode.child("controller"); controllerNode.attribute("enabled").as_bool())
+	{
+		archetype->bController = true;
+		archetype->controllerBox = {
+			controllerNode.attribute("x").as_int(),
+			controllerNode.attribute("y").as_int(),
+			controllerNode.attribute("width").as_int(),
+			controllerNode.attribute("height").as_int()
+		};
+	}
 		
 	// <properties/> (or <animation> if properties doesn't exist
 	if(currentNode = currentNode.parent().child("animationdata").first_child();
 	   currentNode.empty())
 	{
 		LOG("No animationdata on %s", name);
-		return;
+		return nullptr;
 	}
 
 	while(currentNode) 
@@ -152,42 +197,25 @@ void Character::CreatePhysBody()
 	if(!currentNode)
 	{
 		LOG("Entity %s has no collider node", name.c_str());
-		return;
+		return nullptr;
 	}
 	
 	// <collidergroup>
+	bool bFirstGroup = true;
 	for(auto const &colliderGroupNode : currentNode.children("collidergroup"))
 	{
-		iPoint width_height(
-			colliderGroupNode.attribute("width").as_int(),
-			colliderGroupNode.attribute("height").as_int()
-		);
-
-		if(!pBody)
+		if(bFirstGroup)
 		{
-			colliderOffset = {
+			archetype->colliderOffset = {
 				colliderGroupNode.first_child().attribute("x").as_int(),
 				colliderGroupNode.first_child().attribute("y").as_int()
 			};
-			
-			auto bodyType = BodyTypeStrToEnum(colliderGroupNode.attribute("class").as_string());
-			
-			auto bodyPtr = app->physics->CreateBody(
-				position + colliderOffset,
-				bodyType,
-				0.0f,
-				{0.00f,0.01f},
-				gravity
-			);
-
-			auto pBodyPtr = app->physics->CreatePhysBody(
-				bodyPtr,
-				width_height,
-				type
-			);
-
-			pBody = std::move(pBodyPtr);
-			pBody->listener = this;
+			archetype->size = {
+				colliderGroupNode.attribute("width").as_int(),
+				colliderGroupNode.attribute("height").as_int()
+			};
+			archetype->bodyType = BodyTypeStrToEnum(colliderGroupNode.attribute("class").as_string());
+			bFirstGroup = false;
 		}
 		
 		for(auto const &elem : colliderGroupNode.children())
@@ -223,8 +251,8 @@ void Character::CreatePhysBody()
 			{
 				tempData.push_back(
 					{
-						PIXEL_TO_METERS(width_height.x),
-						PIXEL_TO_METERS(width_height.y)
+						PIXEL_TO_METERS(colliderGroupNode.attribute("width").as_int()),
+						PIXEL_TO_METERS(colliderGroupNode.attribute("height").as_int())
 					}
 				);
 			}
@@ -255,18 +283,21 @@ void Character::CreatePhysBody()
 			{
 				fixPos = PIXEL_TO_METERS(
 					{
-						elem.attribute("x").as_int() - colliderOffset.x,
-						elem.attribute("y").as_int() - colliderOffset.y
+						elem.attribute("x").as_int() - archetype->colliderOffset.x,
+						elem.attribute("y").as_int() - archetype->colliderOffset.y
 					}
 				);
 			}
 
 			float32 friction = elem.attribute("friction") ? elem.attribute("friction").as_float() : 1.0f;
 			uint16 maskFlag = SetMaskFlag(name, colliderGroupNode, elem);
+			// The controller collides with the tiles, so the fixtures don't have to
+			if(archetype->bController)
+				maskFlag &= static_cast<uint16>(~static_cast<uint16>(CL::ColliderLayers::PLATFORMS));
 
 			auto fixtureDef = app->physics->CreateFixtureDef(
 				shape,
-				static_cast<uint16>(type),
+				static_cast<uint16>(archetype->type),
 				maskFlag,
 				bSensor,
 				density,
@@ -275,29 +306,20 @@ void Character::CreatePhysBody()
 				fixPos
 			);
 
-			auto fixturePtr = pBody->body->CreateFixture(fixtureDef.get());
-
-			if(StrEquals(elem.attribute("name").as_string(), "ground"))
-			{
-				pBody->ground = std::make_unique<FixtureData>(
-					std::string(elem.attribute("name").as_string()),
-					fixturePtr
-				);
-			}
-			if(StrEquals(elem.attribute("name").as_string(), "top"))
-			{
-				pBody->top = std::make_unique<FixtureData>(
-					std::string(elem.attribute("name").as_string()),
-					fixturePtr
-				);
-			}
+			// The archetype keeps the shape the definition points to
+			FixtureArchetype &fixture = archetype->fixtures.emplace_back();
+			fixture.def = *fixtureDef;
+			fixture.shape = std::move(shape.shape);
+			fixture.name = elem.attribute("name").as_string();
 		}
 	}
+
+	return archetype;
 }
 
 void Character::RestartLevel()
 {
-	position = startingPosition;
+	GetPosition() = startingPosition;
 	hp = 3;
 	iFrames = 0;
 	jump.bOnAir = false;
@@ -320,13 +342,13 @@ bool Character::Update()
 		}
 	}
 	//Update Character position in pixels
-	position.x = METERS_TO_PIXELS(pBody->body->GetTransform().p.x);
-	position.y = METERS_TO_PIXELS(pBody->body->GetTransform().p.y);
+	ReadBody();
+	iPoint drawPosition = pBody->GetInterpolatedPosition();
 	app->render->DrawCharacterTexture(
-		texture->UpdateAndGetFrame().get(),
-		iPoint(position.x - colliderOffset.x, position.y - colliderOffset.y),
+		GetAnimation()->UpdateAndGetFrame().get(),
+		iPoint(drawPosition.x - colliderOffset.x, drawPosition.y - colliderOffset.y),
 		(bool)dir,
-		texture->GetFlipPivot()
+		GetAnimation()->GetFlipPivot()
 	);
 
 	if(hp <= 0) Disable();
@@ -336,13 +358,13 @@ bool Character::Update()
 
 bool Character::Pause() const
 {
-	if(auto tex = texture->GetCurrentTexture(); tex)
+	if(auto tex = GetAnimation()->GetCurrentTexture(); tex)
 	{
 		return app->render->DrawCharacterTexture(
-			texture->GetCurrentTexture().get(),
-			iPoint(position.x - colliderOffset.x, position.y - colliderOffset.y),
+			GetAnimation()->GetCurrentTexture().get(),
+			iPoint(GetPosition().x - colliderOffset.x, GetPosition().y - colliderOffset.y),
 			(bool)dir,
-			texture->GetFlipPivot()
+			GetAnimation()->GetFlipPivot()
 		);
 	}
 	return false;
@@ -361,6 +383,91 @@ void Character::OnCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fix
 	/* To override */
 }
 
+//---------- Projectiles
+
+bool Character::LoadProjectileData()
+{
+	for(auto const &elem : parameters.children("projectile"))
+	{
+		std::vector<b2Vec2> tempData;
+		std::string shapeType = elem.attribute("shape").as_string();
+
+		if(StrEquals(shapeType, "chain") || StrEquals(shapeType, "polygon"))
+		{
+			const std::string xyStr = elem.attribute("points").as_string();
+			static const std::regex r(R"((-?\d{1,3})(?:\.\d+)*,(-?\d{1,3})(?:\.\d+)*)");
+			auto xyStrBegin = std::sregex_iterator(xyStr.begin(), xyStr.end(), r);
+			auto xyStrEnd = std::sregex_iterator();
+
+			for(std::sregex_iterator i = xyStrBegin; i != xyStrEnd; ++i)
+			{
+				std::smatch match = *i;
+				tempData.push_back(
+					{
+						PIXEL_TO_METERS(stoi(match[1].str())),
+						PIXEL_TO_METERS(stoi(match[2].str()))
+					}
+				);
+			}
+		}
+		else if(StrEquals(shapeType, "rectangle"))
+		{
+			tempData.push_back(
+				{
+					PIXEL_TO_METERS(elem.attribute("width").as_int()),
+					PIXEL_TO_METERS(elem.attribute("height").as_int())
+				}
+			);
+		}
+		else if(StrEquals(shapeType, "circle"))
+		{
+			tempData.push_back(
+				{
+					elem.attribute("radius").as_float(),
+					0
+				}
+			);
+		}
+
+		std::string pName = elem.attribute("name").as_string();
+		auto data = std::make_unique<ProjectileData>(
+			ShapeData(shapeType, tempData),
+			elem.attribute("gothrough").as_bool(),
+			iPoint(
+				elem.attribute("x").as_int(),
+				elem.attribute("y").as_int()
+			),
+			iPoint(
+				elem.attribute("width").as_int(),
+				elem.attribute("height").as_int()
+			),
+			elem.attribute("speed").as_int(),
+			static_cast<ProjectileFreedom>(elem.attribute("freedom").as_uint())
+		);
+		if(StrEquals(elem.attribute("motion").as_string(), "swept"))
+			data->motion = ProjectileMotion::SWEPT;
+
+		// Characters of the same class share their pools
+		std::string typeName = std::format("{}/{}", parameters.attribute("class").as_string(), pName);
+		int projectileType = app->projectiles->AddProjectileType(typeName, std::move(data), elem.attribute("pool").as_int());
+		if(projectileType < 0) continue;
+		projectileTypes[pName] = projectileType;
+	}
+	return true;
+}
+
+int Character::FireProjectile(std::string_view projectileName, iPoint origin, b2Vec2 direction) const
+{
+	if(auto it = projectileTypes.find(projectileName); it != projectileTypes.end())
+		return app->projectiles->Fire(it->second, origin, direction, type);
+	return -1;
+}
+
+bool Character::HasProjectiles() const
+{
+	return !projectileTypes.empty();
+}
+
 //---------- Utils
 
 bool Character::CreateEntityPath(std::string &entityFolder) const
@@ -391,14 +498,14 @@ void Character::SetAnimationParameters(pugi::xml_node const &animDataNode, std::
 	auto animationParameters = animDataNode.find_child_by_attribute("name", action.c_str());
 
 	if(!animationParameters.empty() && animationParameters.attribute("speed"))
-		texture->SetSpeed(animationParameters.attribute("speed").as_float());
+		GetAnimation()->SetSpeed(animationParameters.attribute("speed").as_float());
 	else
-		texture->SetSpeed(0.2f);
+		GetAnimation()->SetSpeed(0.2f);
 
 	if(!animationParameters.empty() && animationParameters.attribute("style"))
-		texture->SetAnimStyle(static_cast<AnimIteration>(animationParameters.attribute("animstyle").as_int()));
+		GetAnimation()->SetAnimStyle(static_cast<AnimIteration>(animationParameters.attribute("animstyle").as_int()));
 	else
-		texture->SetAnimStyle(AnimIteration::LOOP_FROM_START);
+		GetAnimation()->SetAnimStyle(AnimIteration::LOOP_FROM_START);
 
 }
 
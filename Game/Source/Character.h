@@ -5,6 +5,10 @@
 
 #include "Physics.h"
 
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
 struct CharacterJump
 {
 	bool bOnAir = false;
@@ -29,6 +33,8 @@ public:
 	bool Start() override;
 	void AddTexturesAndAnimationFrames();
 	void CreatePhysBody() override;
+	// Reads the body of the character from its config
+	std::shared_ptr<BodyArchetype const> CompileBodyArchetype() const;
 	void RestartLevel() override;
 	//---------- Main Loop
 	bool Update() override;
@@ -48,6 +54,14 @@ public:
 	bool bKeepMomentum = false;
 	b2Vec2 velocityToKeep = {0.0f, 0.0f};
 
+protected:
+	//---------- Projectiles
+	// Registers the <projectile> nodes of the parameters in the ProjectileManager
+	bool LoadProjectileData();
+	// Slot of the projectile, -1 if the character doesn't have it or its pool is empty
+	int FireProjectile(std::string_view projectileName, iPoint origin, b2Vec2 direction) const;
+	bool HasProjectiles() const;
+
 private:
 	//---- Utils
 	bool CreateEntityPath(std::string &entityFolder) const;
@@ -58,6 +72,9 @@ private:
 		pugi::xml_node const &colliderNode
 	) const;
 
+	// <projectile name, type in the ProjectileManager>
+	std::unordered_map<std::string, int, StringHash, std::equal_to<>> projectileTypes;
+
 };
 
 #endif // __CHARACTER_H__
@@ -0,0 +1,201 @@
+#include "CharacterController.h"
+#include "Physics.h"
+
+#include <cmath>
+
+namespace
+{
+	// Keeps a box that touches the edge of a tile from counting as inside it
+	constexpr float EDGE_EPSILON = 0.01f;
+	// How far down a grounded character follows a slope, in tiles
+	constexpr float SLOPE_SNAP = 0.5f;
+	// Long enough to leave the platform before it stops the character again
+	constexpr int DROP_THROUGH_STEPS = 12;
+
+	inline int ToTile(float pixels, int tileSize)
+	{
+		return static_cast<int>(std::floor(pixels / static_cast<float>(tileSize)));
+	}
+}
+
+CharacterController::CharacterController(b2Body *body, SDL_Rect const &box) :
+	body(body),
+	boxOffset({static_cast<float>(box.x), static_cast<float>(box.y)}),
+	boxSize({static_cast<float>(box.w), static_cast<float>(box.h)})
+{}
+
+void CharacterController::BeginStep()
+{
+	startPosition = body->GetPosition();
+}
+
+void CharacterController::EndStep(CollisionGrid const &grid)
+{
+	if(!body->IsActive() || grid.tiles.empty()) return;
+
+	if(dropSteps > 0) dropSteps--;
+
+	b2Vec2 endPosition = body->GetPosition();
+	// A sleeping body keeps whatever ground it had
+	if(endPosition.x == startPosition.x && endPosition.y == startPosition.y) return;
+
+	fPoint origin = {startPosition.x * PIXELS_PER_METER, startPosition.y * PIXELS_PER_METER};
+	float dx = (endPosition.x - startPosition.x) * PIXELS_PER_METER;
+	float dy = (endPosition.y - startPosition.y) * PIXELS_PER_METER;
+
+	b2Vec2 velocity = body->GetLinearVelocity();
+	b2Vec2 resolvedVelocity = velocity;
+	bool bWasGrounded = bGrounded;
+
+	// A character on a slope walks over the tiles it's standing in
+	float stepHeight = bOnSlope ? static_cast<float>(grid.tileHeight) : 0.0f;
+	if(MoveX(grid, origin, dx, stepHeight)) resolvedVelocity.x = 0.0f;
+
+	bGrounded = false;
+	if(MoveY(grid, origin, dy))
+	{
+		resolvedVelocity.y = 0.0f;
+		bGrounded = (dy > 0.0f);
+	}
+
+	// Slopes never stop the box, it stands on them wherever its center is
+	bOnSlope = (velocity.y >= 0.0f && SnapToSlope(grid, origin, !bWasGrounded));
+	if(bOnSlope)
+	{
+		resolvedVelocity.y = 0.0f;
+		bGrounded = true;
+	}
+
+	if(bGrounded && !bWasGrounded)
+	{
+		bLanded = true;
+		landingVelocity = velocity;
+	}
+
+	b2Vec2 resolvedPosition = {origin.x / PIXELS_PER_METER, origin.y / PIXELS_PER_METER};
+	if(resolvedPosition.x != endPosition.x || resolvedPosition.y != endPosition.y)
+		body->SetTransform(resolvedPosition, body->GetAngle());
+	if(resolvedVelocity.x != velocity.x || resolvedVelocity.y != velocity.y)
+		body->SetLinearVelocity(resolvedVelocity);
+}
+
+bool CharacterController::IsGrounded() const
+{
+	return bGrounded;
+}
+
+bool CharacterController::ConsumeLanding(b2Vec2 &velocity)
+{
+	if(!bLanded) return false;
+
+	velocity = landingVelocity;
+	bLanded = false;
+	return true;
+}
+
+void CharacterController::DropThrough()
+{
+	if(bGrounded) dropSteps = DROP_THROUGH_STEPS;
+}
+
+b2Body *CharacterController::GetBody() const
+{
+	return body;
+}
+
+bool CharacterController::MoveX(CollisionGrid const &grid, fPoint &origin, float dx, float stepHeight) const
+{
+	if(dx == 0.0f) return false;
+
+	float top = origin.y + boxOffset.y;
+	float bottom = top + boxSize.y;
+	int firstRow = ToTile(top + EDGE_EPSILON, grid.tileHeight);
+	int lastRow = ToTile(bottom - EDGE_EPSILON - stepHeight, grid.tileHeight);
+
+	float left = origin.x + boxOffset.x;
+	float right = left + boxSize.x;
+	int direction = (dx > 0.0f) ? 1 : -1;
+	int firstColumn = (dx > 0.0f) ? ToTile(right - EDGE_EPSILON, grid.tileWidth) + 1 : ToTile(left + EDGE_EPSILON, grid.tileWidth) - 1;
+	int lastColumn = (dx > 0.0f) ? ToTile(right + dx - EDGE_EPSILON, grid.tileWidth) : ToTile(left + dx + EDGE_EPSILON, grid.tileWidth);
+
+	// Every column the leading side crosses, nearest first
+	for(int column = firstColumn; (lastColumn - column) * direction >= 0; column += direction)
+	{
+		for(int row = firstRow; row <= lastRow; row++)
+		{
+			if(grid.Get(column, row) != TileCollision::SOLID) continue;
+
+			origin.x = (dx > 0.0f)
+				? static_cast<float>(column * grid.tileWidth) - boxSize.x - boxOffset.x
+				: static_cast<float>((column + 1) * grid.tileWidth) - boxOffset.x;
+			return true;
+		}
+	}
+
+	origin.x += dx;
+	return false;
+}
+
+bool CharacterController::MoveY(CollisionGrid const &grid, fPoint &origin, float dy) const
+{
+	if(dy == 0.0f) return false;
+
+	float left = origin.x + boxOffset.x;
+	float right = left + boxSize.x;
+	int firstColumn = ToTile(left + EDGE_EPSILON, grid.tileWidth);
+	int lastColumn = ToTile(right - EDGE_EPSILON, grid.tileWidth);
+
+	float top = origin.y + boxOffset.y;
+	float bottom = top + boxSize.y;
+	int direction = (dy > 0.0f) ? 1 : -1;
+	int firstRow = (dy > 0.0f) ? ToTile(bottom - EDGE_EPSILON, grid.tileHeight) + 1 : ToTile(top + EDGE_EPSILON, grid.tileHeight) - 1;
+	int lastRow = (dy > 0.0f) ? ToTile(bottom + dy - EDGE_EPSILON, grid.tileHeight) : ToTile(top + dy + EDGE_EPSILON, grid.tileHeight);
+
+	// Only the rows the box wasn't in already, so one-way platforms let it jump through
+	for(int row = firstRow; (lastRow - row) * direction >= 0; row += direction)
+	{
+		for(int column = firstColumn; column <= lastColumn; column++)
+		{
+			TileCollision tile = grid.Get(column, row);
+			bool bBlocks = (tile == TileCollision::SOLID) || (tile == TileCollision::ONE_WAY && dy > 0.0f && dropSteps == 0);
+			if(!bBlocks) continue;
+
+			origin.y = (dy > 0.0f)
+				? static_cast<float>(row * grid.tileHeight) - boxSize.y - boxOffset.y
+				: static_cast<float>((row + 1) * grid.tileHeight) - boxOffset.y;
+			return true;
+		}
+	}
+
+	origin.y += dy;
+	return false;
+}
+
+bool CharacterController::SnapToSlope(CollisionGrid const &grid, fPoint &origin, bool bFalling) const
+{
+	float centerX = origin.x + boxOffset.x + boxSize.x / 2.0f;
+	float bottom = origin.y + boxOffset.y + boxSize.y;
+	int column = ToTile(centerX, grid.tileWidth);
+	int row = ToTile(bottom - EDGE_EPSILON, grid.tileHeight);
+
+	// A grounded character also follows a slope that goes down from under it
+	int lastRow = bFalling ? row : row + 1;
+	for(int r = row; r <= lastRow; r++)
+	{
+		TileCollision tile = grid.Get(column, r);
+		if(tile == TileCollision::EMPTY) continue;
+		if(tile != TileCollision::SLOPE_UP && tile != TileCollision::SLOPE_DOWN) return false;
+
+		float along = (centerX - static_cast<float>(column * grid.tileWidth)) / static_cast<float>(grid.tileWidth);
+		float rise = (tile == TileCollision::SLOPE_UP) ? along : 1.0f - along;
+		float floorY = static_cast<float>((r + 1) * grid.tileHeight) - rise * static_cast<float>(grid.tileHeight);
+
+		// Falling characters land on the slope once they reach it
+		if(bFalling && bottom < floorY) return false;
+		if(!bFalling && floorY - bottom > SLOPE_SNAP * static_cast<float>(grid.tileHeight)) return false;
+
+		origin.y += floorY - bottom;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,89 @@
+#ifndef __CHARACTERCONTROLLER_H__
+#define __CHARACTERCONTROLLER_H__
+
+#include "Defs.h"
+#include "Point.h"
+
+#include <vector>
+
+#include "Box2D/Box2D/Box2D.h"
+#include "SDL/include/SDL_rect.h"
+
+// What a tile does to a character controller
+enum class TileCollision : uchar
+{
+	EMPTY = 0,
+	SOLID,
+	// Only stops what falls on it
+	ONE_WAY,
+	// Floor goes from the bottom left corner to the top right one
+	SLOPE_UP,
+	// Floor goes from the top left corner to the bottom right one
+	SLOPE_DOWN
+};
+
+// Collision of every tile of the map, stored row-major like NavGrid
+struct CollisionGrid
+{
+	int width = 0;
+	int height = 0;
+	int tileWidth = 0;
+	int tileHeight = 0;
+	std::vector<TileCollision> tiles;
+
+	// The sides of the map are walls, above and below it there's nothing
+	inline TileCollision Get(int x, int y) const
+	{
+		if(x < 0 || x >= width) return TileCollision::SOLID;
+		if(y < 0 || y >= height) return TileCollision::EMPTY;
+		return tiles[y * width + x];
+	}
+};
+
+// Moves a character against the collision grid instead of the tile bodies.
+// The body still steps in the Box2D world, so it touches other characters and
+// projectiles, but its fixtures don't collide with PLATFORMS. After each step the
+// controller sweeps a box from where the body was to where Box2D left it, stops
+// it at walls, floors and ceilings, and keeps it on slopes and one-way platforms.
+class CharacterController
+{
+public:
+	// box is relative to the body origin, in pixels
+	CharacterController(b2Body *body, SDL_Rect const &box);
+
+	// Physics calls them around every step of the world
+	void BeginStep();
+	void EndStep(CollisionGrid const &grid);
+
+	bool IsGrounded() const;
+	// True once after touching the ground, with the velocity it had when it landed
+	bool ConsumeLanding(b2Vec2 &velocity);
+	// Falls through the one-way platform under the character
+	void DropThrough();
+
+	b2Body *GetBody() const;
+
+private:
+	// Move the box origin, in pixels. They return true if a tile stopped it.
+	// MoveX doesn't check the tiles less than stepHeight above the bottom of the box.
+	bool MoveX(CollisionGrid const &grid, fPoint &origin, float dx, float stepHeight) const;
+	bool MoveY(CollisionGrid const &grid, fPoint &origin, float dy) const;
+	// Puts the box on the slope under its bottom center. False if there's no slope to stand on.
+	bool SnapToSlope(CollisionGrid const &grid, fPoint &origin, bool bFalling) const;
+
+	b2Body *body = nullptr;
+	fPoint boxOffset = {0.0f, 0.0f};
+	fPoint boxSize = {0.0f, 0.0f};
+
+	// Body position at the start of the step
+	b2Vec2 startPosition = {0.0f, 0.0f};
+
+	bool bGrounded = false;
+	bool bOnSlope = false;
+	bool bLanded = false;
+	b2Vec2 landingVelocity = {0.0f, 0.0f};
+	// Steps left ignoring one-way platforms
+	int dropSteps = 0;
+};
+
+#endif // __CHARACTERCONTROLLER_H__
@@ -0,0 +1,231 @@
+#include "DebugDraw.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace
+{
+	// Pixels of the line from a to b inside screen, b not included.
+	// It's clipped first, so only the part on screen is walked.
+	void RasterizeLine(SDL_Point a, SDL_Point b, SDL_Rect const &screen, std::vector<SDL_Point> &pixels)
+	{
+		SDL_Point end = b;
+		if(!SDL_IntersectRectAndLine(&screen, &a.x, &a.y, &b.x, &b.y)) return;
+		// b was cut by the screen edge, so it isn't the end of the line and is drawn
+		bool bCut = (b.x != end.x || b.y != end.y);
+
+		int dx = std::abs(b.x - a.x);
+		int dy = -std::abs(b.y - a.y);
+		int sx = (a.x < b.x) ? 1 : -1;
+		int sy = (a.y < b.y) ? 1 : -1;
+		int error = dx + dy;
+
+		while(a.x != b.x || a.y != b.y)
+		{
+			pixels.push_back(a);
+
+			int doubled = 2 * error;
+			if(doubled >= dy)
+			{
+				error += dy;
+				a.x += sx;
+			}
+			if(doubled <= dx)
+			{
+				error += dx;
+				a.y += sy;
+			}
+		}
+		if(bCut) pixels.push_back(b);
+	}
+}
+
+DebugDraw::DebugDraw()
+{
+	for(int i = 0; i < CIRCLE_SEGMENTS; i++)
+	{
+		auto angle = 2.0f * std::numbers::pi_v<float> * static_cast<float>(i) / static_cast<float>(CIRCLE_SEGMENTS);
+		unitCircle[i] = {std::cos(angle), std::sin(angle)};
+	}
+}
+
+void DebugDraw::AddLine(iPoint from, iPoint to, SDL_Color color)
+{
+	std::array<SDL_Point, 2> points = {{{from.x, from.y}, {to.x, to.y}}};
+	AddStrip(GetBatch(color), points);
+}
+
+void DebugDraw::AddPolyline(std::span<const iPoint> points, SDL_Color color, bool closed)
+{
+	if(points.size() < 2) return;
+
+	Batch &batch = GetBatch(color);
+	Strip &strip = batch.strips.emplace_back();
+	strip.first = static_cast<int>(batch.points.size());
+
+	for(auto const &point : points)
+		batch.points.push_back({point.x, point.y});
+	if(closed)
+		batch.points.push_back({points.front().x, points.front().y});
+
+	strip.count = static_cast<int>(batch.points.size()) - strip.first;
+	SDL_EnclosePoints(batch.points.data() + strip.first, strip.count, nullptr, &strip.bounds);
+}
+
+void DebugDraw::AddCircle(iPoint center, int radius, SDL_Color color)
+{
+	std::array<SDL_Point, CIRCLE_SEGMENTS + 1> points{};
+	auto r = static_cast<float>(radius);
+	for(int i = 0; i < CIRCLE_SEGMENTS; i++)
+	{
+		points[i] = {
+			.x = center.x + static_cast<int>(r * unitCircle[i].x),
+			.y = center.y + static_cast<int>(r * unitCircle[i].y)
+		};
+	}
+	points.back() = points.front();
+
+	Batch &batch = GetBatch(color);
+	batch.strips.push_back({
+		.first = static_cast<int>(batch.points.size()),
+		.count = CIRCLE_SEGMENTS + 1,
+		.bounds = {center.x - radius, center.y - radius, 2 * radius + 1, 2 * radius + 1}
+	});
+	batch.points.insert(batch.points.end(), points.begin(), points.end());
+}
+
+void DebugDraw::AddRect(SDL_Rect const &rect, SDL_Color color, bool filled)
+{
+	Batch &batch = GetBatch(color);
+	if(filled) batch.filledRects.push_back(rect);
+	else batch.rects.push_back(rect);
+}
+
+void DebugDraw::Flush(SDL_Renderer *renderer, SDL_Rect const &camera, int scale)
+{
+	drawCalls = 0;
+	scale = std::max(scale, 1);
+
+	// Part of the world the camera sees
+	SDL_Rect view = {-camera.x / scale, -camera.y / scale, camera.w / scale + 1, camera.h / scale + 1};
+	SDL_Rect screen = {0, 0, camera.w, camera.h};
+	auto toScreen = [&camera, scale](SDL_Point point)
+	{
+		return SDL_Point{point.x * scale + camera.x, point.y * scale + camera.y};
+	};
+	auto toScreenRects = [this, &view, &camera, scale](std::vector<SDL_Rect> const &rects)
+	{
+		screenRects.clear();
+		for(auto const &rect : rects)
+		{
+			if(!SDL_HasIntersection(&rect, &view)) continue;
+			screenRects.push_back({rect.x * scale + camera.x, rect.y * scale + camera.y, rect.w * scale, rect.h * scale});
+		}
+		return static_cast<int>(screenRects.size());
+	};
+
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+	for(auto const &batch : batches)
+	{
+		if(batch.strips.empty() && batch.rects.empty() && batch.filledRects.empty()) continue;
+
+		SDL_SetRenderDrawColor(renderer, batch.color.r, batch.color.g, batch.color.b, batch.color.a);
+
+		// SDL_RenderDrawLines joins every point with the next one, so strips can't
+		// share a call. Their pixels are put together and drawn as points instead.
+		screenPoints.clear();
+		for(auto const &strip : batch.strips)
+		{
+			if(!SDL_HasIntersection(&strip.bounds, &view)) continue;
+
+			SDL_Point const *points = batch.points.data() + strip.first;
+			for(int i = 1; i < strip.count; i++)
+				RasterizeLine(toScreen(points[i - 1]), toScreen(points[i]), screen, screenPoints);
+
+			// The end isn't drawn twice when the strip is closed
+			SDL_Point end = toScreen(points[strip.count - 1]);
+			SDL_Point start = toScreen(points[0]);
+			if((end.x != start.x || end.y != start.y || strip.count == 1) && SDL_PointInRect(&end, &screen))
+				screenPoints.push_back(end);
+		}
+		if(!screenPoints.empty())
+		{
+			SDL_RenderDrawPoints(renderer, screenPoints.data(), static_cast<int>(screenPoints.size()));
+			drawCalls++;
+		}
+
+		if(int count = toScreenRects(batch.rects); count > 0)
+		{
+			SDL_RenderDrawRects(renderer, screenRects.data(), count);
+			drawCalls++;
+		}
+
+		if(int count = toScreenRects(batch.filledRects); count > 0)
+		{
+			SDL_RenderFillRects(renderer, screenRects.data(), count);
+			drawCalls++;
+		}
+	}
+
+	Clear();
+}
+
+void DebugDraw::Clear()
+{
+	// Batches keep their memory for the next frame
+	for(auto &batch : batches)
+	{
+		batch.points.clear();
+		batch.strips.clear();
+		batch.rects.clear();
+		batch.filledRects.clear();
+	}
+}
+
+int DebugDraw::GetDrawCallCount() const
+{
+	return drawCalls;
+}
+
+DebugDraw::Batch &DebugDraw::GetBatch(SDL_Color color)
+{
+	// There are only a handful of colors, a linear search is enough
+	auto it = std::ranges::find_if(batches, [color](Batch const &batch)
+	{
+		return batch.color.r == color.r && batch.color.g == color.g && batch.color.b == color.b && batch.color.a == color.a;
+	});
+	if(it != batches.end()) return *it;
+
+	Batch &batch = batches.emplace_back();
+	batch.color = color;
+	return batch;
+}
+
+void DebugDraw::AddStrip(Batch &batch, std::span<const SDL_Point> points)
+{
+	SDL_Rect bounds;
+	SDL_EnclosePoints(points.data(), static_cast<int>(points.size()), nullptr, &bounds);
+
+	// Lines drawn one after the other, like the edges of a path, become a single strip
+	if(!batch.strips.empty())
+	{
+		Strip &last = batch.strips.back();
+		SDL_Point const &end = batch.points[last.first + last.count - 1];
+		if(static_cast<size_t>(last.first + last.count) == batch.points.size() && end.x == points.front().x && end.y == points.front().y)
+		{
+			batch.points.insert(batch.points.end(), points.begin() + 1, points.end());
+			last.count += static_cast<int>(points.size()) - 1;
+			SDL_UnionRect(&last.bounds, &bounds, &last.bounds);
+			return;
+		}
+	}
+
+	batch.strips.push_back({
+		.first = static_cast<int>(batch.points.size()),
+		.count = static_cast<int>(points.size()),
+		.bounds = bounds
+	});
+	batch.points.insert(batch.points.end(), points.begin(), points.end());
+}
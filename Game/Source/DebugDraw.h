@@ -0,0 +1,67 @@
+#ifndef __DEBUGDRAW_H__
+#define __DEBUGDRAW_H__
+
+#include "Point.h"
+
+#include <array>
+#include <span>
+#include <vector>
+
+#include "SDL/include/SDL.h"
+
+// Collects the debug shapes of a frame and draws them all at once.
+// Shapes are kept in world pixels and grouped by color, so each color sets the
+// draw color once, its lines go in a single call and its rects in another.
+// Anything outside the camera is dropped when flushing.
+class DebugDraw
+{
+public:
+	DebugDraw();
+
+	void AddLine(iPoint from, iPoint to, SDL_Color color);
+	// Connected lines through every point. closed also joins the last one with the first.
+	void AddPolyline(std::span<const iPoint> points, SDL_Color color, bool closed = false);
+	void AddCircle(iPoint center, int radius, SDL_Color color);
+	void AddRect(SDL_Rect const &rect, SDL_Color color, bool filled = false);
+
+	// camera and scale work as in Render: screen = world * scale + camera
+	void Flush(SDL_Renderer *renderer, SDL_Rect const &camera, int scale);
+	void Clear();
+
+	// SDL calls made by the last flush
+	int GetDrawCallCount() const;
+
+private:
+	struct Strip
+	{
+		int first = 0;
+		int count = 0;
+		// In world pixels
+		SDL_Rect bounds = {0, 0, 0, 0};
+	};
+
+	struct Batch
+	{
+		SDL_Color color = {0, 0, 0, 0};
+		std::vector<SDL_Point> points;
+		std::vector<Strip> strips;
+		std::vector<SDL_Rect> rects;
+		std::vector<SDL_Rect> filledRects;
+	};
+
+	Batch &GetBatch(SDL_Color color);
+	// Starts a new strip, or continues the last one if it ends where this one starts
+	void AddStrip(Batch &batch, std::span<const SDL_Point> points);
+
+	static constexpr int CIRCLE_SEGMENTS = 24;
+	// cos and sin of every vertex of the circle, computed once
+	std::array<fPoint, CIRCLE_SEGMENTS> unitCircle;
+
+	std::vector<Batch> batches;
+	// Reused while flushing
+	std::vector<SDL_Point> screenPoints;
+	std::vector<SDL_Rect> screenRects;
+	int drawCalls = 0;
+};
+
+#endif // __DEBUGDRAW_H__
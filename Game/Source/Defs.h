@@ -37,6 +37,22 @@ constexpr uint str2int(const char *str, int h = 0)
 	return !str[h] ? 5381 : (str2int(str, h+1) * 33) ^ str[h];
 }
 
+// FNV-1a hash of a block of bytes.
+// Pass the result of a previous call as hash to keep hashing more data.
+constexpr uint64 FNV_OFFSET_BASIS = 14695981039346656037ULL;
+constexpr uint64 FNV_PRIME = 1099511628211ULL;
+
+inline uint64 HashBytes(void const *bytes, size_t size, uint64 hash = FNV_OFFSET_BASIS)
+{
+	auto const *data = static_cast<uchar const *>(bytes);
+	for(size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
 constexpr uint g_BoolTypeStr2Int = str2int("bool");
 constexpr uint g_IntTypeStr2Int = str2int("int");
 constexpr uint g_UIntTypeStr2Int = str2int("uint");
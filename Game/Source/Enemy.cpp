@@ -1,7 +1,9 @@
 #include "Enemy.h"
 #include "App.h"
 #include "Map.h"
-#include "Projectile.h"
+#include "Render.h"
+#include "ProjectileManager.h"
+#include "EntityManager.h"
 #include "BitMaskColliderLayers.h"
 #include "PugiXml/src/pugixml.hpp"
 #include <string>
@@ -26,14 +28,17 @@ bool Enemy::Awake()
 	};
 	if(StrEquals(parameters.attribute("type").as_string(), "Air"))
 			pTerrain = PathfindTerrain::AIR;
+	terrainMask = pTerrain | Pathfinding::ParseTerrainMask(parameters.attribute("terrain").as_string());
 
 	enemyClass = parameters.attribute("class").as_string();
 
-	aggroRadius = parameters.attribute("aggro").as_int();
-	if(aggroRadius == 0) aggroRadius = 8;
+	AI().aggroRadius = parameters.attribute("aggro").as_int();
+	if(AI().aggroRadius == 0) AI().aggroRadius = 8;
 	patrolRadius = parameters.attribute("patrol").as_int();
 	if(patrolRadius == 0) patrolRadius = 5;
 
+	LoadProjectileData();
+
 	return true;
 }
 
@@ -49,13 +54,13 @@ bool Enemy::Update()
 		// If enemy is dead
 		if(hp == 0)
 		{
-			if(pTerrain == PathfindTerrain::AIR && position.y < tileYOnDeath) position.y += 5;
+			if(pTerrain == PathfindTerrain::AIR && GetPosition().y < tileYOnDeath) GetPosition().y += 5;
 
-			if(texture->IsLastFrame()) texture->Pause();
+			if(GetAnimation()->IsLastFrame()) GetAnimation()->Pause();
 			if(iFrames >= 100)
 			{
 				iFrames = 0;
-				active = false;
+				SetActive(false);
 			}
 		}
 		// If it's not dead and iFrame timer expired
@@ -64,14 +69,14 @@ bool Enemy::Update()
 			iFrames = 0;
 		}
 	}
-	else if(StrEquals(texture->GetCurrentAnimName(), "attack"))
+	else if(StrEquals(GetAnimation()->GetCurrentAnimName(), "attack"))
 	{
-		if(texture->IsAnimFinished()) texture->SetCurrentAnimation("idle");
+		if(GetAnimation()->IsAnimFinished()) GetAnimation()->SetCurrentAnimation("idle");
 	}
 	// If there's a valid path and we haven't finished it, we have to move
 	else if(path && !path->empty())
 	{
-		auto currentCoords = app->map->WorldToCoordinates(position);
+		auto currentCoords = app->map->WorldToCoordinates(GetPosition());
 
 		if(currentPathIndex < path->size() - 1)
 		{
@@ -92,19 +97,16 @@ bool Enemy::Update()
 		// This function returns the velocity as b2Vec2
 		pBody->body->SetLinearVelocity(SetPathMovementParameters(currentCoords));
 	}
-	else texture->SetCurrentAnimation("idle");
+	else GetAnimation()->SetCurrentAnimation("idle");
 
 	//Update Character position in pixels
-	if(pBody)
-	{
-		position.x = METERS_TO_PIXELS(pBody->body->GetTransform().p.x);
-		position.y = METERS_TO_PIXELS(pBody->body->GetTransform().p.y);
-	}
+	if(pBody) ReadBody();
+	iPoint drawPosition = pBody ? pBody->GetInterpolatedPosition() : GetPosition();
 	app->render->DrawCharacterTexture(
-		texture->UpdateAndGetFrame().get(),
-		iPoint(position.x - colliderOffset.x, position.y - colliderOffset.y),
+		GetAnimation()->UpdateAndGetFrame().get(),
+		iPoint(drawPosition.x - colliderOffset.x, drawPosition.y - colliderOffset.y),
 		(bool)dir,
-		texture->GetFlipPivot()
+		GetAnimation()->GetFlipPivot()
 	);
 
 	return true;
@@ -116,21 +118,21 @@ void Enemy::BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fix
 
 	if(iFrames == 0 // iFrames are not enabled
 	   && ((pBodyB->ctype & BULLET) == BULLET) // got hit by a bullet
-	   && ((pBodyB->pListener->source & PLAYER) == PLAYER)) // the source of the bullet was the player
+	   && ((app->projectiles->GetSource(pBodyB->projectileSlot) & PLAYER) == PLAYER)) // the source of the bullet was the player
 	{
 		hp -= 1;
 		iFrames = 1;
 		if(hp <= 0)
 		{
-			texture->SetCurrentAnimation("death");
-			behaviour = BehaviourState::DEAD;
+			GetAnimation()->SetCurrentAnimation("death");
+			AI().behaviour = BehaviourState::DEAD;
 			// We stop all X momentum
 			pBody->body->SetLinearVelocity(b2Vec2(0, pBody->body->GetLinearVelocity().y));
-			tileYOnDeath = app->map->GetTileHeight()/2 + app->map->MapToWorld(app->pathfinding->GetDestinationCoordinates(position, PathfindTerrain::GROUND)).y;
+			tileYOnDeath = app->map->GetTileHeight()/2 + app->map->MapToWorld(app->pathfinding->GetDestinationCoordinates(GetPosition(), PathfindTerrain::GROUND)).y;
 			Disable();
-			active = true;
+			SetActive(true);
 		}
-		else texture->SetCurrentAnimation("hurt");
+		else GetAnimation()->SetCurrentAnimation("hurt");
 	}
 	if((pBodyB->ctype & ENEMIES) == ENEMIES)
 	{
@@ -146,12 +148,12 @@ void Enemy::BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fix
 	{
 		if(attackTimer == 0)
 		{
-			if(pBodyB->GetPosition().x > position.x)
+			if(pBodyB->GetPosition().x > GetPosition().x)
 				dir = 0;
 			else
 				dir = 1;
 
-			texture->SetCurrentAnimation("attack");
+			GetAnimation()->SetCurrentAnimation("attack");
 			attackTimer++;
 		}
 	}
@@ -161,37 +163,129 @@ bool Enemy::SetPath(iPoint destinationCoords)
 {
 	bRequestPath = false;
 
+	// Ground enemies chasing the player keep their search and only move its goal
+	if(pTerrain == PathfindTerrain::GROUND && AI().behaviour == BehaviourState::AGGRO
+	   && app->pathfinding->IsIncrementalChaseEnabled())
+		return SetChasePath(destinationCoords);
+
+	if(chaseSearch) chaseSearch->Cancel();
+
+	if(!pathSearch) pathSearch = std::make_unique<PathSearch>(app->pathfinding.get());
+
+	// A search that is still running is not restarted, otherwise a destination
+	// that keeps moving would never let it finish. We search again when it's done.
+	if(pathSearch->GetStatus() == SearchStatus::IN_PROGRESS)
+	{
+		pendingDestination = destinationCoords;
+		bPendingSearch = true;
+		return false;
+	}
+
 	// Get the coordinates of origin and destination
-	auto positionTile = app->map->WorldToCoordinates(position);
+	auto positionTile = app->map->WorldToCoordinates(GetPosition());
 
-	auto pathPtr = app->pathfinding->AStarSearch(positionTile, destinationCoords, pTerrain);
+	pathSearch->Start(positionTile, destinationCoords, terrainMask);
+	bPendingSearch = false;
+	bestPathNode = -1;
+	return true;
+}
 
-	// If it's nullptr we don't update the path
-	if(!pathPtr.get()) return false;
-	
-	// If the new path is valid and not empty, it's the new path
-	if(path) path.reset(pathPtr.release());
-	else path = std::move(pathPtr);
-	currentPathIndex = path->size() > 1 ? 1 : 0;
+bool Enemy::SetChasePath(iPoint destinationCoords)
+{
+	if(!chaseSearch) chaseSearch = std::make_unique<IncrementalSearch>(app->pathfinding.get());
+
+	// A patrol search that was still running is not needed anymore
+	if(pathSearch) pathSearch->Cancel();
+	bPendingSearch = false;
+
+	if(chaseSearch->GetStatus() == SearchStatus::IDLE)
+		chaseSearch->Start(app->map->WorldToCoordinates(GetPosition()), destinationCoords, terrainMask);
+	else
+		chaseSearch->SetDestination(destinationCoords);
+
+	// Same goal as before: the path is taken again from our tile, without expanding
+	if(chaseSearch->GetStatus() == SearchStatus::FOUND) return UpdateChaseSearch(0);
 	return true;
 }
 
-void Enemy::DrawDebugPath() const
+bool Enemy::UpdateChaseSearch(int maxExpansions)
+{
+	if(chaseSearch->Step(maxExpansions) != SearchStatus::FOUND) return false;
+
+	// The search is rooted where the chase started, so we only take
+	// the part of its path that goes from our tile to the player
+	auto positionTile = app->map->WorldToCoordinates(GetPosition());
+	auto newPath = chaseSearch->GetPathFrom(positionTile);
+	if(!newPath)
+	{
+		// We are not on the path anymore, so we search again from here
+		chaseSearch->Start(positionTile, chaseSearch->GetDestination(), terrainMask);
+		return false;
+	}
+
+	SetCurrentPath(std::move(newPath));
+	return true;
+}
+
+bool Enemy::UpdatePathSearch(int maxExpansions)
+{
+	if(chaseSearch && chaseSearch->GetStatus() == SearchStatus::IN_PROGRESS)
+		return UpdateChaseSearch(maxExpansions);
+
+	if(!pathSearch || pathSearch->GetStatus() != SearchStatus::IN_PROGRESS) return false;
+
+	switch(pathSearch->Step(maxExpansions))
+	{
+		using enum SearchStatus;
+		case FOUND:
+			// The new path is valid and not empty, so it's the new path
+			SetCurrentPath(pathSearch->TakePath());
+			break;
+		case IN_PROGRESS:
+			// We keep following the old path until the search finishes.
+			// If we had none, we go towards the closest tile found so far.
+			// It's only built again when the search finds a closer one.
+			if((!path || path->empty()) && pathSearch->GetBestNode() != bestPathNode)
+			{
+				bestPathNode = pathSearch->GetBestNode();
+				SetCurrentPath(pathSearch->GetBestPath());
+			}
+			return false;
+		default:
+			// If no path was found we don't update the path
+			break;
+	}
+
+	bool bFound = pathSearch->GetStatus() == SearchStatus::FOUND;
+	if(bPendingSearch)
+	{
+		pathSearch->Cancel();
+		SetPath(pendingDestination);
+	}
+
+	return bFound;
+}
+
+void Enemy::SetCurrentPath(std::unique_ptr<std::vector<iPoint>> newPath)
 {
-	iPoint origin = path->at(currentPathIndex);
-	origin = app->map->MapToWorld(origin.x, origin.y);
-	origin.x += app->map->GetTileWidth()/2;
-	origin.y += app->map->GetTileHeight();
+	if(!newPath || newPath->empty()) return;
+
+	path = std::move(newPath);
+	currentPathIndex = path->size() > 1 ? 1 : 0;
+}
 
-	for(int i = currentPathIndex; i < path->size() - 1; i++)
+void Enemy::DrawDebugPath() const
+{
+	std::vector<iPoint> points;
+	points.reserve(path->size() - currentPathIndex);
+	for(int i = currentPathIndex; i < path->size(); i++)
 	{
-		iPoint destination = path->at(i + 1);
-		destination = app->map->MapToWorld(destination.x, destination.y);
-		destination.x += app->map->GetTileWidth()/2;
-		destination.y += app->map->GetTileHeight();
-		app->render->DrawLine(origin, destination, SDL_Color(255, 0, 0, 255));
-		origin = destination;
+		iPoint point = app->map->MapToWorld(path->at(i).x, path->at(i).y);
+		point.x += app->map->GetTileWidth()/2;
+		point.y += app->map->GetTileHeight();
+		points.push_back(point);
 	}
+	app->render->GetDebugDraw().AddPolyline(points, SDL_Color(255, 0, 0, 255));
 }
 
 void Enemy::DrawDebug() const
@@ -218,47 +312,77 @@ b2Vec2 Enemy::SetGroundPathMovement(iPoint currentCoords)
 			sign = -1;
 	}
 
-	if(sign == 0) texture->SetCurrentAnimation("idle");
+	if(sign == 0) GetAnimation()->SetCurrentAnimation("idle");
 	else
 	{
 		dir = (sign == -1) ? 1 : 0;
-		texture->SetCurrentAnimation("walk");
+		GetAnimation()->SetCurrentAnimation("walk");
 	}
 
 	return b2Vec2(2.0f * sign, pBody->body->GetLinearVelocity().y);
 }
 
-BehaviourState Enemy::SetBehaviour(iPoint playerPosition, iPoint screenSize)
+EnemyAI &Enemy::AI()
+{
+	return app->entityManager->GetEnemyAI(storeIndex);
+}
+
+EnemyAI const &Enemy::AI() const
+{
+	return app->entityManager->GetEnemyAI(storeIndex);
+}
+
+BehaviourState Enemy::UpdateBehaviour(EnemyAI &ai, int playerDistanceX, int screenWidth)
 {
 	using enum BehaviourState;
-	BehaviourState prevBehaviour = behaviour;
-	switch(behaviour)
+	switch(ai.behaviour)
 	{
 		case IDLE:
 			// If the x distance is less than the width of the screen we activate patrol
-			if(abs(playerPosition.x - position.x) <= screenSize.x + 20)
-				behaviour = PATROL;
+			if(abs(playerDistanceX) <= screenWidth + 20)
+				ai.behaviour = PATROL;
 			break;
 		case PATROL:
-			// If player is in aggro radius we activate aggro behaviour
-			if(app->map->WorldToCoordinates(playerPosition).DistanceManhattan(app->map->WorldToCoordinates(position)) <= aggroRadius)
-				behaviour = AGGRO;
+			// If the player is in aggro radius and in sight we activate aggro behaviour
+			ai.lostSightFrames = 0;
+			if(ai.bSeesPlayer)
+				ai.behaviour = AGGRO;
 			break;
 		case AGGRO:
 		{
 			// If the player left the screen, we put the enemy in idle
-			if(abs(playerPosition.x - position.x) > screenSize.x + 20)
-				behaviour = IDLE;
+			if(abs(playerDistanceX) > screenWidth + 20)
+				ai.behaviour = IDLE;
+			// If it lost sight of the player for a while it goes back to patrolling,
+			// instead of looking for paths to somewhere it can't see
+			// It counts the frames it skipped too, so it takes as long when the budget is degraded
+			else if(ai.bSeesPlayer)
+				ai.lostSightFrames = 0;
+			else if((ai.lostSightFrames += ai.framesSinceTick) >= LOSE_SIGHT_FRAMES)
+				ai.behaviour = PATROL;
 			break;
 		}
 		default:
+			ai.framesSinceTick = 0;
 			return DEAD;
 	}
 
-	if(behaviour != prevBehaviour)
-		bRequestPath = true;
+	ai.framesSinceTick = 0;
+	return ai.behaviour;
+}
 
-	return behaviour;
+bool Enemy::RangedAttack(iPoint target)
+{
+	if(AI().behaviour != BehaviourState::AGGRO || attackTimer != 0 || iFrames > 0 || !HasProjectiles())
+		return false;
+
+	if(FireProjectile("attack", GetPosition(), PIXEL_TO_METERS(target - GetPosition())) < 0)
+		return false;
+
+	dir = (target.x > GetPosition().x) ? 0 : 1;
+	GetAnimation()->SetCurrentAnimation("attack");
+	attackTimer++;
+	return true;
 }
 
 bool Enemy::HasSaveData() const
@@ -288,12 +412,12 @@ b2Vec2 Enemy::SetAirPathMovement(iPoint currentCoords)
 
 	if(sign == b2Vec2{0,0})
 	{
-		texture->SetCurrentAnimation("idle");
+		GetAnimation()->SetCurrentAnimation("idle");
 	}
 	else
 	{
 		dir = (sign.x == -1) ? 1 : 0;
-		texture->SetCurrentAnimation("walk");
+		GetAnimation()->SetCurrentAnimation("walk");
 	}
 
 	return b2Vec2(2.0f * sign.x, 2.0f * sign.y);
@@ -315,18 +439,18 @@ pugi::xml_node Enemy::SaveState(pugi::xml_node const &data)
 	std::string saveFloatData = "<{} {}=\"{:.2f}\" {}=\"{:.2f}\"/>\n";
 	std::string dataToSave = "<enemy>\n";
 	dataToSave += AddSaveData(saveData4, "enemy", "id", id, "class", enemyClass);
-	dataToSave += AddSaveData(saveData4, "position", "x", position.x, "y", position.y);
+	dataToSave += AddSaveData(saveData4, "position", "x", GetPosition().x, "y", GetPosition().y);
 	dataToSave += AddSaveData(saveFloatData, "velocity", "x", pBody->body->GetLinearVelocity().x, "y", pBody->body->GetLinearVelocity().y);
-	dataToSave += AddSaveData(saveData4, "entity", "active", active, "disablenextupdate", disableOnNextUpdate);
+	dataToSave += AddSaveData(saveData4, "entity", "active", IsActive(), "disablenextupdate", IsStopPending());
 	dataToSave += AddSaveData(saveData4, "character", "hp", hp, "iframes", iFrames);
 	dataToSave += AddSaveData(saveData6, "jump", "onair", jump.bOnAir, "currentjumps", jump.currentJumps, "keepmomentum", bKeepMomentum);
 	if(path && !path->empty())
 	{
-		dataToSave += AddSaveData(saveOpenData2, "pathfind", "behaviour", static_cast<int>(behaviour));
+		dataToSave += AddSaveData(saveOpenData2, "pathfind", "behaviour", static_cast<int>(AI().behaviour));
 		dataToSave += AddSaveData(saveData4, "destination", "x", path->back().x, "y", path->back().y);
 		dataToSave += "</pathfind>";
 	}
-	else dataToSave += AddSaveData(saveData2, "pathfind", "behaviour", static_cast<int>(behaviour));
+	else dataToSave += AddSaveData(saveData2, "pathfind", "behaviour", static_cast<int>(AI().behaviour));
 	dataToSave += "</enemy>";
 
 	app->AppendFragment(data, dataToSave.c_str());
@@ -336,12 +460,16 @@ pugi::xml_node Enemy::SaveState(pugi::xml_node const &data)
 
 void Enemy::SpecificRestart()
 {
-	behaviour = BehaviourState::IDLE;
+	AI().behaviour = BehaviourState::IDLE;
+	AI().lostSightFrames = 0;
 	
 	path.reset();
+	if(pathSearch) pathSearch->Cancel();
+	if(chaseSearch) chaseSearch->Cancel();
 	
 	currentPathIndex = 0;
 	bRequestPath = false;
+	bPendingSearch = false;
 	pTerrain = PathfindTerrain::GROUND;
 	tileYOnDeath = 0;
 	bAttack = false;
@@ -3,14 +3,7 @@
 
 #include "Character.h"
 #include "Pathfinding.h"
-
-enum class BehaviourState : int
-{
-	IDLE = 0x0000,
-	PATROL = 0x0001,
-	AGGRO = 0x0002,
-	DEAD = 0x0004
-};
+#include "EntityStore.h"
 
 class Enemy : public Character
 {
@@ -20,9 +13,14 @@ public:
 	~Enemy() final;
 
 	bool Awake() override;
-	bool Update() override;
+	bool Update() final;
 	void BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fixtureB, PhysBody const *pBodyA, PhysBody const *pBodyB) final;
+	// Starts a search towards destination, or moves the goal of the chase.
+	// It doesn't expand anything: UpdatePathSearch does, once per AI tick.
+	// False if a search is still running, destination is searched when it ends.
 	bool SetPath(iPoint destination);
+	// Advances the search started by SetPath. Returns true when a new path is set.
+	bool UpdatePathSearch(int maxExpansions);
 
 	b2Vec2 SetPathMovementParameters(iPoint currentCords);
 	void DrawDebug() const final;
@@ -30,7 +28,14 @@ public:
 	b2Vec2 SetGroundPathMovement(iPoint currentCoords);
 	b2Vec2 SetAirPathMovement(iPoint currentCoords);
 
-	BehaviourState SetBehaviour(iPoint playerPosition, iPoint screenSize);
+	// State of the enemy in the EntityStore
+	EnemyAI &AI();
+	EnemyAI const &AI() const;
+	// Next state of ai, with the player playerDistanceX pixels away.
+	// Called on its AI ticks, ai.framesSinceTick frames apart.
+	static BehaviourState UpdateBehaviour(EnemyAI &ai, int playerDistanceX, int screenWidth);
+	// Shoots its "attack" projectile at target while chasing. False if it can't shoot yet.
+	bool RangedAttack(iPoint target);
 
 	bool HasSaveData() const final;
 	bool LoadState(pugi::xml_node const &data) final;
@@ -46,13 +51,20 @@ public:
 	int currentPathIndex = 0;
 	std::unique_ptr<std::vector<iPoint>> path;
 	bool bRequestPath = false;
+	std::unique_ptr<PathSearch> pathSearch;
+	std::unique_ptr<IncrementalSearch> chaseSearch;
+	iPoint pendingDestination;
+	bool bPendingSearch = false;
+	// Node of pathSearch the path was last built towards while it runs
+	int bestPathNode = -1;
 	PathfindTerrain pTerrain = PathfindTerrain::GROUND;
+	// Every terrain the enemy can path through, pTerrain included
+	PathfindTerrain terrainMask = PathfindTerrain::GROUND;
 
-	int aggroRadius = 0;
+	// Frames an aggroed enemy goes without seeing the player before it patrols again
+	static constexpr int LOSE_SIGHT_FRAMES = 90;
 	int patrolRadius = 5;
 
-	BehaviourState behaviour = BehaviourState::IDLE;
-
 	int tileYOnDeath = 0;
 
 	bool bAttack = false;
@@ -60,6 +72,11 @@ public:
 	bool bHurt = false;
 	bool bIdle = false;
 	bool bWalk = false;
+
+private:
+	void SetCurrentPath(std::unique_ptr<std::vector<iPoint>> newPath);
+	bool SetChasePath(iPoint destinationCoords);
+	bool UpdateChaseSearch(int maxExpansions);
 };
 
 #endif // __ENEMY_H__
@@ -27,7 +27,7 @@ bool Entity::Awake()
 bool Entity::Start()
 {
 	SpawnEntity();
-	active = true;
+	SetActive(true);
 	return true;
 }
 
@@ -51,25 +51,44 @@ bool Entity::Stop()
 	if(pBody)
 	{
  		if(pBody->body) app->physics->DestroyBody(pBody->body);
-		pBody.reset();
+		SetBody(nullptr);
 	}
-	disableOnNextUpdate = false;
+	SetFlag(ENTITY_STOP_PENDING, false);
 	return true;
 }
 
-bool Entity::UpdateProjectiles()
-{
-	return false;
-}
-
 // Sets starting Position and creates PhysBody
 void Entity::SpawnEntity()
 {
-	disableOnNextUpdate = false;
-	position = startingPosition;
+	SetFlag(ENTITY_STOP_PENDING, false);
+	SetFlag(ENTITY_DORMANT, false);
+	GetPosition() = startingPosition;
 	CreatePhysBody();
 }
 
+void Entity::SetDormant(bool dormant)
+{
+	if(IsDormant() == dormant) return;
+	SetFlag(ENTITY_DORMANT, dormant);
+
+	if(!pBody || !pBody->body) return;
+	pBody->body->SetActive(!dormant);
+	// It hasn't moved while asleep, so it shouldn't be drawn sliding from where it was
+	if(!dormant) pBody->ResetInterpolation();
+}
+
+void Entity::SetBody(std::unique_ptr<PhysBody> body)
+{
+	pBody = std::move(body);
+	columns->bodies[storeIndex] = pBody.get();
+}
+
+void Entity::ReadBody()
+{
+	GetPosition() = METERS_TO_PIXELS(pBody->body->GetTransform().p);
+	GetVelocity() = pBody->body->GetLinearVelocity();
+}
+
 bool Entity::HasSaveData() const
 {
 	return false;
@@ -87,25 +106,25 @@ pugi::xml_node Entity::SaveState(pugi::xml_node const &)
 
 void Entity::Enable()
 {
-	if(!active)
+	if(!IsActive())
 	{
-		active = true;
+		SetActive(true);
 		Start();
 	}
 }
 
 void Entity::Disable()
 {
-	if(active)
+	if(IsActive())
 	{
-		active = false;
-		disableOnNextUpdate = true;
+		SetActive(false);
+		SetFlag(ENTITY_STOP_PENDING, true);
 	}
 }
 
 void Entity::RestartLevel()
 {
-	position = startingPosition;
+	GetPosition() = startingPosition;
 	SpecificRestart();
 }
 
@@ -4,10 +4,12 @@
 #include "Point.h"
 #include "Animation.h"
 #include "BitMaskColliderLayers.h"
+#include "EntityStore.h"
 #include "PugiXml/src/pugixml.hpp"
 
 class b2Fixture;
 class PhysBody;
+struct BodyArchetype;
 enum class BodyType;
 
 enum class RenderModes
@@ -37,7 +39,6 @@ public:
 
 	void Disable();
 	virtual bool Stop();
-	virtual bool UpdateProjectiles();
 
 	virtual bool Update();
 	virtual bool Pause() const;
@@ -54,26 +55,61 @@ public:
 
 	virtual void DrawDebug() const { /* Method to Override */ };
 
-	bool active = true;
-
-	bool disableOnNextUpdate = false;
+	// Its state is kept in the arrays of its table in the EntityStore,
+	// these read and write its entry
+	iPoint &GetPosition() { return columns->positions[storeIndex]; }
+	iPoint const &GetPosition() const { return columns->positions[storeIndex]; }
+	b2Vec2 &GetVelocity() { return columns->velocities[storeIndex]; }
+	b2Vec2 const &GetVelocity() const { return columns->velocities[storeIndex]; }
+	std::shared_ptr<Animation> &GetAnimation() { return columns->animations[storeIndex]; }
+	std::shared_ptr<Animation> const &GetAnimation() const { return columns->animations[storeIndex]; }
+
+	bool IsActive() const { return HasFlag(ENTITY_ACTIVE); }
+	void SetActive(bool bActive) { SetFlag(ENTITY_ACTIVE, bActive); }
+	// Disabled this frame, it will be stopped at the start of the next one
+	bool IsStopPending() const { return HasFlag(ENTITY_STOP_PENDING); }
+
+	// Outside the activation region: its body is inactive and it's neither thought nor drawn
+	bool IsDormant() const { return HasFlag(ENTITY_DORMANT); }
+	// Deactivates the body when going dormant, reactivates it when waking up
+	void SetDormant(bool dormant);
+
+	// Also keeps the body of its entry in the store
+	void SetBody(std::unique_ptr<PhysBody> body);
+	// Copies the position and velocity of its body to its entry
+	void ReadBody();
 
 	int id = -1;
+	// Table of the EntityStore it belongs to and its index in it
+	EntityColumns *columns = nullptr;
+	int storeIndex = -1;
 	std::string name = "unknown";
 	CL::ColliderLayers type = CL::ColliderLayers::UNKNOWN;
 
-	iPoint position;
 	iPoint startingPosition;
 	iPoint colliderOffset;
 
-	std::shared_ptr<Animation> texture;
 	int imageVariation = -1;
 
 	std::unique_ptr<PhysBody> pBody;
+	// Shared by every entity of the same class
+	std::shared_ptr<BodyArchetype const> bodyArchetype;
 
 	pugi::xml_node parameters;
 	std::string texturePath;
 	std::string fxPath;
+
+private:
+	bool HasFlag(uchar flag) const
+	{
+		return (columns->flags[storeIndex] & flag) != 0;
+	}
+
+	void SetFlag(uchar flag, bool bSet)
+	{
+		if(bSet) columns->flags[storeIndex] |= flag;
+		else columns->flags[storeIndex] &= static_cast<uchar>(~flag);
+	}
 };
 
 #endif // __ENTITY_H__
\ No newline at end of file
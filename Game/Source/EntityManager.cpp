@@ -4,9 +4,12 @@
 #include "Player.h"
 #include "Item.h"
 #include "Enemy.h"
+#include "ProjectileManager.h"
 
 #include "Map.h"
 #include "Window.h"
+#include "Render.h"
+#include "FrameBudget.h"
 
 #include "Defs.h"
 #include "Log.h"
@@ -14,6 +17,47 @@
 #include <regex>
 #include <locale>		// std::tolower
 
+namespace
+{
+	// Calls f on every entity, items first so the characters are drawn over them.
+	// Stops at the first call that returns false.
+	template<class F>
+	bool ForEachEntity(EntityStore const &store, F &&f)
+	{
+		for(auto const &item : store.items.facades)
+		{
+			if(!f(*item)) return false;
+		}
+		for(auto const &enemy : store.enemies.facades)
+		{
+			if(!f(*enemy)) return false;
+		}
+		for(auto const &player : store.players.facades)
+		{
+			if(!f(*player)) return false;
+		}
+		return true;
+	}
+
+	// Same, only with the entities of table that are awake
+	template<class T, class F>
+	bool ForEachAwake(ArchetypeTable<T> const &table, F &&f)
+	{
+		for(int i = 0; i < table.Size(); i++)
+		{
+			if(!table.IsAwake(i)) continue;
+			if(!f(*table.facades[i])) return false;
+		}
+		return true;
+	}
+
+	template<class F>
+	bool ForEachAwake(EntityStore const &store, F &&f)
+	{
+		return ForEachAwake(store.items, f) && ForEachAwake(store.enemies, f) && ForEachAwake(store.players, f);
+	}
+}
+
 EntityManager::EntityManager() : Module()
 {
 	name = "entitymanager";
@@ -29,29 +73,25 @@ bool EntityManager::Awake(pugi::xml_node& config)
 
 	itemPath = config.attribute("items").as_string();
 
-	for(auto const &[entityType, entityInfo] : allEntities)
+	if(auto activation = config.child("activation"); activation)
 	{
-		for(auto const &entity : entityInfo.entities)
-		{
-			if(!IsEntityActive(entity.get())) continue;
-			if(!entity->Awake()) return false;
-		}
+		activationMargin = activation.attribute("margin").as_int(activationMargin);
+		activationHysteresis = activation.attribute("hysteresis").as_int(activationHysteresis);
 	}
-	return true;
+
+	return ForEachEntity(store, [this](auto &entity)
+	{
+		return !IsEntityActive(&entity) || entity.Awake();
+	});
 }
 
 bool EntityManager::Start() 
 {
-	CreateAllColliders();
-
-	for(auto const &[entityType, entityInfo] : allEntities)
+	bool bStarted = ForEachEntity(store, [this](auto &entity)
 	{
-		for(auto const &entity : entityInfo.entities)
-		{
-			if(!IsEntityActive(entity.get())) continue;
-			if(!entity->Start()) return false;
-		}
-	}
+		return !IsEntityActive(&entity) || entity.Start();
+	});
+	if(!bStarted) return false;
 
 	player = GetPlayerCharacter();
 
@@ -61,83 +101,85 @@ bool EntityManager::Start()
 // Called before quitting
 bool EntityManager::CleanUp()
 {
-	for(auto const &[entityType, entityInfo] : allEntities)
+	bool bCleaned = ForEachEntity(store, [](auto &entity)
 	{
-		for(auto const &entity : entityInfo.entities)
-		{
-			if(!DoesEntityExist(entity.get())) continue;
-			if(!entity->CleanUp()) return false;
-		}
-	}
+		return entity.CleanUp();
+	});
+	if(!bCleaned) return false;
+
+	bodyArchetypes.clear();
+	itemArchetypes.clear();
+
 	return true;
 }
 
 void EntityManager::CreateEntity(std::string const &entityClass, pugi::xml_node const &parameters)
 {
-	// Get correct ID
-	int id = allEntities[entityClass].entities.size();
-
-	// Initialize pointer if node is a character, nullptr otherwise
-	std::unique_ptr<Character>characterPtr = nullptr;
 	if(StrEquals(entityClass, "player"))
-	{
-		characterPtr = std::make_unique<Player>(parameters);
-		allEntities[entityClass].type = CL::ColliderLayers::PLAYER;
-	}
+		store.AddPlayer(std::make_unique<Player>(parameters));
 	else if(StrEquals(entityClass, "enemy"))
-	{
-		characterPtr = std::make_unique<Enemy>(parameters, id);
-		allEntities[entityClass].type = CL::ColliderLayers::ENEMIES;
-	}
+		store.AddEnemy(std::make_unique<Enemy>(parameters, store.enemies.Size()));
 	else
 	{
 		// If it's not a previous case, we either misstyped something or it's an item/object
-		LOG("Entity %s could not be created.", entityClass);
-		return;
+		LOG("Entity %s could not be created.", entityClass.c_str());
 	}
-
-	// Move the pointer to its place
-	allEntities[entityClass].entities.push_back(std::move(characterPtr));
-
 }
 
 bool EntityManager::DestroyEntity(std::string const &type, int id)
 {
-	if(id < 0 || !allEntities.contains(type)) return false;
-
-	allEntities[type].entities.at(id)->Stop();
-	allEntities[type].entities.at(id).reset();
-	allEntities[type].entities.erase(allEntities[type].entities.begin() + id);
-
-	return true;
+	auto stop = [id](auto const &table)
+	{
+		if(id < 0 || id >= table.Size()) return false;
+		table.facades[id]->Stop();
+		return true;
+	};
+
+	using enum EntityArchetype;
+	if(StrEquals(type, "player")) return stop(store.players) && store.Remove(PLAYER, id);
+	if(StrEquals(type, "enemy")) return stop(store.enemies) && store.Remove(ENEMY, id);
+	return stop(store.items) && store.Remove(ITEM, id);
 }
 
 bool EntityManager::LoadAllTextures() const
 {
-	using enum CL::ColliderLayers;
-	auto excludedFlag = PLATFORMS | ITEMS;
-	for(auto const &[name, info] : allEntities)
+	// Items load their animations in LoadItemAnimations
+	for(auto const &character : store.players.facades)
 	{
-		// If the type matches any value in excludedFlag go to next entity
-		if((info.type & excludedFlag) != 0) continue;
-
-		// If it doesn't, add textures for all entities with that name
-		for(auto const &entity : info.entities)
-		{
-			if(!IsEntityActive(entity.get())) continue;
-			dynamic_cast<Character *>(entity.get())->AddTexturesAndAnimationFrames();
-		}
+		if(IsEntityActive(character.get())) character->AddTexturesAndAnimationFrames();
+	}
+	for(auto const &character : store.enemies.facades)
+	{
+		if(IsEntityActive(character.get())) character->AddTexturesAndAnimationFrames();
 	}
 	return true;
 }
 
+std::shared_ptr<BodyArchetype const> EntityManager::GetBodyArchetype(std::string_view archetypeName) const
+{
+	if(auto it = bodyArchetypes.find(archetypeName); it != bodyArchetypes.end())
+		return it->second;
+	return nullptr;
+}
+
+void EntityManager::AddBodyArchetype(std::string const &archetypeName, std::shared_ptr<BodyArchetype const> archetype)
+{
+	bodyArchetypes[archetypeName] = std::move(archetype);
+}
+
 bool EntityManager::LoadEntities(TileInfo const *tileInfo, iPoint pos, int width, int height)
 {
 	std::string aux = *(std::get_if<std::string>(&tileInfo->properties.find("EntityClass")->second));
 	aux[0] = std::tolower(aux[0], std::locale());
 	
-	allEntities[aux].entities.push_back(std::make_unique<Item>(tileInfo, pos, width, height));
-	allEntities[aux].type = static_cast<CL::ColliderLayers>(*(std::get_if<int>(&tileInfo->properties.find("ColliderLayers")->second)));
+	auto item = std::make_unique<Item>(tileInfo, pos, width, height);
+
+	// Items from the same tile share their body
+	auto &archetype = itemArchetypes[tileInfo];
+	if(!archetype) archetype = item->CompileBodyArchetype();
+	item->bodyArchetype = archetype;
+
+	store.AddItem(std::move(item), aux);
 
 	return true;
 }
@@ -183,22 +225,24 @@ void EntityManager::LoadItemAnimations()
 		entityClass[0] = (char)std::tolower(entityClass[0]);
 
 		// Check if we have an entiy with m[1] class
-		if(auto entityTypeInfo = allEntities.find(entityClass); 
-		   entityTypeInfo == allEntities.end())
+		int itemClass = store.FindItemClass(entityClass);
+		if(itemClass < 0)
 			continue;
 
 		Item const *entity = nullptr;
 		int variation = 0;
 
 		// For all entities of that class...
-		for(auto const &elem : allEntities[entityClass].entities)
+		for(int i = 0; i < store.items.Size(); i++)
 		{
+			if(store.itemClasses[i] != itemClass) continue;
+
 			// Check if we have one with m[2] animation number
 			// If we do, we have to load the animation
-			if(variation = elem.get()->imageVariation; 
+			if(variation = store.items.facades[i]->imageVariation; 
 			   variation == std::stoi(m.str(2)))
 			{
-				entity = dynamic_cast<Item*>(elem.get());
+				entity = store.items.facades[i].get();
 				break;
 			}
 		}
@@ -206,11 +250,13 @@ void EntityManager::LoadItemAnimations()
 		if(!DoesEntityExist(entity)) continue;
 
 		// Check if we already have the animation on the Animation map
-		if(auto anim = allEntities[entityClass].animation.find(std::stoi(m.str(2)));
-		   anim == allEntities[entityClass].animation.end())
+		auto &animations = store.GetItemClassAnimations(itemClass);
+		if(auto anim = animations.find(std::stoi(m.str(2)));
+		   anim == animations.end())
 		{
 			// If we don't, we create a new one
-			allEntities[entityClass].animation[variation] = std::make_shared<Animation>();
+			animations[variation] = std::make_shared<Animation>();
+			store.AddItemAnimation(animations[variation]);
 		}
 
 		// Create the path of the file
@@ -218,7 +264,7 @@ void EntityManager::LoadItemAnimations()
 		std::string fileName = itemPath + std::string(m[0]);
 
 		auto animationName = std::string(m[3]);
-		[[likely]] if(auto const frameCount = allEntities[entityClass].animation[variation]->AddFrame(fileName.c_str(), animationName); 
+		[[likely]] if(auto const frameCount = animations[variation]->AddFrame(fileName.c_str(), animationName); 
 		   frameCount != 1) 
 		{	
 			//If we have more than one frame we don't need to set up properties
@@ -229,26 +275,26 @@ void EntityManager::LoadItemAnimations()
 		/*
 		if(auto speed = entity->info->properties.find("AnimationSpeed")
 		   speed != entity->info->properties.end() && std::get<float>(speed->second) > 0)
-			allEntities[entityClass].animation[variation]->SetSpeed(std::get<float>(speed->second))
+			animations[variation]->SetSpeed(std::get<float>(speed->second))
 		else
 	
 		if(auto speed = entity->info->properties.find("AnimationStyle")
 		   speed != entity->info->properties.end() && std::get<int>(speed->second) > 0)
-			allEntities[entityClass].animation[variation]->SetAnimStyle(static_cast<AnimIteration>(std::get<int>(speed->second)))
+			animations[variation]->SetAnimStyle(static_cast<AnimIteration>(std::get<int>(speed->second)))
 		else
 		*/
 
-		allEntities[entityClass].animation[variation]->SetSpeed(0.1f);
-		allEntities[entityClass].animation[variation]->SetAnimStyle(AnimIteration::LOOP_FROM_START);
+		animations[variation]->SetSpeed(0.1f);
+		animations[variation]->SetAnimStyle(AnimIteration::LOOP_FROM_START);
 
-		for(auto const &elem : allEntities[entityClass].entities)
+		for(int i = 0; i < store.items.Size(); i++)
 		{
-			auto *itemEntity = dynamic_cast<Item *>(elem.get());
-			if(!itemEntity || itemEntity->anim) continue;
+			Item *itemEntity = store.items.facades[i].get();
+			if(store.itemClasses[i] != itemClass || store.items.animations[i]) continue;
 			if(variation = itemEntity->imageVariation;
 			   variation == std::stoi(m.str(2)))
 			{
-				itemEntity->anim = allEntities[entityClass].animation[variation];
+				store.items.animations[i] = animations[variation];
 			}
 		}
 
@@ -257,25 +303,35 @@ void EntityManager::LoadItemAnimations()
 	free(folderList);
 }
 
-bool EntityManager::IsEntityActive(Entity const *entity) const
+uint64 EntityManager::GetStateChecksum() const
 {
-	if(!entity) return false;
-	if(!entity->active) return false;
-	return true;
+	// Only characters move and get hurt
+	uint64 checksum = FNV_OFFSET_BASIS;
+	auto hashCharacter = [&checksum, this](Character const &character)
+	{
+		if(!IsEntityActive(&character)) return true;
+		checksum = HashBytes(&character.GetPosition(), sizeof(iPoint), checksum);
+		checksum = HashBytes(&character.hp, sizeof(character.hp), checksum);
+		return true;
+	};
+
+	for(auto const &character : store.players.facades)
+		hashCharacter(*character);
+	for(auto const &character : store.enemies.facades)
+		hashCharacter(*character);
+	return checksum;
 }
 
-void EntityManager::CreateAllColliders() const
+EnemyAI &EntityManager::GetEnemyAI(int index)
 {
-	for(auto const &[entityType, entityInfo] : allEntities)
-	{
-		if(StrEquals(entityType, "player")) continue;
+	return store.enemyAI[index];
+}
 
-		for(auto const &entity : entityInfo.entities)
-		{
-			if(!IsEntityActive(entity.get()) || StrEquals(entity->name, "item"))
-				continue;
-		}
-	}
+bool EntityManager::IsEntityActive(Entity const *entity) const
+{
+	if(!entity) return false;
+	if(!entity->IsActive()) return false;
+	return true;
 }
 
 bool EntityManager::DoesEntityExist(Entity const *entity) const
@@ -284,129 +340,235 @@ bool EntityManager::DoesEntityExist(Entity const *entity) const
 	return false;
 }
 
-bool EntityManager::PreUpdate()
+void EntityManager::UpdateActivationRegion()
 {
-	for(auto const &[entityType, entityInfo] : allEntities)
+	// Camera position is the negated screen position of the world origin,
+	// both are in screen pixels: world = screen / scale
+	SDL_Rect const &camera = app->render->GetCamera();
+	int scale = std::max(static_cast<int>(app->win->GetScale()), 1);
+	SDL_Rect wakeRegion = {
+		-camera.x / scale - activationMargin,
+		-camera.y / scale - activationMargin,
+		camera.w / scale + 2 * activationMargin,
+		camera.h / scale + 2 * activationMargin
+	};
+	SDL_Rect sleepRegion = {
+		wakeRegion.x - activationHysteresis,
+		wakeRegion.y - activationHysteresis,
+		wakeRegion.w + 2 * activationHysteresis,
+		wakeRegion.h + 2 * activationHysteresis
+	};
+
+	// The player is always awake
+	auto updateTable = [&wakeRegion, &sleepRegion](auto &table)
 	{
-		for(auto const &entity : entityInfo.entities)
+		for(int i = 0; i < table.Size(); i++)
 		{
-			if(entity->disableOnNextUpdate) entity->Stop();
-			if((entity->type & CL::ColliderLayers::ENEMIES) == CL::ColliderLayers::ENEMIES)
-			{
-				auto enemy = dynamic_cast<Enemy *>(entity.get());
-
-				// If the cast failed
-				if(!enemy) continue;
-
-				auto b = enemy->SetBehaviour(player->position, app->win->GetWindowSize());
-
-				if(!player->DidChangeTile() && !enemy->bRequestPath) continue;
-
-				// Get destination coordinates depending on the type of terrain the enemy can go through
-				iPoint destinationCoords = {0, 0};
-
-				using enum BehaviourState;
-				if(b == AGGRO)
-				{
-					destinationCoords = app->pathfinding->GetDestinationCoordinates(player->position, enemy->pTerrain);
-					// Fix X coordinate if enemy is right of the player
-					// Adjust Y position for air enemis, they'll look for the one above the player
-					if(enemy->pTerrain == PathfindTerrain::AIR)
-						destinationCoords.y--;
-				}
-				else if(b == PATROL && (!enemy->path || enemy->currentPathIndex + 1 >= enemy->path->size()))
-					destinationCoords = app->pathfinding->GetPatrolCoordinates(enemy->position, enemy->dir, enemy->pTerrain, enemy->patrolRadius);
-				else
-					continue;
-								
-				if(destinationCoords == app->map->WorldToCoordinates(enemy->position)) continue;
-
-				enemy->SetPath(destinationCoords);
-			}
+			if((table.flags[i] & ENTITY_ACTIVE) == 0 || !table.bodies[i]) continue;
+
+			bool bDormant = (table.flags[i] & ENTITY_DORMANT) != 0;
+			SDL_Point point = {table.positions[i].x, table.positions[i].y};
+			if(bDormant == SDL_PointInRect(&point, bDormant ? &wakeRegion : &sleepRegion)) continue;
+
+			table.facades[i]->SetDormant(!bDormant);
 		}
-	}
+	};
+	updateTable(store.items);
+	updateTable(store.enemies);
+}
+
+bool EntityManager::PreUpdate()
+{
+	store.StopDisabled();
+	UpdateActivationRegion();
+	ScheduleEnemyAI();
+	SenseEnemies();
+	UpdateEnemyAI();
 	return true;
 };
 
-void EntityManager::RestartLevel() const
+void EntityManager::ScheduleEnemyAI()
 {
-	for(auto const &[entityType, entityInfo] : allEntities)
+	thinkingEnemies.clear();
+
+	auto const &enemies = store.enemies;
+	iPoint playerTile = app->map->WorldToCoordinates(player->GetPosition());
+	for(int i = 0; i < enemies.Size(); i++)
 	{
-		for(auto const &entity : entityInfo.entities)
-		{
-			if(!entity->active) entity->Start();
-			entity->RestartLevel();
-		}
+		if((enemies.flags[i] & ENTITY_DORMANT) != 0) continue;
+
+		// Over budget, enemies far from the player think every few frames, each on a different one
+		EnemyAI &ai = store.enemyAI[i];
+		ai.framesSinceTick++;
+		iPoint distance = app->map->WorldToCoordinates(enemies.positions[i]) - playerTile;
+		if(app->budget->IsAITick(std::max(std::abs(distance.x), std::abs(distance.y)), static_cast<uint>(i)))
+			thinkingEnemies.push_back(i);
 	}
 }
 
-bool EntityManager::PostUpdate()
+void EntityManager::UpdateEnemyAI()
 {
-	for(auto const &[entityType, entityInfo] : allEntities)
+	auto &enemies = store.enemies;
+	iPoint windowSize = app->win->GetWindowSize();
+	for(int i : thinkingEnemies)
 	{
-		for(auto const &entity : entityInfo.entities)
-		{
-			if(!IsEntityActive(entity.get())) continue;
-			if(app->physics->IsDebugActive()) entity->DrawDebug();
-			entity->UpdateProjectiles();
-		}
+		Enemy *enemy = enemies.facades[i].get();
+		EnemyAI &ai = store.enemyAI[i];
+		auto previous = ai.behaviour;
+		auto b = Enemy::UpdateBehaviour(ai, player->GetPosition().x - enemies.positions[i].x, windowSize.x);
+		if(b != previous) enemy->bRequestPath = true;
+		if(b == BehaviourState::AGGRO) enemy->RangedAttack(player->GetPosition());
+
+		if(player->DidChangeTile() || enemy->bRequestPath) RequestEnemyPath(i, b);
+
+		// Searches are spread over several frames, each one gets a few expansions per frame.
+		// A search requested just now takes its first ones here too.
+		enemy->UpdatePathSearch(app->pathfinding->GetExpansionsPerFrame());
 	}
-	return true;
 }
 
-bool EntityManager::Update(float dt)
+void EntityManager::RequestEnemyPath(int index, BehaviourState behaviour)
 {
-	for(auto const &[entityType, entityInfo] : allEntities)
+	Enemy *enemy = store.enemies.facades[index].get();
+	iPoint position = store.enemies.positions[index];
+
+	// Get destination coordinates depending on the type of terrain the enemy can go through
+	iPoint destinationCoords = {0, 0};
+
+	using enum BehaviourState;
+	if(behaviour == AGGRO)
 	{
-		if(!(StrEquals(entityType, "player") || StrEquals(entityType, "enemy")))
-		{
-			for(auto const &[key, anim] : entityInfo.animation)
-			{
-				anim->UpdateAndGetFrame();
-			}
-		}
-		for(auto const &entity : entityInfo.entities)
-		{
-			if(!IsEntityActive(entity.get())) continue;
-			if(!entity->Update()) return false;
-		}
+		destinationCoords = app->pathfinding->GetDestinationCoordinates(player->GetPosition(), enemy->pTerrain);
+		// Fix X coordinate if enemy is right of the player
+		// Adjust Y position for air enemis, they'll look for the one above the player
+		if(enemy->pTerrain == PathfindTerrain::AIR)
+			destinationCoords.y--;
 	}
-	return true;
+	else if(behaviour == PATROL && (!enemy->path || enemy->currentPathIndex + 1 >= enemy->path->size()))
+		destinationCoords = app->pathfinding->GetPatrolCoordinates(position, enemy->dir, enemy->pTerrain, enemy->patrolRadius);
+	else
+		return;
+
+	if(destinationCoords == app->map->WorldToCoordinates(position)) return;
+
+	enemy->SetPath(destinationCoords);
 }
 
-bool EntityManager::Pause(int phase)
+void EntityManager::SenseEnemies()
 {
-	for(auto const &[entityType, entityInfo] : allEntities)
+	sensingEnemies.clear();
+	senseQueries.clear();
+
+	// Only the enemies that think this frame look, the others keep what they saw
+	auto const &enemies = store.enemies;
+	for(int i : thinkingEnemies)
 	{
-		for(auto const &entity : entityInfo.entities)
-		{
-			if(!IsEntityActive(entity.get())) continue;
-			if(!entity->Pause()) return false;
-		}
+		store.enemyAI[i].bSeesPlayer = false;
+		if(!enemies.IsAwake(i) || !enemies.bodies[i]) continue;
+		// Idle enemies only wake up by distance, they don't need to see
+		if(store.enemyAI[i].behaviour != BehaviourState::IDLE) sensingEnemies.push_back(i);
 	}
+
+	if(sensingEnemies.empty() || !player || !player->pBody) return;
+
+	auto tileWidth = static_cast<float>(app->map->GetTileWidth());
+	auto tileHeight = static_cast<float>(app->map->GetTileHeight());
+	for(int i : sensingEnemies)
+	{
+		senseQueries.push_back({
+			.type = SpatialQueryType::RADIUS,
+			.a = PIXEL_TO_METERS(enemies.positions[i]),
+			.radius = PIXEL_TO_METERS(static_cast<float>(store.enemyAI[i].aggroRadius) * tileWidth),
+			.mask = static_cast<uint16>(CL::ColliderLayers::PLAYER),
+			.ignore = enemies.bodies[i]->body
+		});
+	}
+
+	// Each query only has to find the player, one hit is enough
+	senseResults.resize(senseQueries.size());
+	senseHits.resize(senseQueries.size());
+	app->physics->RunQueries(senseQueries, senseResults, senseHits);
+
+	// Then the ones close enough check their sight against the tiles, all in one batch
+	sightEnemies.clear();
+	sightFrom.clear();
+	sightTo.clear();
+	fPoint target = {static_cast<float>(player->GetPosition().x) / tileWidth, static_cast<float>(player->GetPosition().y) / tileHeight};
+	for(size_t i = 0; i < sensingEnemies.size(); i++)
+	{
+		if(senseResults[i].count == 0) continue;
+
+		iPoint position = enemies.positions[sensingEnemies[i]];
+		sightEnemies.push_back(sensingEnemies[i]);
+		sightFrom.push_back({static_cast<float>(position.x) / tileWidth, static_cast<float>(position.y) / tileHeight});
+		sightTo.push_back(target);
+	}
+
+	sightVisible.resize(sightEnemies.size());
+	app->pathfinding->LineOfSight(sightFrom, sightTo, sightVisible);
+
+	for(size_t i = 0; i < sightEnemies.size(); i++)
+		store.enemyAI[sightEnemies[i]].bSeesPlayer = (sightVisible[i] != 0);
+}
+
+void EntityManager::RestartLevel() const
+{
+	app->projectiles->Clear();
+
+	ForEachEntity(store, [](auto &entity)
+	{
+		if(!entity.IsActive()) entity.Start();
+		entity.RestartLevel();
+		return true;
+	});
+}
+
+bool EntityManager::PostUpdate()
+{
+	if(!app->physics->IsDebugActive()) return true;
+
+	ForEachAwake(store, [](auto &entity)
+	{
+		entity.DrawDebug();
+		return true;
+	});
 	return true;
 }
 
+bool EntityManager::Update(float dt)
+{
+	for(auto const &anim : store.itemAnimations)
+		anim->UpdateAndGetFrame();
+
+	return ForEachAwake(store, [](auto &entity)
+	{
+		return entity.Update();
+	});
+}
+
+bool EntityManager::Pause(int phase)
+{
+	return ForEachAwake(store, [](auto &entity)
+	{
+		return entity.Pause();
+	});
+}
+
 Player *EntityManager::GetPlayerCharacter() const
 {
-	if(auto it = allEntities.find("player");
-	   it != allEntities.end())
-		return dynamic_cast<Player *>(it->second.entities.front().get());
-	return nullptr;
+	if(store.players.facades.empty()) return nullptr;
+	return store.players.facades.front().get();
 }
 
 pugi::xml_node EntityManager::SaveState(pugi::xml_node const &data) const
 {
 	pugi::xml_node temp = data;
 	temp = temp.append_child("entitymanager");
-	for(auto const &[name, entityInfo]: allEntities)
+	ForEachEntity(store, [&temp](auto &entity)
 	{
-		for(auto const &entity : entityInfo.entities)
-		{
-			if(!entity->HasSaveData()) continue;
-			entity->SaveState(temp);
-		}
-	}
+		if(entity.HasSaveData()) entity.SaveState(temp);
+		return true;
+	});
 	return temp;
 }
 
@@ -3,20 +3,24 @@
 
 #include "Module.h"
 #include "Entity.h"
+#include "EntityStore.h"
 
 #include "BitMaskColliderLayers.h"
+#include "Defs.h"
 
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 class Player;
+class Enemy;
 struct TileInfo;
-
-struct EntityInfo
-{
-	CL::ColliderLayers type = CL::ColliderLayers::UNKNOWN;
-	std::vector<std::unique_ptr<Entity>> entities;
-	std::unordered_map<int, std::shared_ptr<Animation>> animation;
-};
+struct BodyArchetype;
+struct SpatialQuery;
+struct SpatialQueryResult;
+struct RayCastHit;
 
 class EntityManager : public Module
 {
@@ -56,6 +60,17 @@ public:
 	bool LoadEntities(TileInfo const *tileInfo, iPoint pos, int width, int height);
 	void LoadItemAnimations();
 
+	// ------ Body archetypes
+	// nullptr if no entity has added one with that name yet
+	std::shared_ptr<BodyArchetype const> GetBodyArchetype(std::string_view archetypeName) const;
+	void AddBodyArchetype(std::string const &archetypeName, std::shared_ptr<BodyArchetype const> archetype);
+
+	// Hash of the position and HP of every character, to check that replays are deterministic
+	uint64 GetStateChecksum() const;
+
+	// ------ Entity store
+	EnemyAI &GetEnemyAI(int index);
+
 private:
 	// ------ Utils
 	// --- Getters
@@ -64,17 +79,53 @@ private:
 	bool HasSaveData() const final;
 	bool DoesEntityExist(Entity const *entity = nullptr) const;
 	bool IsEntityActive(Entity const *entity = nullptr) const;
-	// --- Constructors
-	void CreateAllColliders() const;
 
-	using EntityMap = std::unordered_map<std::string, EntityInfo, StringHash, std::equal_to<>>;
-	// key1 = ColliderLayer
-	// value 1, key 2 = string type of entity
-	// value2 = <vector of entities, list of empty elements, map of animations>
-	EntityMap allEntities;
+	// ------ Activation region
+	// Puts to sleep every entity that left the camera plus activationMargin
+	// and wakes the ones that came back. Entities have to go activationHysteresis
+	// further out to fall asleep, so the ones on the edge don't keep switching.
+	void UpdateActivationRegion();
+
+	// ------ Senses
+	// Chooses the enemies that think this frame. Over budget the far ones skip frames.
+	void ScheduleEnemyAI();
+	// Finds which of them have the player inside their aggro radius, in a
+	// single batch of Physics queries, and then which of those see it past the
+	// solid tiles, in a single batch of Pathfinding::LineOfSight
+	void SenseEnemies();
+
+	// ------ Systems
+	// Enemies think: behaviour, attacks and path requests
+	void UpdateEnemyAI();
+	// Starts the search of the enemy at index towards where its behaviour takes it
+	void RequestEnemyPath(int index, BehaviourState behaviour);
+
+	// Every entity, grouped by archetype
+	EntityStore store;
 	Player *player;
 	std::string itemPath;
 
+	// "<entity name>/<class>" of characters, one per tile for items
+	std::unordered_map<std::string, std::shared_ptr<BodyArchetype const>, StringHash, std::equal_to<>> bodyArchetypes;
+	std::unordered_map<TileInfo const *, std::shared_ptr<BodyArchetype const>> itemArchetypes;
+
+	// Enemies that think this frame, as store indices
+	std::vector<int> thinkingEnemies;
+	// Reused every frame by SenseEnemies, one query per enemy. Enemies are store indices.
+	std::vector<int> sensingEnemies;
+	std::vector<SpatialQuery> senseQueries;
+	std::vector<SpatialQueryResult> senseResults;
+	std::vector<RayCastHit> senseHits;
+	// Enemies near the player and their sight lines, in tiles
+	std::vector<int> sightEnemies;
+	std::vector<fPoint> sightFrom;
+	std::vector<fPoint> sightTo;
+	std::vector<uchar> sightVisible;
+
+	// In pixels
+	int activationMargin = 256;
+	int activationHysteresis = 128;
+
 	friend class UI;
 };
 
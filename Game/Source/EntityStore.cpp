@@ -0,0 +1,159 @@
+#include "EntityStore.h"
+
+#include "Player.h"
+#include "Enemy.h"
+#include "Item.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+	template<class T>
+	int AddToTable(ArchetypeTable<T> &table, std::unique_ptr<T> facade)
+	{
+		int index = table.Size();
+		facade->columns = &table;
+		facade->storeIndex = index;
+		table.bodies.push_back(nullptr);
+		table.positions.emplace_back();
+		table.velocities.emplace_back(0.0f, 0.0f);
+		table.animations.emplace_back();
+		table.flags.push_back(ENTITY_ACTIVE);
+		table.facades.push_back(std::move(facade));
+		return index;
+	}
+
+	template<class T>
+	void RemoveFromTable(ArchetypeTable<T> &table, int index)
+	{
+		int last = table.Size() - 1;
+		if(index != last)
+		{
+			table.facades[index] = std::move(table.facades[last]);
+			table.facades[index]->storeIndex = index;
+			table.bodies[index] = table.bodies[last];
+			table.positions[index] = table.positions[last];
+			table.velocities[index] = table.velocities[last];
+			table.animations[index] = std::move(table.animations[last]);
+			table.flags[index] = table.flags[last];
+		}
+		table.facades.pop_back();
+		table.bodies.pop_back();
+		table.positions.pop_back();
+		table.velocities.pop_back();
+		table.animations.pop_back();
+		table.flags.pop_back();
+	}
+
+	template<class T>
+	void ClearTable(ArchetypeTable<T> &table)
+	{
+		table.facades.clear();
+		table.bodies.clear();
+		table.positions.clear();
+		table.velocities.clear();
+		table.animations.clear();
+		table.flags.clear();
+	}
+
+	template<class T>
+	void StopDisabledInTable(ArchetypeTable<T> &table)
+	{
+		for(int i = 0; i < table.Size(); i++)
+		{
+			if((table.flags[i] & ENTITY_STOP_PENDING) != 0) table.facades[i]->Stop();
+		}
+	}
+}
+
+EntityStore::EntityStore() = default;
+
+EntityStore::~EntityStore() = default;
+
+int EntityStore::AddPlayer(std::unique_ptr<Player> player)
+{
+	return AddToTable(players, std::move(player));
+}
+
+int EntityStore::AddEnemy(std::unique_ptr<Enemy> enemy)
+{
+	enemyAI.emplace_back();
+	return AddToTable(enemies, std::move(enemy));
+}
+
+int EntityStore::AddItem(std::unique_ptr<Item> item, std::string_view itemClass)
+{
+	int classIndex = FindItemClass(itemClass);
+	if(classIndex < 0)
+	{
+		classIndex = static_cast<int>(itemClassNames.size());
+		itemClassNames.emplace_back(itemClass);
+		itemClassAnimations.emplace_back();
+	}
+
+	itemClasses.push_back(classIndex);
+	return AddToTable(items, std::move(item));
+}
+
+bool EntityStore::Remove(EntityArchetype archetype, int index)
+{
+	using enum EntityArchetype;
+	switch(archetype)
+	{
+		case PLAYER:
+			if(index < 0 || index >= players.Size()) return false;
+			RemoveFromTable(players, index);
+			return true;
+		case ENEMY:
+			if(index < 0 || index >= enemies.Size()) return false;
+			enemyAI[index] = enemyAI.back();
+			enemyAI.pop_back();
+			RemoveFromTable(enemies, index);
+			return true;
+		case ITEM:
+			if(index < 0 || index >= items.Size()) return false;
+			itemClasses[index] = itemClasses.back();
+			itemClasses.pop_back();
+			RemoveFromTable(items, index);
+			return true;
+		default:
+			return false;
+	}
+}
+
+void EntityStore::Clear()
+{
+	ClearTable(players);
+	ClearTable(enemies);
+	enemyAI.clear();
+	ClearTable(items);
+	itemClasses.clear();
+	itemAnimations.clear();
+	itemClassNames.clear();
+	itemClassAnimations.clear();
+}
+
+void EntityStore::StopDisabled()
+{
+	StopDisabledInTable(players);
+	StopDisabledInTable(enemies);
+	StopDisabledInTable(items);
+}
+
+int EntityStore::FindItemClass(std::string_view itemClass) const
+{
+	auto it = std::ranges::find(itemClassNames, itemClass);
+	return (it != itemClassNames.end()) ? static_cast<int>(it - itemClassNames.begin()) : -1;
+}
+
+std::unordered_map<int, std::shared_ptr<Animation>> &EntityStore::GetItemClassAnimations(int itemClass)
+{
+	return itemClassAnimations[itemClass];
+}
+
+void EntityStore::AddItemAnimation(std::shared_ptr<Animation> animation)
+{
+	if(std::ranges::find(itemAnimations, animation) == itemAnimations.end())
+		itemAnimations.push_back(std::move(animation));
+}
@@ -0,0 +1,134 @@
+#ifndef __ENTITYSTORE_H__
+#define __ENTITYSTORE_H__
+
+#include "Defs.h"
+#include "Point.h"
+
+#include "Box2D/Box2D/Box2D.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class Player;
+class Enemy;
+class Item;
+class PhysBody;
+class Animation;
+
+enum class BehaviourState : int
+{
+	IDLE = 0x0000,
+	PATROL = 0x0001,
+	AGGRO = 0x0002,
+	DEAD = 0x0004
+};
+
+enum class EntityArchetype : uchar
+{
+	PLAYER,
+	ENEMY,
+	ITEM
+};
+
+// What an enemy is thinking
+struct EnemyAI
+{
+	BehaviourState behaviour = BehaviourState::IDLE;
+	// Player inside aggroRadius with no solid tile in between. EntityManager senses it every frame.
+	bool bSeesPlayer = false;
+	// Frames in AGGRO without seeing the player
+	int lostSightFrames = 0;
+	// Frames since it last thought, 1 unless the budget makes it skip some
+	int framesSinceTick = 0;
+	// In tiles
+	int aggroRadius = 8;
+};
+
+// Bits of EntityColumns::flags
+constexpr uchar ENTITY_ACTIVE = 0x01;
+constexpr uchar ENTITY_DORMANT = 0x02;
+// Disabled this frame, it's stopped at the start of the next one
+constexpr uchar ENTITY_STOP_PENDING = 0x04;
+
+// State of the entities of one archetype, one entry per entity in every array.
+// It's the only copy: each entity reads and writes its own entry at its storeIndex.
+struct EntityColumns
+{
+	// nullptr while the entity has no body
+	std::vector<PhysBody *> bodies;
+	// In pixels
+	std::vector<iPoint> positions;
+	// In meters per second, as the body had it on the last update
+	std::vector<b2Vec2> velocities;
+	// Items of the same class and image variation share theirs
+	std::vector<std::shared_ptr<Animation>> animations;
+	// ENTITY_ACTIVE, ENTITY_DORMANT and ENTITY_STOP_PENDING
+	std::vector<uchar> flags;
+};
+
+template<class T>
+struct ArchetypeTable : EntityColumns
+{
+	// They own the entity and keep everything that isn't in the arrays
+	std::vector<std::unique_ptr<T>> facades;
+
+	int Size() const
+	{
+		return static_cast<int>(facades.size());
+	}
+
+	// Active and not dormant: it thinks, moves and is drawn this frame
+	bool IsAwake(int index) const
+	{
+		return (flags[index] & (ENTITY_ACTIVE | ENTITY_DORMANT)) == ENTITY_ACTIVE;
+	}
+};
+
+// Every entity of the game, grouped by archetype in contiguous arrays.
+// The entities still move, draw and collide themselves, but their position,
+// velocity, animation and flags live here. The per-frame systems of
+// EntityManager scan the arrays instead of going through every entity,
+// and call the entities they need with their own type.
+class EntityStore
+{
+public:
+	EntityStore();
+	~EntityStore();
+
+	// They return the index of the entity in its table, also set as its storeIndex
+	int AddPlayer(std::unique_ptr<Player> player);
+	int AddEnemy(std::unique_ptr<Enemy> enemy);
+	// Items of the same class share their animations
+	int AddItem(std::unique_ptr<Item> item, std::string_view itemClass);
+	// The last entity of the table takes its place. False if there's no such entity.
+	bool Remove(EntityArchetype archetype, int index);
+	void Clear();
+
+	// Stops the entities disabled last frame
+	void StopDisabled();
+
+	// -1 if no item has that class
+	int FindItemClass(std::string_view itemClass) const;
+	// Animations of the class by image variation
+	std::unordered_map<int, std::shared_ptr<Animation>> &GetItemClassAnimations(int itemClass);
+	// Every item animation is advanced once per frame
+	void AddItemAnimation(std::shared_ptr<Animation> animation);
+
+	ArchetypeTable<Player> players;
+	ArchetypeTable<Enemy> enemies;
+	std::vector<EnemyAI> enemyAI;
+	ArchetypeTable<Item> items;
+	std::vector<int> itemClasses;
+
+	// Shared by the items of every class, with no repeats
+	std::vector<std::shared_ptr<Animation>> itemAnimations;
+
+private:
+	std::vector<std::string> itemClassNames;
+	std::vector<std::unordered_map<int, std::shared_ptr<Animation>>> itemClassAnimations;
+};
+
+#endif // __ENTITYSTORE_H__
@@ -0,0 +1,201 @@
+#include "FrameBudget.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <array>
+#include <ranges>
+#include <utility>
+
+#include "SDL/include/SDL_timer.h"
+
+FrameBudget::FrameBudget() :
+	frequency(static_cast<float>(SDL_GetPerformanceFrequency()) / 1000.0f)
+{}
+
+void FrameBudget::Load(pugi::xml_node const &node)
+{
+	constexpr std::array<std::pair<std::string_view, BudgetStep>, 4> stepNames = {{
+		{"overlays", BudgetStep::OVERLAYS},
+		{"tileanimations", BudgetStep::TILE_ANIMATIONS},
+		{"ai", BudgetStep::AI_TICKS},
+		{"physics", BudgetStep::PHYSICS_ITERATIONS}
+	}};
+
+	bEnabled = node.attribute("enabled").as_bool(false);
+	degradeAt = node.attribute("degrade").as_float(degradeAt);
+	restoreAt = std::min(node.attribute("restore").as_float(restoreAt), degradeAt);
+	windowFrames = std::max(1, node.attribute("frames").as_int(windowFrames));
+
+	steps.clear();
+	degraded.clear();
+	for(auto const &stepNode : node.children("step"))
+	{
+		std::string_view name = stepNode.attribute("name").as_string();
+		auto it = std::ranges::find(stepNames, name, &std::pair<std::string_view, BudgetStep>::first);
+		if(it == stepNames.end())
+		{
+			LOG("Unknown frame budget step %.*s", static_cast<int>(name.size()), name.data());
+			continue;
+		}
+
+		using enum BudgetStep;
+		switch(it->second)
+		{
+			case AI_TICKS:
+				aiDistance = std::max(0, stepNode.attribute("distance").as_int(aiDistance));
+				aiInterval = std::max(1, stepNode.attribute("interval").as_int(aiInterval));
+				break;
+			case PHYSICS_ITERATIONS:
+				velocityIterations = std::max(1, stepNode.attribute("velocity").as_int(velocityIterations));
+				positionIterations = std::max(1, stepNode.attribute("position").as_int(positionIterations));
+				break;
+			default:
+				break;
+		}
+
+		Step &step = steps.emplace_back(Step{.step = it->second, .name = std::string(name)});
+		std::string_view modules = stepNode.attribute("module").as_string();
+		for(auto const &module : std::views::split(modules, ','))
+		{
+			if(!module.empty())
+				step.modules.emplace_back(module.begin(), module.end());
+		}
+	}
+
+	if(bEnabled) LOG("Frame budget with %d steps", static_cast<int>(steps.size()));
+}
+
+void FrameBudget::BeginFrame()
+{
+	for(auto &cost : costs)
+		cost.frame = 0.0f;
+}
+
+void FrameBudget::AddCost(std::string_view module, uint64 startCounter)
+{
+	if(!bEnabled) return;
+	GetModuleCost(module).frame += static_cast<float>(SDL_GetPerformanceCounter() - startCounter) / frequency;
+}
+
+void FrameBudget::AddIdleTime(std::string_view module, float ms)
+{
+	if(!bEnabled) return;
+	GetModuleCost(module).frame -= ms;
+}
+
+void FrameBudget::EndFrame(float frameTime)
+{
+	frame++;
+	if(!bEnabled || bLocked) return;
+
+	for(auto &cost : costs)
+		cost.window += std::max(cost.frame, 0.0f);
+
+	if(++frameCount < windowFrames) return;
+
+	float work = 0.0f;
+	for(auto const &cost : costs)
+		work += cost.window;
+	averageWork = work / static_cast<float>(frameCount);
+
+	if(averageWork > frameTime * degradeAt) Degrade(averageWork, frameTime);
+	else if(averageWork < frameTime * restoreAt) Restore(averageWork, frameTime);
+
+	// Each decision looks at frames that came after the last one
+	frameCount = 0;
+	for(auto &cost : costs)
+		cost.window = 0.0f;
+}
+
+void FrameBudget::SetLocked(bool locked)
+{
+	if(locked && !bLocked)
+	{
+		for(auto &step : steps)
+			step.bActive = false;
+		degraded.clear();
+	}
+	bLocked = locked;
+}
+
+bool FrameBudget::IsDegraded(BudgetStep step) const
+{
+	return std::ranges::any_of(steps, [step](Step const &s) { return s.bActive && s.step == step; });
+}
+
+bool FrameBudget::IsAITick(int tileDistance, uint slot) const
+{
+	if(tileDistance <= aiDistance || !IsDegraded(BudgetStep::AI_TICKS)) return true;
+	return (frame + slot) % static_cast<uint>(aiInterval) == 0;
+}
+
+int FrameBudget::GetVelocityIterations() const
+{
+	return velocityIterations;
+}
+
+int FrameBudget::GetPositionIterations() const
+{
+	return positionIterations;
+}
+
+float FrameBudget::GetAverageWork() const
+{
+	return averageWork;
+}
+
+FrameBudget::ModuleCost &FrameBudget::GetModuleCost(std::string_view module)
+{
+	// A dozen modules at most, a linear search is enough
+	auto it = std::ranges::find(costs, module, &ModuleCost::module);
+	if(it != costs.end()) return *it;
+
+	costs.push_back({.module = std::string(module)});
+	return costs.back();
+}
+
+float FrameBudget::GetWindowCost(std::string_view module) const
+{
+	auto it = std::ranges::find(costs, module, &ModuleCost::module);
+	return (it != costs.end()) ? it->window : 0.0f;
+}
+
+float FrameBudget::GetWindowCost(Step const &step) const
+{
+	float cost = 0.0f;
+	for(auto const &module : step.modules)
+		cost += GetWindowCost(module);
+	return cost;
+}
+
+void FrameBudget::Degrade(float average, float frameTime)
+{
+	// The step of the module that took the longest, the first one in the config on a tie
+	int chosen = -1;
+	float chosenCost = -1.0f;
+	for(int i = 0; i < static_cast<int>(steps.size()); i++)
+	{
+		if(steps[i].bActive) continue;
+		if(float cost = GetWindowCost(steps[i]); cost > chosenCost)
+		{
+			chosen = i;
+			chosenCost = cost;
+		}
+	}
+	if(chosen < 0) return;
+
+	steps[chosen].bActive = true;
+	degraded.push_back(chosen);
+	LOG("Frame budget: %.2f of %.2f ms, turning on %s", average, frameTime, steps[chosen].name.c_str());
+}
+
+void FrameBudget::Restore(float average, float frameTime)
+{
+	if(degraded.empty()) return;
+
+	Step &step = steps[degraded.back()];
+	step.bActive = false;
+	degraded.pop_back();
+	LOG("Frame budget: %.2f of %.2f ms, turning off %s", average, frameTime, step.name.c_str());
+}
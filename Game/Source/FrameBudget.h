@@ -0,0 +1,107 @@
+#ifndef __FRAMEBUDGET_H__
+#define __FRAMEBUDGET_H__
+
+#include "Defs.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "PugiXml/src/pugixml.hpp"
+
+// Ways to make a frame cheaper, each one lowers the cost of a single module
+enum class BudgetStep
+{
+	// Debug shapes and the physics profile aren't drawn
+	OVERLAYS,
+	// Animated tiles outside the camera stop advancing
+	TILE_ANIMATIONS,
+	// Enemies far from the player only think every few frames
+	AI_TICKS,
+	// Box2D steps with fewer solver iterations
+	PHYSICS_ITERATIONS
+};
+
+// Measures how long every module takes each frame and, when frames keep going
+// over the time the FPS cap gives them, turns on one BudgetStep at a time, the
+// one whose modules cost the most. Steps are turned off again, the last one
+// first, once there's enough spare time. The policy comes from <app><budget>.
+class FrameBudget
+{
+public:
+	FrameBudget();
+
+	void Load(pugi::xml_node const &node);
+
+	void BeginFrame();
+	// Adds the time since startCounter, a SDL_GetPerformanceCounter value, to the module
+	void AddCost(std::string_view module, uint64 startCounter);
+	// Time the module spent waiting instead of working, in milliseconds
+	void AddIdleTime(std::string_view module, float ms);
+	// frameTime is the time each frame has, in milliseconds
+	void EndFrame(float frameTime);
+	// Turns every step off, and keeps them off while locked.
+	// Replays lock it, so they run the same way they were recorded.
+	void SetLocked(bool locked);
+
+	bool IsDegraded(BudgetStep step) const;
+	// False on the frames an enemy that far from the player, in tiles, skips its AI.
+	// slot spreads the enemies over the frames.
+	bool IsAITick(int tileDistance, uint slot) const;
+	int GetVelocityIterations() const;
+	int GetPositionIterations() const;
+
+	// Average time the modules worked over the last window, in milliseconds
+	float GetAverageWork() const;
+
+private:
+	struct Step
+	{
+		BudgetStep step = BudgetStep::OVERLAYS;
+		std::string name;
+		// Modules the step makes cheaper, a comma separated list in the config
+		std::vector<std::string> modules;
+		bool bActive = false;
+	};
+
+	struct ModuleCost
+	{
+		std::string module;
+		float frame = 0.0f;
+		float window = 0.0f;
+	};
+
+	ModuleCost &GetModuleCost(std::string_view module);
+	float GetWindowCost(std::string_view module) const;
+	float GetWindowCost(Step const &step) const;
+	void Degrade(float average, float frameTime);
+	void Restore(float average, float frameTime);
+
+	bool bEnabled = false;
+	bool bLocked = false;
+	// Over degradeAt of the frame time it degrades, under restoreAt it restores
+	float degradeAt = 0.9f;
+	float restoreAt = 0.6f;
+	// Frames averaged before each decision
+	int windowFrames = 30;
+
+	// In config order
+	std::vector<Step> steps;
+	// Indices of the active steps, in the order they were turned on
+	std::vector<int> degraded;
+
+	// AI_TICKS
+	int aiDistance = 16;
+	int aiInterval = 4;
+	// PHYSICS_ITERATIONS
+	int velocityIterations = 3;
+	int positionIterations = 1;
+
+	std::vector<ModuleCost> costs;
+	float frequency = 1.0f;
+	int frameCount = 0;
+	uint frame = 0;
+	float averageWork = 0.0f;
+};
+
+#endif // __FRAMEBUDGET_H__
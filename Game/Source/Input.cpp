@@ -1,14 +1,40 @@
 #include "App.h"
 #include "Input.h"
 #include "Window.h"
+#include "Render.h"
+#include "EntityManager.h"
 
 #include "Point.h"
 #include "Defs.h"
 #include "Log.h"
 
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
 #include "SDL/include/SDL.h"
 
+namespace
+{
+	constexpr std::array<char, 4> REPLAY_MAGIC = {'R', 'P', 'L', 'Y'};
+	constexpr uint32 REPLAY_VERSION = 1;
 
+	template<typename T>
+	void WriteValue(std::ofstream &file, T const &value)
+	{
+		file.write(reinterpret_cast<char const *>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValue(std::vector<char> const &data, size_t &cursor, T &value)
+	{
+		if(cursor + sizeof(T) > data.size()) return false;
+		std::memcpy(&value, data.data() + cursor, sizeof(T));
+		cursor += sizeof(T);
+		return true;
+	}
+}
 
 Input::Input() : Module()
 {
@@ -32,6 +58,27 @@ bool Input::Awake(pugi::xml_node& config)
 		return false;
 	}
 
+	// -record <file> and -replay <file> override the config, -headless replays without rendering
+	pugi::xml_node replayNode = config.child("replay");
+	std::string replayMode = replayNode.attribute("mode").as_string("live");
+	std::string replayPath = replayNode.attribute("file").as_string("replay.rpl");
+	checksumPath = replayNode.attribute("checksums").as_string(checksumPath.c_str());
+	bReplayRender = replayNode.attribute("render").as_bool(true);
+
+	for(int i = 1; i < app->GetArgc(); i++)
+	{
+		std::string_view arg = app->GetArgv(i);
+		if((arg == "-record" || arg == "-replay") && i + 1 < app->GetArgc())
+		{
+			replayMode = arg.substr(1);
+			replayPath = app->GetArgv(++i);
+		}
+		else if(arg == "-headless") bReplayRender = false;
+	}
+
+	if(StrEquals(replayMode, "record")) return StartRecording(replayPath);
+	if(StrEquals(replayMode, "replay")) return StartReplay(replayPath);
+
 	return true;
 }
 
@@ -39,6 +86,7 @@ bool Input::Awake(pugi::xml_node& config)
 bool Input::Start()
 {
 	SDL_StopTextInput();
+	if(mode == InputMode::REPLAY && !bReplayRender) app->render->SetHeadless(true);
 	return true;
 }
 
@@ -52,6 +100,23 @@ bool Input::PreUpdate()
 	using enum EventWindow;
 	using enum KeyState;
 
+	// The checksum of the frame is taken before its input changes anything
+	uint64 checksum = (mode != InputMode::LIVE) ? app->entityManager->GetStateChecksum() : 0;
+	if(mode == InputMode::REPLAY)
+	{
+		if(ReadReplayFrame(replayFrame)) CheckReplayFrame(replayFrame, checksum);
+		else if(!GetWindowEvent(WE_QUIT)) EndReplay();
+		keys = replayFrame.keys.data();
+	}
+
+	// Recorded keys are the ones keyboard is built from, SDL_PollEvent below updates the state for the next frame
+	InputFrame recordFrame;
+	if(mode == InputMode::RECORD)
+	{
+		std::copy_n(keys, MAX_KEYS, recordFrame.keys.begin());
+		keys = recordFrame.keys.data();
+	}
+
 	for(int i = 0; i < MAX_KEYS; ++i)
 	{
 		if(keys[i] == 1)
@@ -108,18 +173,22 @@ bool Input::PreUpdate()
 				}
 			break;
 
+			// Replays take the mouse from the file
 			case SDL_MOUSEBUTTONDOWN:
+				if(mode == InputMode::REPLAY) break;
 				mouseButtons[event.button.button - 1] = KeyState::KEY_DOWN;
 				//LOG("Mouse button %d down", event.button.button-1);
 			break;
 			
 			case SDL_MOUSEBUTTONUP:
+				if(mode == InputMode::REPLAY) break;
 				mouseButtons[event.button.button - 1] = KeyState::KEY_UP;
 				//LOG("Mouse button %d up", event.button.button-1);
 			break;
 
 			case SDL_MOUSEMOTION:
 			{
+				if(mode == InputMode::REPLAY) break;
 				int scale = app->win->GetScale();
 				mouseMotion.x = event.motion.xrel / scale;
 				mouseMotion.y = event.motion.yrel / scale;
@@ -133,6 +202,21 @@ bool Input::PreUpdate()
 		}
 	}
 
+	if(mode == InputMode::REPLAY)
+	{
+		mouseButtons = replayFrame.mouseButtons;
+		mousePosition = replayFrame.mousePosition;
+		mouseMotion = replayFrame.mouseMotion;
+	}
+	else if(mode == InputMode::RECORD)
+	{
+		recordFrame.checksum = checksum;
+		recordFrame.mouseButtons = mouseButtons;
+		recordFrame.mousePosition = mousePosition;
+		recordFrame.mouseMotion = mouseMotion;
+		WriteReplayFrame(recordFrame);
+	}
+
 	return true;
 }
 
@@ -146,6 +230,11 @@ bool Input::Pause(int phase)
 bool Input::CleanUp()
 {
 	LOG("Quitting SDL event subsystem");
+	if(mode == InputMode::RECORD)
+		LOG("Recorded %u frames", replayFrameCount);
+	else if(mode == InputMode::REPLAY && replayCursor < replayData.size())
+		LOG("Replay stopped at frame %u with %u checksum mismatches", replayFrameCount, replayMismatches);
+
 	SDL_QuitSubSystem(SDL_INIT_EVENTS);
 	return true;
 }
@@ -171,4 +260,144 @@ void Input::GetMouseMotion(int& x, int& y) const
 {
 	x = mouseMotion.x;
 	y = mouseMotion.y;
-}
\ No newline at end of file
+}
+
+InputMode Input::GetMode() const
+{
+	return mode;
+}
+
+bool Input::IsFixedTimestep() const
+{
+	return mode != InputMode::LIVE;
+}
+
+bool Input::StartRecording(std::string const &path)
+{
+	recordFile.open(path, std::ios::binary);
+	if(!recordFile)
+	{
+		LOG("Could not open %s to record input", path.c_str());
+		return false;
+	}
+
+	auto seed = static_cast<uint32>(SDL_GetPerformanceCounter());
+	std::srand(seed);
+
+	recordFile.write(REPLAY_MAGIC.data(), REPLAY_MAGIC.size());
+	WriteValue(recordFile, REPLAY_VERSION);
+	WriteValue(recordFile, seed);
+
+	mode = InputMode::RECORD;
+	LOG("Recording input to %s", path.c_str());
+	return true;
+}
+
+bool Input::StartReplay(std::string const &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if(!file)
+	{
+		LOG("Could not open replay %s", path.c_str());
+		return false;
+	}
+	replayData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	std::array<char, 4> magic{};
+	uint32 version = 0;
+	uint32 seed = 0;
+	if(!ReadValue(replayData, replayCursor, magic) || magic != REPLAY_MAGIC ||
+	   !ReadValue(replayData, replayCursor, version) || version != REPLAY_VERSION ||
+	   !ReadValue(replayData, replayCursor, seed))
+	{
+		LOG("%s is not a replay this version can read", path.c_str());
+		return false;
+	}
+
+	std::srand(seed);
+
+	if(checksumFile.open(checksumPath); checksumFile)
+		checksumFile << "frame,recorded,replayed\n";
+	else
+		LOG("Could not open %s, replay checksums won't be saved", checksumPath.c_str());
+
+	mode = InputMode::REPLAY;
+	LOG("Replaying input from %s", path.c_str());
+	return true;
+}
+
+void Input::WriteReplayFrame(InputFrame const &frame)
+{
+	uint16_t buttons = 0;
+	for(int i = 0; i < NUM_MOUSE_BUTTONS; i++)
+		buttons |= static_cast<uint16_t>(frame.mouseButtons[i]) << (2 * i);
+
+	WriteValue(recordFile, frame.checksum);
+	WriteValue(recordFile, buttons);
+	WriteValue(recordFile, static_cast<int16_t>(frame.mousePosition.x));
+	WriteValue(recordFile, static_cast<int16_t>(frame.mousePosition.y));
+	WriteValue(recordFile, static_cast<int16_t>(frame.mouseMotion.x));
+	WriteValue(recordFile, static_cast<int16_t>(frame.mouseMotion.y));
+
+	// Most frames only change a key or two, if any
+	std::array<uint16_t, MAX_KEYS> changed{};
+	uint16_t changedCount = 0;
+	for(int i = 0; i < MAX_KEYS; i++)
+	{
+		if(frame.keys[i] != replayFrame.keys[i]) changed[changedCount++] = static_cast<uint16_t>(i);
+	}
+	WriteValue(recordFile, changedCount);
+	recordFile.write(reinterpret_cast<char const *>(changed.data()), changedCount * sizeof(uint16_t));
+
+	replayFrame.keys = frame.keys;
+	replayFrameCount++;
+}
+
+bool Input::ReadReplayFrame(InputFrame &frame)
+{
+	uint16_t buttons = 0;
+	std::array<int16_t, 4> mouse{};
+	uint16_t changedCount = 0;
+	if(!ReadValue(replayData, replayCursor, frame.checksum) ||
+	   !ReadValue(replayData, replayCursor, buttons) ||
+	   !ReadValue(replayData, replayCursor, mouse) ||
+	   !ReadValue(replayData, replayCursor, changedCount))
+	{
+		return false;
+	}
+
+	for(int i = 0; i < NUM_MOUSE_BUTTONS; i++)
+		frame.mouseButtons[i] = static_cast<KeyState>((buttons >> (2 * i)) & 3);
+	frame.mousePosition = {mouse[0], mouse[1]};
+	frame.mouseMotion = {mouse[2], mouse[3]};
+
+	for(uint16_t i = 0; i < changedCount; i++)
+	{
+		uint16_t key = 0;
+		if(!ReadValue(replayData, replayCursor, key) || key >= MAX_KEYS) return false;
+		frame.keys[key] ^= 1;
+	}
+
+	replayFrameCount++;
+	return true;
+}
+
+void Input::CheckReplayFrame(InputFrame const &frame, uint64 checksum)
+{
+	if(checksumFile)
+		checksumFile << std::format("{},{:016x},{:016x}\n", replayFrameCount, frame.checksum, checksum);
+
+	if(frame.checksum == checksum) return;
+
+	if(replayMismatches == 0)
+		LOG("Replay diverged at frame %u", replayFrameCount);
+	replayMismatches++;
+}
+
+void Input::EndReplay()
+{
+	LOG("Replay finished: %u frames, %u checksum mismatches", replayFrameCount, replayMismatches);
+	checksumFile.close();
+	replayCursor = replayData.size();
+	windowEvents[static_cast<uint>(EventWindow::WE_QUIT)] = true;
+}
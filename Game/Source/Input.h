@@ -5,6 +5,9 @@
 #include "Point.h"
 
 #include <array>
+#include <fstream>
+#include <string>
+#include <vector>
 
 //#define NUM_KEYS 352
 constexpr auto NUM_MOUSE_BUTTONS = 5;
@@ -30,6 +33,25 @@ enum class KeyState : uint
 	KEY_UP
 };
 
+enum class InputMode : uint
+{
+	LIVE = 0,
+	RECORD,
+	REPLAY
+};
+
+// Everything the game reads from Input in a frame
+struct InputFrame
+{
+	// Checksum of the state the previous frame left
+	uint64 checksum = 0;
+	// Raw SDL keyboard state, 1 if the key is pressed
+	std::array<uchar, MAX_KEYS> keys{};
+	std::array<KeyState, NUM_MOUSE_BUTTONS> mouseButtons{};
+	iPoint mousePosition;
+	iPoint mouseMotion;
+};
+
 class Input : public Module
 {
 
@@ -74,12 +96,44 @@ public:
 	void GetMousePosition(int &x, int &y) const;
 	void GetMouseMotion(int& x, int& y) const;
 
+	// ------ Replay
+	InputMode GetMode() const;
+	// Recordings and replays advance the game by a fixed timestep every frame,
+	// so the world steps the same way in both
+	bool IsFixedTimestep() const;
+
 private:
+	// --- Replay file
+	// Header: "RPLY", version, std::rand seed.
+	// Each frame: checksum, mouse buttons (2 bits each), mouse position and motion,
+	// and the scancodes that changed since the previous frame.
+	bool StartRecording(std::string const &path);
+	bool StartReplay(std::string const &path);
+	void WriteReplayFrame(InputFrame const &frame);
+	// Returns false when the replay has no more frames
+	bool ReadReplayFrame(InputFrame &frame);
+	// Compares the recorded checksum of the frame with the one of this run
+	void CheckReplayFrame(InputFrame const &frame, uint64 checksum);
+	void EndReplay();
+
 	std::array<bool, NUM_EVENT_WINDOW> windowEvents{};
 	std::array<KeyState, MAX_KEYS> keyboard{};
 	std::array<KeyState, NUM_MOUSE_BUTTONS> mouseButtons{};
 	iPoint mouseMotion;
 	iPoint mousePosition;
+
+	InputMode mode = InputMode::LIVE;
+	// Only used while replaying, false to skip presenting frames
+	bool bReplayRender = true;
+	std::string checksumPath = "replay_checksums.csv";
+	InputFrame replayFrame;
+	uint replayFrameCount = 0;
+	uint replayMismatches = 0;
+	std::ofstream recordFile;
+	std::ofstream checksumFile;
+	// Whole replay file, read frame by frame
+	std::vector<char> replayData;
+	size_t replayCursor = 0;
 	
 	friend class UI;
 };
@@ -27,10 +27,7 @@ Item::Item(TileInfo const *tileInfo, iPoint pos, int width, int height) : info(t
 	else LOG("Item does not have a class.");
 	
 	if(!tileInfo->collider.empty())
-	{
-		shape.Create("chain", tileInfo->collider[0].points);
 		colliderOffset = iPoint(tileInfo->collider[0].x, tileInfo->collider[0].y);
-	}
 	
 	imageVariation = *(std::get_if<int>(&tileInfo->properties.find("ImageVariation")->second));
 	
@@ -48,13 +45,22 @@ Item::Item(TileInfo const *tileInfo, iPoint pos, int width, int height) : info(t
 
 void Item::CreatePhysBody()
 {
-	// Create PhysBody
-	iPoint pBodyPos = position;
+	if(!bodyArchetype) return;
 
-	auto itemBody = app->physics->CreateBody(
-		position + colliderOffset
-	);
+	SetBody(app->physics->CreatePhysBody(*bodyArchetype, GetPosition()));
+	pBody->listener = this;
+}
 
+std::shared_ptr<BodyArchetype const> Item::CompileBodyArchetype() const
+{
+	auto archetype = std::make_shared<BodyArchetype>();
+	archetype->type = CL::ColliderLayers::ITEMS;
+	archetype->colliderOffset = colliderOffset;
+	archetype->size = iPoint(width, height);
+
+	if(info->collider.empty()) return archetype;
+
+	ShapeData shape("chain", info->collider[0].points);
 	auto fixtureDef = app->physics->CreateFixtureDef(
 		shape,
 		(uint16)CL::ColliderLayers::ITEMS,
@@ -62,16 +68,11 @@ void Item::CreatePhysBody()
 		true
 	);
 
-	itemBody->CreateFixture(fixtureDef.get());
+	FixtureArchetype &fixture = archetype->fixtures.emplace_back();
+	fixture.def = *fixtureDef;
+	fixture.shape = std::move(shape.shape);
 
-	auto physBodyPtr = app->physics->CreatePhysBody(
-		itemBody,
-		iPoint(width, height),
-		CL::ColliderLayers::ITEMS
-	);
-
-	pBody = std::move(physBodyPtr);
-	pBody->listener = this;
+	return archetype;
 }
 
 Item::~Item() = default;
@@ -86,14 +87,14 @@ bool Item::Start()
 bool Item::Update()
 {  
 	
-	if(auto tex = anim->GetCurrentTexture().get(); tex) app->render->DrawTexture(tex, position.x, position.y);
+	if(auto tex = GetAnimation()->GetCurrentTexture().get(); tex) app->render->DrawTexture(tex, GetPosition().x, GetPosition().y);
 	return true;
 }
 
 bool Item::Pause() const
 {
 	
-	if(auto tex = anim->GetCurrentTexture().get(); tex) app->render->DrawTexture(tex, position.x, position.y);
+	if(auto tex = GetAnimation()->GetCurrentTexture().get(); tex) app->render->DrawTexture(tex, GetPosition().x, GetPosition().y);
 	return true;
 }
 
@@ -128,8 +129,8 @@ pugi::xml_node Item::SaveState(pugi::xml_node const &data)
 	std::string saveFloatData = "<{} {}=\"{:.2f}\" {}=\"{:.2f}\"/>\n";
 	std::string dataToSave = "<item>\n";
 	dataToSave += AddSaveData(saveData4, "item", "imgvariation", imageVariation, "class", itemClass);
-	dataToSave += AddSaveData(saveData4, "position", "x", position.x, "y", position.y);
-	dataToSave += AddSaveData(saveData4, "entity", "active", active, "disablenextupdate", disableOnNextUpdate);
+	dataToSave += AddSaveData(saveData4, "position", "x", GetPosition().x, "y", GetPosition().y);
+	dataToSave += AddSaveData(saveData4, "entity", "active", IsActive(), "disablenextupdate", IsStopPending());
 	dataToSave += "</item>";
 
 	app->AppendFragment(data, dataToSave.c_str());
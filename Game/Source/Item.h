@@ -15,8 +15,10 @@ public:
 
 	bool Start() override;
 	void CreatePhysBody() final;
+	// Sensor with the first collider of the tile
+	std::shared_ptr<BodyArchetype const> CompileBodyArchetype() const;
 
-	bool Update() override;
+	bool Update() final;
 	bool Pause() const override;
 
 	void BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fixtureB, PhysBody const *pBodyA, PhysBody const *pBodyB) final;
@@ -28,10 +30,8 @@ public:
 	pugi::xml_node SaveState(pugi::xml_node const &data) final;
 
 	TileInfo const *info = nullptr;
-	ShapeData shape;
 	int width = 0;
 	int height = 0;
-	std::shared_ptr<Animation> anim;
 	std::string itemClass = "Unknown";
 };
 
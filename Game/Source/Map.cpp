@@ -2,6 +2,8 @@
 #include "App.h"
 #include "Render.h"
 #include "EntityManager.h"
+#include "Window.h"
+#include "FrameBudget.h"
 
 #include "Log.h"
 #include "BitMaskColliderLayers.h"
@@ -12,6 +14,13 @@
 #include <utility>
 #include <regex>
 #include <variant>
+#include <bit>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
 
 #include "SDL_image/include/SDL_image.h"
 
@@ -39,15 +48,36 @@ void Map::Draw() const
 	if(!mapLoaded)
 		return;
 	
+	// Over budget, only the animated tiles the camera sees keep moving
+	bool bOnlyInView = app->budget->IsDegraded(BudgetStep::TILE_ANIMATIONS);
+	SDL_Rect camera = app->render->GetCamera();
+	int scale = std::max(static_cast<int>(app->win->GetScale()), 1);
+	iPoint firstInView = WorldToCoordinates({-camera.x / scale, -camera.y / scale});
+	iPoint lastInView = WorldToCoordinates({(camera.w - camera.x) / scale, (camera.h - camera.y) / scale});
+
 	for(auto const &layer : mapData.mapLayers)
 	{
 		DrawLayer(layer.get());
 
 		// Advance Tile animations of Layer
-		for(auto &elem : layer->tileData)
+		if(!bOnlyInView)
+		{
+			for(auto &elem : layer->tileData)
+			{
+				if(!elem.active) continue;
+				elem.AdvanceTimer();
+			}
+			continue;
+		}
+
+		for(int y = std::max(firstInView.y, 0); y <= std::min(lastInView.y, layer->height - 1); y++)
 		{
-			if(!elem.active) continue;
-			elem.AdvanceTimer();
+			for(int x = std::max(firstInView.x, 0); x <= std::min(lastInView.x, layer->width - 1); x++)
+			{
+				auto &elem = layer->tileData[y * layer->width + x];
+				if(!elem.active) continue;
+				elem.AdvanceTimer();
+			}
 		}
 	}
 }
@@ -120,7 +150,6 @@ int Map::WorldYToCoordinates(int n) const
 	return n / mapData.tileHeight;
 }
 
-
 // Get relative Tile rectangle
 SDL_Rect TileSet::GetTileRect(int gid) const
 {
@@ -135,7 +164,6 @@ SDL_Rect TileSet::GetTileRect(int gid) const
 	return rect;
 }
 
-
 // Pick the right Tileset based on a tile id
 TileSet *Map::GetTilesetFromTileId(int gid) const
 {
@@ -184,6 +212,9 @@ bool Map::Load()
 		return false;
 	}
 
+	CreateCollisionGrid();
+	app->physics->SetCollisionGrid(&collisionGrid);
+
 	LogLoadedData();
 
 	app->entityManager->LoadAllTextures();
@@ -603,84 +634,276 @@ int Map::GetTileSetSize() const
 	return mapData.tilesets.size();
 }
 
-std::unique_ptr<navPointMatrix> Map::CreateWalkabilityMap()
+std::unique_ptr<NavGrid> Map::CreateWalkabilityMap()
 {
 	return CreateWalkabilityNodes();
 }
 
+std::unique_ptr<NavGrid> Map::CreateWalkabilityNodes() const
+{
+	uint maxGid = 0;
+	for(auto const &tileset : mapData.tilesets)
+		maxGid = std::max(maxGid, static_cast<uint>(tileset->firstgid + tileset->tilecount));
+
+	// Tileset lookups are slow, so we only do them once per gid
+	constexpr uchar UNKNOWN_FLAGS = 0xFF;
+	std::vector<uchar> gidFlags(maxGid + 1, UNKNOWN_FLAGS);
+	gidFlags[0] = 0;
+	auto getFlags = [this, &gidFlags](uint gid)
+	{
+		if(gid >= gidFlags.size()) return TILE_PRESENT;
+		uchar &flags = gidFlags[gid];
+		if(flags == UNKNOWN_FLAGS)
+		{
+			flags = TILE_PRESENT;
+			if(IsWalkable(gid)) flags |= TILE_WALKABLE;
+			if(IsTerrain(gid)) flags |= TILE_TERRAIN;
+		}
+		return flags;
+	};
+
+	// Same for the terrain costs. Empty gids haven't been looked up yet.
+	std::vector<std::array<uchar, TERRAIN_COST_LAYERS>> gidCosts(maxGid + 1);
+	std::vector<bool> gidCostsKnown(maxGid + 1, false);
+	gidCostsKnown[0] = true;
+	bool bAnyCost = false;
+	auto getCosts = [this, &gidCosts, &gidCostsKnown, &bAnyCost](uint gid)
+	{
+		if(gid >= gidCosts.size()) return std::array<uchar, TERRAIN_COST_LAYERS>{};
+		if(!gidCostsKnown[gid])
+		{
+			gidCosts[gid] = GetTerrainCosts(gid);
+			gidCostsKnown[gid] = true;
+			bAnyCost |= std::ranges::any_of(gidCosts[gid], [](uchar cost) { return cost != 0; });
+		}
+		return gidCosts[gid];
+	};
+
+	std::vector<WalkabilityLayer> layers;
+	for(auto const &layer : mapData.mapLayers)
+	{
+		WalkabilityLayer &walkLayer = layers.emplace_back();
+		walkLayer.width = layer->width;
+		walkLayer.height = layer->height;
+		walkLayer.flags.reserve(layer->tileData.size());
+		walkLayer.costs.reserve(layer->tileData.size() * TERRAIN_COST_LAYERS);
+		for(auto const &tile : layer->tileData)
+		{
+			walkLayer.flags.push_back(getFlags(tile.gid));
+			auto costs = getCosts(tile.gid);
+			walkLayer.costs.insert(walkLayer.costs.end(), costs.begin(), costs.end());
+		}
+	}
+
+	// Maps without costs don't need to keep them
+	if(!bAnyCost)
+	{
+		for(auto &walkLayer : layers)
+			walkLayer.costs.clear();
+	}
+
+	return ClassifyWalkability(mapData.width, mapData.height, layers);
+}
 
-std::unique_ptr<navPointMatrix> Map::CreateWalkabilityNodes() const
+// ---------- Walkability bitsets ---------
+namespace
 {
-	auto groundWalkabilityMap = std::make_unique<navPointMatrix>();
-	for(int i = 0; i < mapData.width; i++)
+	// Moves the flag bit we want to bit 7 of each byte, where movemask reads it
+	constexpr int PRESENT_SHIFT = 7;
+	constexpr int WALKABLE_SHIFT = 6;
+	constexpr int TERRAIN_SHIFT = 5;
+
+	// Bit x of the result is bit x + 1 of the row
+	inline uint64 NextTile(uint64 const *row, int word, int rowWords)
 	{
-		std::vector<NavPoint> aux;
-		for(int j = 0; j < mapData.height; j++)
-			aux.emplace_back();
-		groundWalkabilityMap->emplace_back(aux);
+		uint64 next = (word + 1 < rowWords) ? (row[word + 1] << 63) : 0;
+		return (row[word] >> 1) | next;
 	}
 
-	for(auto const &layer : mapData.mapLayers)
+	// Writes type on every tile of a row word whose bit is set in mask
+	inline void WriteTypes(uint64 mask, CL::NavType type, CL::NavType *row)
+	{
+		while(mask)
+		{
+			row[std::countr_zero(mask)] = type;
+			mask &= mask - 1;
+		}
+	}
+}
+
+WalkabilityBits Map::PackWalkabilityLayer(WalkabilityLayer const &layer)
+{
+	WalkabilityBits bits;
+	bits.width = layer.width;
+	bits.height = layer.height;
+	bits.rowWords = (layer.width + 63) / 64;
+	bits.present.assign(static_cast<size_t>(bits.rowWords) * layer.height, 0);
+	bits.walkable.assign(bits.present.size(), 0);
+	bits.solid.assign(bits.present.size(), 0);
+
+	for(int y = 0; y < layer.height; y++)
 	{
-		for(int y = 0; y < layer->height - 1; y++)
+		uchar const *flags = layer.flags.data() + static_cast<size_t>(y) * layer.width;
+		uint64 *present = bits.GetRow(bits.present, y);
+		uint64 *walkable = bits.GetRow(bits.walkable, y);
+		uint64 *solid = bits.GetRow(bits.solid, y);
+
+		int x = 0;
+#if defined(__AVX2__)
+		// 32 tiles per iteration. x is a multiple of 32, so a block never crosses a word.
+		for(; x + 32 <= layer.width; x += 32)
+		{
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(flags + x));
+			__m256i walkableBits = _mm256_slli_epi16(block, WALKABLE_SHIFT);
+			__m256i terrainBits = _mm256_slli_epi16(block, TERRAIN_SHIFT);
+
+			int shift = x % 64;
+			present[x / 64] |= static_cast<uint64>(static_cast<uint32>(_mm256_movemask_epi8(_mm256_slli_epi16(block, PRESENT_SHIFT)))) << shift;
+			walkable[x / 64] |= static_cast<uint64>(static_cast<uint32>(_mm256_movemask_epi8(walkableBits))) << shift;
+			solid[x / 64] |= static_cast<uint64>(static_cast<uint32>(_mm256_movemask_epi8(_mm256_or_si256(walkableBits, terrainBits)))) << shift;
+		}
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		// 16 tiles per iteration. x is a multiple of 16, so a block never crosses a word.
+		for(; x + 16 <= layer.width; x += 16)
 		{
-			bool platformStarted = false;
-			std::vector<NavPoint> row;
-			for(int x = 0; x < layer->width - 1; x++)
+			__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(flags + x));
+			__m128i walkableBits = _mm_slli_epi16(block, WALKABLE_SHIFT);
+			__m128i terrainBits = _mm_slli_epi16(block, TERRAIN_SHIFT);
+
+			int shift = x % 64;
+			present[x / 64] |= static_cast<uint64>(_mm_movemask_epi8(_mm_slli_epi16(block, PRESENT_SHIFT))) << shift;
+			walkable[x / 64] |= static_cast<uint64>(_mm_movemask_epi8(walkableBits)) << shift;
+			solid[x / 64] |= static_cast<uint64>(_mm_movemask_epi8(_mm_or_si128(walkableBits, terrainBits))) << shift;
+		}
+#endif
+		// Scalar fallback and the tiles left at the end of the row
+		for(; x < layer.width; x++)
+		{
+			int shift = x % 64;
+			present[x / 64] |= static_cast<uint64>((flags[x] & TILE_PRESENT) != 0) << shift;
+			walkable[x / 64] |= static_cast<uint64>((flags[x] & TILE_WALKABLE) != 0) << shift;
+			solid[x / 64] |= static_cast<uint64>((flags[x] & (TILE_WALKABLE | TILE_TERRAIN)) != 0) << shift;
+		}
+	}
+
+	return bits;
+}
+
+std::unique_ptr<NavGrid> Map::ClassifyWalkability(int width, int height, std::vector<WalkabilityLayer> const &layers)
+{
+	auto groundWalkabilityMap = std::make_unique<NavGrid>();
+	groundWalkabilityMap->width = width;
+	groundWalkabilityMap->height = height;
+	groundWalkabilityMap->types.assign(width * height, CL::NavType::NONE);
+
+	std::vector<WalkabilityBits> layerBits;
+	layerBits.reserve(layers.size());
+	for(auto const &layer : layers)
+		layerBits.emplace_back(PackWalkabilityLayer(layer));
+
+	int maxWords = 0;
+	for(auto const &layer : layerBits)
+		maxWords = std::max(maxWords, layer.rowWords);
+
+	// Tiles of the current row that already got a type from a previous layer
+	std::vector<uint64> classified(maxWords);
+
+	for(int y = 0; y < height; y++)
+	{
+		CL::NavType *types = groundWalkabilityMap->types.data() + static_cast<size_t>(y) * width;
+		std::ranges::fill(classified, 0);
+
+		for(auto const &layer : layerBits)
+		{
+			// The last row and column of a layer are never classified, as they have nothing below or right
+			int columns = std::min(layer.width, width) - 1;
+			if(y >= std::min(layer.height, height) - 1 || columns <= 0) continue;
+
+			int words = layer.rowWords;
+			uint64 const *solid = layer.GetRow(layer.solid, y);
+			uint64 const *presentBelow = layer.GetRow(layer.present, y + 1);
+			uint64 const *walkableBelow = layer.GetRow(layer.walkable, y + 1);
+			uint64 const *solidBelow = layer.GetRow(layer.solid, y + 1);
+
+			// Carry of the "platform started" latch between words
+			uint64 carry = 0;
+			for(int w = 0; w * 64 < columns; w++)
 			{
 				using enum CL::NavType;
-				// If we already have a NavPoint of another layer we don't want to overwrite it
-				if(groundWalkabilityMap->at(x).at(y).type != NONE) continue;
-
-				// Check if current tile is a free node
-				uint currentTileGid = layer->GetGidValue(x, y);
-				if(IsWalkable(currentTileGid) || IsTerrain(currentTileGid))
-				{
-					groundWalkabilityMap->at(x).at(y).type = TERRAIN;
-					continue;
-				}
+				int validBits = std::min(64, columns - w * 64);
+				uint64 valid = (validBits == 64) ? ~0ULL : ((1ULL << validBits) - 1);
+
+				// If we already have a node of another layer we don't want to overwrite it
+				uint64 free = valid & ~classified[w];
+				uint64 terrain = free & solid[w];
+				// Free tiles over walkable terrain
+				uint64 candidate = free & ~solid[w] & walkableBelow[w];
+
+				uint64 lowerRightEmpty = ~NextTile(presentBelow, w, words);
+				uint64 lowerRightSolid = NextTile(solidBelow, w, words);
+				uint64 rightSolid = NextTile(solid, w, words);
+				uint64 platformEnd = lowerRightEmpty | rightSolid;
+
+				// A candidate starts (or keeps) a platform unless it is also its end, then
+				// it closes it. Any other tile leaves it as it was. That is a carry chain:
+				// candidates that don't end generate a carry, other tiles propagate it.
+				uint64 propagate = ~(candidate & platformEnd);
+				uint64 generate = candidate & ~platformEnd;
+				uint64 sum = propagate + generate + carry;
+				carry = ((propagate & generate) | ((propagate | generate) & ~sum)) >> 63;
+				uint64 startedBefore = sum ^ propagate ^ generate;
+
+				uint64 first = candidate & ~startedBefore;
+				uint64 rest = candidate & startedBefore;
+
+				uint64 left = first & ~platformEnd;
+				uint64 solo = first & (lowerRightEmpty ^ rightSolid);
+				uint64 right = (first & lowerRightEmpty & rightSolid) | (rest & platformEnd);
+				uint64 platform = rest & ~platformEnd & lowerRightSolid;
+
+				classified[w] |= terrain | left | solo | right | platform;
+
+				CL::NavType *wordTypes = types + w * 64;
+				WriteTypes(terrain, TERRAIN, wordTypes);
+				WriteTypes(left, LEFT, wordTypes);
+				WriteTypes(solo, SOLO, wordTypes);
+				WriteTypes(right, RIGHT, wordTypes);
+				WriteTypes(platform, PLATFORM, wordTypes);
+			}
+		}
+	}
 
-				// Check if bottom tile is walkable terrain
-				uint lowerGid = layer->GetGidValue(x, y + 1);
-				if(lowerGid <= 0 || !IsWalkable(lowerGid)) continue;
+	CreateTerrainCosts(layers, *groundWalkabilityMap);
 
-				// If platform is not started, we assign it as left edge and start a new platform
-				if(!platformStarted)
-				{
-					platformStarted = true;
-					groundWalkabilityMap->at(x).at(y).type = LEFT;
-				}
+	return groundWalkabilityMap;
+}
 
-				// Check lower right tile
-				uint lowerRightGid = layer->GetGidValue(x + 1, y + 1);
-				// If there's no tile
-				if(lowerRightGid <= 0)
-				{
-					if(groundWalkabilityMap->at(x).at(y).type == LEFT) groundWalkabilityMap->at(x).at(y).type = SOLO;
-					else groundWalkabilityMap->at(x).at(y).type = RIGHT;
-					platformStarted = false;
-				}
+void Map::CreateTerrainCosts(std::vector<WalkabilityLayer> const &layers, NavGrid &navGrid)
+{
+	auto tiles = static_cast<size_t>(navGrid.width) * navGrid.height;
+	navGrid.terrainCosts.assign(tiles * TERRAIN_COST_LAYERS, 0);
 
-				if((IsTerrain(lowerRightGid) || IsWalkable(lowerRightGid)) && groundWalkabilityMap->at(x).at(y).type != LEFT)
-					groundWalkabilityMap->at(x).at(y).type = PLATFORM;
+	for(auto const &layer : layers)
+	{
+		if(layer.costs.empty()) continue;
 
-				// Check right tile
-				uint rightGid = layer->GetGidValue(x + 1, y);
-				// If there's no tile
-				if(rightGid <= 0 && groundWalkabilityMap->at(x).at(y).type != LEFT) continue;
+		int columns = std::min(layer.width, navGrid.width);
+		int rows = std::min(layer.height, navGrid.height);
+		for(int y = 0; y < rows; y++)
+		{
+			for(int x = 0; x < columns; x++)
+			{
+				uchar const *inside = &layer.costs[(static_cast<size_t>(y) * layer.width + x) * TERRAIN_COST_LAYERS];
+				uchar const *below = (y + 1 < layer.height) ? inside + static_cast<size_t>(layer.width) * TERRAIN_COST_LAYERS : inside;
 
-				// If there's info about the tile
-				if(IsTerrain(rightGid) || IsWalkable(rightGid))
+				for(int i = 0; i < TERRAIN_COST_LAYERS; i++)
 				{
-					if(groundWalkabilityMap->at(x).at(y).type == LEFT) groundWalkabilityMap->at(x).at(y).type = SOLO;
-					else groundWalkabilityMap->at(x).at(y).type = RIGHT;
-					platformStarted = false;
+					uchar &cost = navGrid.terrainCosts[i * tiles + y * navGrid.width + x];
+					cost = std::max({cost, inside[i], below[i]});
 				}
 			}
 		}
 	}
-
-	return groundWalkabilityMap;
 }
 
 bool Map::IsWalkable(uint gid) const
@@ -717,7 +940,91 @@ bool Map::IsTerrain(uint gid) const
 	return false;
 }
 
+std::array<uchar, TERRAIN_COST_LAYERS> Map::GetTerrainCosts(uint gid) const
+{
+	std::array<uchar, TERRAIN_COST_LAYERS> costs = {};
+
+	TileSet *tileset = GetTilesetFromTileId(gid);
+	auto tileInfo = tileset->tileInfo.find(gid-1);
+	if(tileInfo == tileset->tileInfo.end()) return costs;
+
+	auto const &properties = tileInfo->second->properties;
+	auto getCost = [&properties](const char *name, int defaultCost)
+	{
+		auto property = properties.find(name);
+		if(property == properties.end()) return defaultCost;
+		if(auto const *value = std::get_if<int>(&property->second)) return std::clamp(*value, 0, 255);
+		return defaultCost;
+	};
+
+	// Other movement types cost the same as ground unless the tile says otherwise
+	costs[0] = static_cast<uchar>(getCost(TERRAIN_COST_PROPERTIES[0], 0));
+	for(int i = 1; i < TERRAIN_COST_LAYERS; i++)
+		costs[i] = static_cast<uchar>(getCost(TERRAIN_COST_PROPERTIES[i], costs[0]));
+
+	return costs;
+}
+
+TileCollision Map::GetTileCollision(uint gid) const
+{
+	using enum TileCollision;
+
+	TileSet *tileset = GetTilesetFromTileId(gid);
+	auto tileInfo = tileset->tileInfo.find(gid-1);
+	if(tileInfo == tileset->tileInfo.end()) return EMPTY;
+
+	auto const &properties = tileInfo->second->properties;
+	if(auto property = properties.find("Collision"); property != properties.end())
+	{
+		if(auto const *value = std::get_if<std::string>(&property->second))
+		{
+			if(StrEquals(*value, "solid")) return SOLID;
+			if(StrEquals(*value, "oneway")) return ONE_WAY;
+			if(StrEquals(*value, "slopeup")) return SLOPE_UP;
+			if(StrEquals(*value, "slopedown")) return SLOPE_DOWN;
+			if(StrEquals(*value, "none")) return EMPTY;
+			LOG("Unknown collision %s on tile %u", value->c_str(), gid);
+		}
+	}
+
+	return tileInfo->second->collider.empty() ? EMPTY : SOLID;
+}
+
+CollisionGrid const &Map::GetCollisionGrid() const
+{
+	return collisionGrid;
+}
+
+void Map::CreateCollisionGrid()
+{
+	collisionGrid.width = mapData.width;
+	collisionGrid.height = mapData.height;
+	collisionGrid.tileWidth = mapData.tileWidth;
+	collisionGrid.tileHeight = mapData.tileHeight;
+	collisionGrid.tiles.assign(static_cast<size_t>(mapData.width) * mapData.height, TileCollision::EMPTY);
+
+	// Tileset lookups are slow, so we only do them once per gid
+	std::unordered_map<uint, TileCollision> gidCollisions;
+	for(auto const &layer : mapData.mapLayers)
+	{
+		for(int i = 0; i < layer->tileData.size() && i < collisionGrid.tiles.size(); i++)
+		{
+			uint gid = layer->tileData[i].originalGid;
+			if(gid == 0) continue;
+
+			auto [it, bInserted] = gidCollisions.try_emplace(gid, TileCollision::EMPTY);
+			if(bInserted) it->second = GetTileCollision(gid);
+			if(it->second != TileCollision::EMPTY) collisionGrid.tiles[i] = it->second;
+		}
+	}
+}
+
 std::string_view Map::GetMapFolderName() const
 {
 	return mapFolder;
 }
+
+std::string_view Map::GetMapFileName() const
+{
+	return mapFileName;
+}
@@ -9,8 +9,10 @@
 #include "BitMaskNavType.h"
 
 
+#include <array>
 #include <functional>
 #include <vector>
+#include <span>
 #include <cstdlib>			//	std::rand
 
 #include "PugiXml/src/pugixml.hpp"
@@ -37,14 +39,129 @@ struct NavLink
 	NavLinkType movement = NavLinkType::UNKNOWN;
 };
 
-struct NavPoint
+// Navigation graph of the map, stored row-major.
+// Tile (x, y) is at index y * width + x in every per-tile array.
+struct NavGrid
 {
-	NavPoint() = default;
-	CL::NavType type = CL::NavType::NONE;
+	int width = 0;
+	int height = 0;
+
+	std::vector<CL::NavType> types;
+
+	// Links of tile i are links[linkOffsets[i]] .. links[linkOffsets[i + 1]]
+	std::vector<int> linkOffsets;
 	std::vector<NavLink> links;
+
+	// Same links grouped by the tile they end at. Their destination is the tile they start from.
+	std::vector<int> reverseLinkOffsets;
+	std::vector<NavLink> reverseLinks;
+
+	// First row at or under tile i whose type is not NONE, -1 if there is none
+	std::vector<int> terrainBelow;
+
+	// ALT heuristic: exact link distances from and to a few landmark tiles.
+	// landmarkSlot maps a tile to its row in the distance tables, -1 if the tile has no links.
+	// Row r of a table holds one distance per landmark, INT_MAX if there is no path.
+	std::vector<int> landmarks;
+	std::vector<int> landmarkSlot;
+	std::vector<int> distanceFromLandmark;
+	std::vector<int> distanceToLandmark;
+
+	// TERRAIN_COST_LAYERS grids of width * height, one after the other.
+	// Extra cost of a link that ends at the tile for the movement type of the layer.
+	std::vector<uchar> terrainCosts;
+
+	inline int Index(iPoint p) const
+	{
+		return p.y * width + p.x;
+	}
+
+	inline iPoint ToPoint(int i) const
+	{
+		return {i % width, i / width};
+	}
+
+	inline bool IsValid(iPoint p) const
+	{
+		return p.x >= 0 && p.x < width && p.y >= 0 && p.y < height;
+	}
+
+	inline CL::NavType GetType(iPoint p) const
+	{
+		return types[Index(p)];
+	}
+
+	inline std::span<const NavLink> GetLinks(iPoint p) const
+	{
+		int i = Index(p);
+		if(linkOffsets.empty()) return {};
+		return std::span<const NavLink>(links.data() + linkOffsets[i], links.data() + linkOffsets[i + 1]);
+	}
+
+	inline std::span<const NavLink> GetReverseLinks(iPoint p) const
+	{
+		int i = Index(p);
+		if(reverseLinkOffsets.empty()) return {};
+		return std::span<const NavLink>(reverseLinks.data() + reverseLinkOffsets[i], reverseLinks.data() + reverseLinkOffsets[i + 1]);
+	}
+
+	inline std::span<const uchar> GetTerrainCosts(int layer) const
+	{
+		auto tiles = static_cast<size_t>(width) * height;
+		return std::span<const uchar>(terrainCosts.data() + layer * tiles, tiles);
+	}
 };
 
-using navPointMatrix = std::vector<std::vector<NavPoint>>;
+// Tile flags used to classify the navigation grid
+constexpr uchar TILE_PRESENT = 0x01;
+constexpr uchar TILE_WALKABLE = 0x02;
+constexpr uchar TILE_TERRAIN = 0x04;
+
+// Movement types with their own cost layer, in layer order.
+// A tile sets its cost for each of them with an int property named "<Type>Cost",
+// 0 to 255. A type without a property costs the same as Ground, which defaults to 0.
+constexpr int TERRAIN_COST_LAYERS = 3;
+constexpr std::array<const char *, TERRAIN_COST_LAYERS> TERRAIN_COST_PROPERTIES = {"GroundCost", "WaterCost", "LavaCost"};
+// Links that end at a tile with this cost can't be used
+constexpr uchar BLOCKED_TERRAIN_COST = 255;
+
+// Walkability information of a map layer, one flag byte per tile in row-major order
+struct WalkabilityLayer
+{
+	int width = 0;
+	int height = 0;
+	std::vector<uchar> flags;
+	// TERRAIN_COST_LAYERS bytes per tile. Empty if every tile costs 0.
+	std::vector<uchar> costs;
+
+	inline uchar GetFlags(int x, int y) const
+	{
+		return flags[y * width + x];
+	}
+};
+
+// Walkability of a map layer as bitsets, rowWords words per row.
+// Bit x % 64 of word x / 64 in row y is the tile (x, y).
+struct WalkabilityBits
+{
+	int width = 0;
+	int height = 0;
+	int rowWords = 0;
+	std::vector<uint64> present;
+	std::vector<uint64> walkable;
+	// Walkable or terrain
+	std::vector<uint64> solid;
+
+	inline uint64 *GetRow(std::vector<uint64> &bits, int y) const
+	{
+		return bits.data() + static_cast<size_t>(y) * rowWords;
+	}
+
+	inline uint64 const *GetRow(std::vector<uint64> const &bits, int y) const
+	{
+		return bits.data() + static_cast<size_t>(y) * rowWords;
+	}
+};
 
 enum class MapTypes
 {
@@ -219,14 +336,33 @@ public:
 
 	int GetTileSetSize() const;
 
-	std::unique_ptr<navPointMatrix> CreateWalkabilityMap();
+	std::unique_ptr<NavGrid> CreateWalkabilityMap();
+
+	// Builds the node types of a nav grid from the walkability flags of each layer.
+	// It doesn't need a loaded map, so tools can call it with their own layers.
+	static std::unique_ptr<NavGrid> ClassifyWalkability(int width, int height, std::vector<WalkabilityLayer> const &layers);
+	static WalkabilityBits PackWalkabilityLayer(WalkabilityLayer const &layer);
+	// Cost of a node is the highest of the tile it's in and the tile it stands on, over every layer
+	static void CreateTerrainCosts(std::vector<WalkabilityLayer> const &layers, NavGrid &navGrid);
 
 	bool IsWalkable(uint gid) const;
 
 	bool IsTerrain(uint gid) const;
 
+	// Costs of the tile for every movement type, see TERRAIN_COST_PROPERTIES
+	std::array<uchar, TERRAIN_COST_LAYERS> GetTerrainCosts(uint gid) const;
+
+	// From the "Collision" string property of the tile: solid, oneway, slopeup, slopedown or none.
+	// Tiles without it are solid if they have a collider.
+	TileCollision GetTileCollision(uint gid) const;
+
+	// What every tile does to the character controllers
+	CollisionGrid const &GetCollisionGrid() const;
+
 	std::string_view GetMapFolderName() const;
 
+	std::string_view GetMapFileName() const;
+
 private:
 
 	bool LoadMap(pugi::xml_node const &mapFile);
@@ -245,13 +381,17 @@ private:
 
 	void LogLoadedData() const;
 
-	std::unique_ptr<navPointMatrix> CreateWalkabilityNodes() const;
+	std::unique_ptr<NavGrid> CreateWalkabilityNodes() const;
+
+	// The tile of the highest layer that collides wins
+	void CreateCollisionGrid();
 
 	MapData mapData;
 	std::string mapFileName;
 	std::string mapFolder;
 	bool mapLoaded = false;
 	std::vector<std::unique_ptr<PhysBody>> terrainColliders;
+	CollisionGrid collisionGrid;
 	
 };
 
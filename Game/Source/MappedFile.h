@@ -0,0 +1,38 @@
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include "Defs.h"
+
+#include <span>
+#include <string>
+
+// Read-only view of a whole file mapped in memory.
+// The pages are loaded by the OS as they are read, and the view
+// is released when the object is destroyed.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(std::string const &path);
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	bool Open(std::string const &path);
+	void Close();
+
+	bool IsOpen() const;
+	std::span<const uchar> GetData() const;
+
+private:
+	uchar const *data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void *file = nullptr;
+	void *mapping = nullptr;
+#endif
+};
+
+#endif // __MAPPEDFILE_H__
@@ -3,105 +3,445 @@
 
 #include "Map.h"
 #include "Render.h"
+#include "Window.h"
 
 #include "Log.h"
 
 #include "BitMaskNavType.h"
+#include "MappedFile.h"
 
 #include <numeric>
+#include <climits>
+#include <functional>
 #include <utility>
+#include <algorithm>
 #include <queue>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <limits>
+#include <cmath>
 
-// ---------- SearchNode ----------
-std::vector<NavLink> SearchNode::GetAdjacentGroundNodes(std::shared_ptr<SearchNode> searchNode) const
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// ---------- PathFinding ---------
+Pathfinding::Pathfinding() : Module()
 {
-	std::vector<NavLink> list;
+	name = "pathfinding";
+}
 
-	iPoint currentPosition = searchNode.get()->position;
-	// If we are not in a valid position we just return
-	// TODO: Make this throw an exception.
-	// Not done becuase I don't have enough time, so I don't
-	// want to risk pathfinding malfunctioning and crashing the game.
-	if(!app->pathfinding->IsValidPosition(currentPosition)) return list;
-	
-	using enum CL::NavType;
-	NavPoint currentNavPoint = app->pathfinding->GetNavPoint(searchNode.get()->position);
-	CL::NavType currentType = currentNavPoint.type;
-	
-	if(IsWalkable(currentPosition.Right()) && (currentType == LEFT || currentType == PLATFORM))
-		list.emplace_back(currentPosition.Right(), 10, NavLinkType::WALK);
+bool Pathfinding::Awake(pugi::xml_node &config)
+{
+	if(auto budget = config.child("search").attribute("expansionsperframe"); budget)
+		expansionsPerFrame = std::max(1, budget.as_int());
 
-	if(IsWalkable(currentPosition.Left()) && (currentType == RIGHT || currentType == PLATFORM))
-		list.emplace_back(currentPosition.Left(), 10, NavLinkType::WALK);
+	if(auto count = config.child("landmarks").attribute("count"); count)
+		SetLandmarkCount(count.as_int());
 
-	for(auto const &elem : currentNavPoint.links)
-	{
-		list.emplace_back(elem);
-	}
+	incrementalChase = config.child("chase").attribute("incremental").as_bool(incrementalChase);
 
-	return list;
+	return true;
 }
 
-std::vector<NavLink> SearchNode::GetAdjacentAirNodes(std::shared_ptr<SearchNode> searchNode, iPoint destination) const
+int Pathfinding::GetExpansionsPerFrame() const
 {
-	std::vector<NavLink> list;
-	// Check all directions, including diagonals
-	iPoint pos = searchNode.get()->position;
-	for(int x = pos.x - 1; x <= pos.x + 1; x++)
-	{
-		for(int y = pos.y - 1; y <= pos.y + 1; y++)
-		{
-			// If it's the tile we are at or if it's out of bounds
-			// we continue the loop
-			if(!app->pathfinding->IsValidPosition(iPoint(x, y))
-			   || (x == pos.x && y == pos.y))
-				continue;
-
-			if(app->pathfinding->GetNavPoint(iPoint(x, y)).type != CL::NavType::NONE
-			   && destination != iPoint(x, y)) continue;
+	return expansionsPerFrame;
+}
 
-			// Diagonal cost is 14 (if x == (1 or -1) and y == (1 or -1))
-			// Can also be checked as (x && y), and another option would be ((x & y) == 1)
-			int score = abs(x) == abs(y) ? 14 : 10;
-			list.emplace_back(iPoint(x, y), score, NavLinkType::WALK);
-		}
-	}
-	return list;
+void Pathfinding::SetLandmarkCount(int count)
+{
+	landmarkCount = std::clamp(count, 0, MAX_LANDMARKS);
 }
 
-bool SearchNode::IsWalkable(iPoint p) const
+bool Pathfinding::IsIncrementalChaseEnabled() const
 {
-	return app->pathfinding->IsValidPosition(p)
-		&& app->pathfinding->GetNavPoint(p).type != CL::NavType::NONE;
+	return incrementalChase;
 }
 
-// ---------- PathFinding ---------
 bool Pathfinding::SetWalkabilityMap()
 {
-	auto mapPtr = app->map->CreateWalkabilityMap();
+	std::string mapFile(app->map->GetMapFileName());
+	std::string cachePath = mapFile.substr(0, mapFile.find_last_of('.')) + ".nav";
+	uint64 cacheKey = GetNavCacheKey(mapFile);
+
+	// The nav graph is only built if the map or the generation parameters changed
+	if(cacheKey && LoadNavCache(cachePath, cacheKey)) return true;
+
+	if(!SetWalkabilityMap(app->map->CreateWalkabilityMap())) return false;
+
+	if(cacheKey) SaveNavCache(cachePath, cacheKey);
+
+	return true;
+}
 
+bool Pathfinding::SetWalkabilityMap(std::unique_ptr<NavGrid> navGrid)
+{
 	// Overwrite if there is already a groundMap
-	if(groundMap) groundMap.reset(mapPtr.release());
+	if(groundMap) groundMap.reset(navGrid.release());
 	// Otherwise create a new groundMap
-	else groundMap = std::move(mapPtr);
+	else groundMap = std::move(navGrid);
 
 	if(!groundMap) return false;
 
 	CreateWalkabilityLinks();
+	CreateReverseLinks();
+	CreateTerrainBelow();
+	CreateAirOccupancy();
+	CreateLandmarks();
+	ResetTerrainCosts();
 
 	return true;
 }
 
-NavPoint &Pathfinding::GetNavPoint(iPoint position) const
+void Pathfinding::ResetTerrainCosts()
 {
-	return groundMap->at(position.x)[position.y];
+	// Grids built by hand may come without costs, then every tile costs 0
+	if(auto size = groundMap->types.size() * TERRAIN_COST_LAYERS; groundMap->terrainCosts.size() != size)
+		groundMap->terrainCosts.assign(size, 0);
+
+	for(auto &costs : terrainMaskCosts)
+		costs.clear();
+}
+
+std::span<const uchar> Pathfinding::GetTerrainCosts(PathfindTerrain mask) const
+{
+	if(!groundMap) return {};
+
+	int maskIndex = 0;
+	for(int i = 0; i < TERRAIN_COST_LAYERS; i++)
+	{
+		if((mask & TERRAIN_COST_TYPES[i]) != PathfindTerrain::NONE)
+			maskIndex |= 1 << i;
+	}
+	// Agents that don't name any terrain with costs move like ground ones
+	if(maskIndex == 0) maskIndex = 1;
+
+	std::vector<uchar> &costs = terrainMaskCosts[maskIndex];
+	if(costs.empty())
+	{
+		costs.assign(groundMap->types.size(), BLOCKED_TERRAIN_COST);
+		for(int i = 0; i < TERRAIN_COST_LAYERS; i++)
+		{
+			if(!(maskIndex & (1 << i))) continue;
+			auto layer = groundMap->GetTerrainCosts(i);
+			std::ranges::transform(costs, layer, costs.begin(), [](uchar a, uchar b) { return std::min(a, b); });
+		}
+	}
+
+	return costs;
+}
+
+uchar Pathfinding::SetTerrainCost(iPoint tile, int layer, uchar cost)
+{
+	if(!IsValidPosition(tile) || layer < 0 || layer >= TERRAIN_COST_LAYERS) return 0;
+
+	auto index = static_cast<size_t>(groundMap->Index(tile));
+	uchar &layerCost = groundMap->terrainCosts[layer * groundMap->types.size() + index];
+	uchar previous = std::exchange(layerCost, cost);
+
+	// Grids that are already built are patched in place instead of being built again
+	for(int maskIndex = 1; maskIndex < static_cast<int>(terrainMaskCosts.size()); maskIndex++)
+	{
+		std::vector<uchar> &costs = terrainMaskCosts[maskIndex];
+		if(costs.empty()) continue;
+
+		costs[index] = BLOCKED_TERRAIN_COST;
+		for(int i = 0; i < TERRAIN_COST_LAYERS; i++)
+		{
+			if(maskIndex & (1 << i))
+				costs[index] = std::min(costs[index], groundMap->GetTerrainCosts(i)[index]);
+		}
+	}
+	return previous;
+}
+
+PathfindTerrain Pathfinding::ParseTerrainMask(std::string_view names)
+{
+	constexpr std::array<std::pair<std::string_view, PathfindTerrain>, 4> terrainNames = {{
+		{"Ground", PathfindTerrain::GROUND},
+		{"Air", PathfindTerrain::AIR},
+		{"Water", PathfindTerrain::WATER},
+		{"Lava", PathfindTerrain::LAVA}
+	}};
+
+	PathfindTerrain mask = PathfindTerrain::NONE;
+	while(!names.empty())
+	{
+		auto comma = names.find(',');
+		std::string_view name = names.substr(0, comma);
+		names = (comma == std::string_view::npos) ? std::string_view() : names.substr(comma + 1);
+
+		while(!name.empty() && name.front() == ' ') name.remove_prefix(1);
+		while(!name.empty() && name.back() == ' ') name.remove_suffix(1);
+
+		auto terrain = std::ranges::find(terrainNames, name, &std::pair<std::string_view, PathfindTerrain>::first);
+		if(terrain != terrainNames.end()) mask = mask | terrain->second;
+		else if(!name.empty()) LOG("Unknown terrain %.*s", static_cast<int>(name.size()), name.data());
+	}
+
+	return mask;
+}
+
+void Pathfinding::CreateAirOccupancy()
+{
+	int width = groundMap->width;
+	int height = groundMap->height;
+	airRowWords = (width + 63) / 64;
+	airBlocked.assign(static_cast<size_t>(airRowWords) * height, 0);
+
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			if(groundMap->types[y * width + x] == CL::NavType::NONE) continue;
+			airBlocked[y * airRowWords + x / 64] |= 1ULL << (x % 64);
+		}
+	}
+}
+
+void Pathfinding::CreateTerrainBelow()
+{
+	int width = groundMap->width;
+	groundMap->terrainBelow.assign(groundMap->types.size(), -1);
+
+	for(int x = 0; x < width; x++)
+	{
+		int below = -1;
+		for(int y = groundMap->height - 1; y >= 0; y--)
+		{
+			if(groundMap->types[y * width + x] != CL::NavType::NONE) below = y;
+			groundMap->terrainBelow[y * width + x] = below;
+		}
+	}
+}
+
+CL::NavType Pathfinding::GetNavType(iPoint position) const
+{
+	return groundMap->GetType(position);
+}
+
+std::span<const NavLink> Pathfinding::GetNavLinks(iPoint position) const
+{
+	return groundMap->GetLinks(position);
+}
+
+std::span<const NavLink> Pathfinding::GetReverseNavLinks(iPoint position) const
+{
+	return groundMap->GetReverseLinks(position);
 }
 
 bool Pathfinding::IsValidPosition(iPoint position) const
 {
-	return (position.x >= 0 && position.x < groundMap->size() &&
-			position.y >= 0 && position.y < groundMap->at(0).size());
+	return groundMap->IsValid(position);
+}
+
+bool Pathfinding::IsTileBlocked(iPoint position) const
+{
+	if(!groundMap || !groundMap->IsValid(position)) return false;
+	return (airBlocked[position.y * airRowWords + position.x / 64] & (1ULL << (position.x % 64))) != 0;
+}
+
+namespace
+{
+	// Walk state of a segment through the grid, in tile units
+	struct TileWalk
+	{
+		iPoint tile;
+		iPoint step;
+		// Fraction of the segment it takes to cross a whole tile on each axis,
+		// and fraction at which it crosses the next tile border
+		fPoint crossTile;
+		fPoint nextBorder;
+		// Tiles left after the current one
+		int remaining = 0;
+	};
+
+	TileWalk StartTileWalk(fPoint from, fPoint to)
+	{
+		TileWalk walk;
+		walk.tile = iPoint(static_cast<int>(std::floor(from.x)), static_cast<int>(std::floor(from.y)));
+		iPoint last(static_cast<int>(std::floor(to.x)), static_cast<int>(std::floor(to.y)));
+
+		fPoint delta = to - from;
+		walk.step = iPoint(
+			(delta.x > 0) ? 1 : ((delta.x < 0) ? -1 : 0),
+			(delta.y > 0) ? 1 : ((delta.y < 0) ? -1 : 0)
+		);
+
+		constexpr float never = std::numeric_limits<float>::infinity();
+		walk.crossTile = fPoint(walk.step.x ? std::abs(1.0f / delta.x) : never, walk.step.y ? std::abs(1.0f / delta.y) : never);
+		walk.nextBorder = fPoint(
+			(walk.step.x > 0) ? (static_cast<float>(walk.tile.x + 1) - from.x) * walk.crossTile.x : ((walk.step.x < 0) ? (from.x - static_cast<float>(walk.tile.x)) * walk.crossTile.x : never),
+			(walk.step.y > 0) ? (static_cast<float>(walk.tile.y + 1) - from.y) * walk.crossTile.y : ((walk.step.y < 0) ? (from.y - static_cast<float>(walk.tile.y)) * walk.crossTile.y : never)
+		);
+		walk.remaining = std::abs(last.x - walk.tile.x) + std::abs(last.y - walk.tile.y);
+		return walk;
+	}
+
+	// Start of LANES tile walks, one array per field so the SIMD paths can load them
+	template<size_t LANES>
+	struct TileWalkLanes
+	{
+		alignas(32) std::array<int, LANES> tileX;
+		alignas(32) std::array<int, LANES> tileY;
+		alignas(32) std::array<int, LANES> stepX;
+		alignas(32) std::array<int, LANES> stepY;
+		alignas(32) std::array<int, LANES> remaining;
+		alignas(32) std::array<float, LANES> crossX;
+		alignas(32) std::array<float, LANES> crossY;
+		alignas(32) std::array<float, LANES> borderX;
+		alignas(32) std::array<float, LANES> borderY;
+
+		TileWalkLanes(std::span<const fPoint> from, std::span<const fPoint> to)
+		{
+			for(size_t lane = 0; lane < LANES; lane++)
+			{
+				TileWalk walk = StartTileWalk(from[lane], to[lane]);
+				tileX[lane] = walk.tile.x;
+				tileY[lane] = walk.tile.y;
+				stepX[lane] = walk.step.x;
+				stepY[lane] = walk.step.y;
+				remaining[lane] = walk.remaining;
+				crossX[lane] = walk.crossTile.x;
+				crossY[lane] = walk.crossTile.y;
+				borderX[lane] = walk.nextBorder.x;
+				borderY[lane] = walk.nextBorder.y;
+			}
+		}
+	};
+}
+
+bool Pathfinding::SegmentCast(fPoint from, fPoint to, float &fraction, iPoint &hitTile) const
+{
+	TileWalk walk = StartTileWalk(from, to);
+
+	float t = 0.0f;
+	for(; ; walk.remaining--)
+	{
+		if(IsTileBlocked(walk.tile))
+		{
+			fraction = std::min(t, 1.0f);
+			hitTile = walk.tile;
+			return true;
+		}
+		if(walk.remaining <= 0) return false;
 
+		if(walk.nextBorder.x < walk.nextBorder.y)
+		{
+			walk.tile.x += walk.step.x;
+			t = walk.nextBorder.x;
+			walk.nextBorder.x += walk.crossTile.x;
+		}
+		else
+		{
+			walk.tile.y += walk.step.y;
+			t = walk.nextBorder.y;
+			walk.nextBorder.y += walk.crossTile.y;
+		}
+	}
+}
+
+void Pathfinding::LineOfSight(std::span<const fPoint> from, std::span<const fPoint> to, std::span<uchar> visible) const
+{
+	size_t count = std::min({from.size(), to.size(), visible.size()});
+	if(!groundMap)
+	{
+		std::fill_n(visible.begin(), count, static_cast<uchar>(1));
+		return;
+	}
+
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	// Eight segments walk side by side, one tile per lane and iteration.
+	// Lanes stop when they hit a blocked tile or reach their last one.
+	constexpr size_t LANES = 8;
+	auto const *words = reinterpret_cast<int const *>(airBlocked.data());
+	__m256i const zero = _mm256_setzero_si256();
+	__m256i const one = _mm256_set1_epi32(1);
+	__m256i const minusOne = _mm256_set1_epi32(-1);
+	__m256i const bitMask = _mm256_set1_epi32(31);
+	__m256i const rowInts = _mm256_set1_epi32(airRowWords * 2);
+	__m256i const width = _mm256_set1_epi32(groundMap->width);
+	__m256i const height = _mm256_set1_epi32(groundMap->height);
+
+	for(; i + LANES <= count; i += LANES)
+	{
+		TileWalkLanes<LANES> lanes(from.subspan(i, LANES), to.subspan(i, LANES));
+
+		__m256i tx = _mm256_load_si256(reinterpret_cast<__m256i const *>(lanes.tileX.data()));
+		__m256i ty = _mm256_load_si256(reinterpret_cast<__m256i const *>(lanes.tileY.data()));
+		__m256i sx = _mm256_load_si256(reinterpret_cast<__m256i const *>(lanes.stepX.data()));
+		__m256i sy = _mm256_load_si256(reinterpret_cast<__m256i const *>(lanes.stepY.data()));
+		__m256i left = _mm256_load_si256(reinterpret_cast<__m256i const *>(lanes.remaining.data()));
+		__m256 cx = _mm256_load_ps(lanes.crossX.data());
+		__m256 cy = _mm256_load_ps(lanes.crossY.data());
+		__m256 nx = _mm256_load_ps(lanes.borderX.data());
+		__m256 ny = _mm256_load_ps(lanes.borderY.data());
+
+		__m256i active = minusOne;
+		__m256i blocked = zero;
+		while(true)
+		{
+			// Tiles outside the map never block, so those lanes skip the lookup
+			__m256i inside = _mm256_and_si256(
+				_mm256_and_si256(_mm256_cmpgt_epi32(tx, minusOne), _mm256_cmpgt_epi32(width, tx)),
+				_mm256_and_si256(_mm256_cmpgt_epi32(ty, minusOne), _mm256_cmpgt_epi32(height, ty))
+			);
+			__m256i lookup = _mm256_and_si256(active, inside);
+
+			// airBlocked read as 32 bit words: tile (x, y) is bit x % 32 of word y * rowInts + x / 32
+			__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(ty, rowInts), _mm256_srli_epi32(tx, 5));
+			__m256i word = _mm256_mask_i32gather_epi32(zero, words, index, lookup, 4);
+			__m256i bit = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(tx, bitMask)), one);
+			__m256i hit = _mm256_and_si256(_mm256_cmpeq_epi32(bit, one), lookup);
+
+			blocked = _mm256_or_si256(blocked, hit);
+			active = _mm256_andnot_si256(hit, active);
+			active = _mm256_and_si256(active, _mm256_cmpgt_epi32(left, zero));
+			if(_mm256_testz_si256(active, active)) break;
+
+			// Same choice as SegmentCast: x if its border comes first, y otherwise
+			__m256i alongX = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(nx, ny, _CMP_LT_OQ)), active);
+			__m256i alongY = _mm256_andnot_si256(alongX, active);
+			tx = _mm256_add_epi32(tx, _mm256_and_si256(sx, alongX));
+			ty = _mm256_add_epi32(ty, _mm256_and_si256(sy, alongY));
+			nx = _mm256_add_ps(nx, _mm256_and_ps(cx, _mm256_castsi256_ps(alongX)));
+			ny = _mm256_add_ps(ny, _mm256_and_ps(cy, _mm256_castsi256_ps(alongY)));
+			left = _mm256_sub_epi32(left, _mm256_and_si256(one, active));
+		}
+
+		alignas(32) std::array<int, LANES> result;
+		_mm256_store_si256(reinterpret_cast<__m256i *>(result.data()), blocked);
+		for(size_t lane = 0; lane < LANES; lane++)
+			visible[i + lane] = (result[lane] == 0) ? 1 : 0;
+	}
+#endif
+
+	// Whatever didn't fill a whole block, or every segment without SIMD
+	for(; i < count; i++)
+	{
+		float fraction = 0.0f;
+		iPoint hitTile;
+		visible[i] = SegmentCast(from[i], to[i], fraction, hitTile) ? 0 : 1;
+	}
+}
+
+int Pathfinding::GetWidth() const
+{
+	return groundMap ? groundMap->width : 0;
+}
+
+int Pathfinding::GetHeight() const
+{
+	return groundMap ? groundMap->height : 0;
+}
+
+SearchStats const &Pathfinding::GetLastSearchStats() const
+{
+	return lastSearch;
 }
 
 int Pathfinding::HeuristicCost(iPoint origin, iPoint destination) const
@@ -109,145 +449,1023 @@ int Pathfinding::HeuristicCost(iPoint origin, iPoint destination) const
 	return origin.DistanceManhattan(destination);
 }
 
+int Pathfinding::OctileCost(iPoint origin, iPoint destination) const
+{
+	int dx = abs(destination.x - origin.x);
+	int dy = abs(destination.y - origin.y);
+	// 14 for each diagonal step and 10 for each straight one
+	return 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+}
+
 std::unique_ptr<std::vector<iPoint>> Pathfinding::AStarSearch(iPoint origin, iPoint destination, PathfindTerrain pTerrain) const
 {
-	// Check if path is valid. If it isn't log it and return an empty path
-	if(!IsValidPosition(origin) || !IsValidPosition(destination))
+	// Same search the enemies slice over several frames, but run until it finishes
+	PathSearch search(this);
+	search.Start(origin, destination, pTerrain);
+	search.Run();
+
+	return search.TakePath();
+}
+
+// ---------- Nav graph cache ---------
+namespace
+{
+	// "NAVC" in little endian
+	constexpr uint32 NAV_CACHE_MAGIC = 0x4356414E;
+	// Increase it when the file layout or the way the graph is built changes
+	constexpr uint32 NAV_CACHE_VERSION = 2;
+
+	struct NavCacheHeader
+	{
+		uint32 magic = NAV_CACHE_MAGIC;
+		uint32 version = NAV_CACHE_VERSION;
+		uint64 key = 0;
+		int width = 0;
+		int height = 0;
+	};
+
+	template<typename T> requires std::is_trivially_copyable_v<T>
+	bool WriteCacheVector(std::FILE *file, std::vector<T> const &vector)
+	{
+		uint64 count = vector.size();
+		if(std::fwrite(&count, sizeof(count), 1, file) != 1) return false;
+		return count == 0 || std::fwrite(vector.data(), sizeof(T), count, file) == count;
+	}
+
+	template<typename T> requires std::is_trivially_copyable_v<T>
+	bool ReadCacheVector(std::span<const uchar> &data, std::vector<T> &vector)
+	{
+		uint64 count = 0;
+		if(data.size() < sizeof(count)) return false;
+		std::memcpy(&count, data.data(), sizeof(count));
+		data = data.subspan(sizeof(count));
+
+		if(count > data.size() / sizeof(T)) return false;
+		vector.resize(count);
+		if(count > 0) std::memcpy(vector.data(), data.data(), count * sizeof(T));
+		data = data.subspan(count * sizeof(T));
+		return true;
+	}
+}
+
+uint64 Pathfinding::GetNavCacheKey(std::string const &mapFile) const
+{
+	MappedFile file(mapFile);
+	if(!file.IsOpen()) return 0;
+
+	auto map = file.GetData();
+	uint64 key = HashBytes(map.data(), map.size());
+
+	// Tilesets kept in their own .tsx have properties of the tiles too
+	pugi::xml_document mapDocument;
+	if(!mapDocument.load_buffer(map.data(), map.size())) return 0;
+	std::string mapFolder = mapFile.substr(0, mapFile.find_last_of("/\\") + 1);
+	for(auto const &tileset : mapDocument.child("map").children("tileset"))
+	{
+		std::string_view source = tileset.attribute("source").as_string();
+		if(source.empty()) continue;
+
+		MappedFile tilesetFile(mapFolder + std::string(source));
+		if(!tilesetFile.IsOpen()) return 0;
+		auto tilesetData = tilesetFile.GetData();
+		key = HashBytes(source.data(), source.size(), key);
+		key = HashBytes(tilesetData.data(), tilesetData.size(), key);
+	}
+
+	// Anything that changes the generated graph must be part of the key:
+	// the landmark count of the config and how tiles turn into nav data
+	int parameters[] = {
+		static_cast<int>(NAV_CACHE_VERSION), maxJump, minJump, landmarkCount, MAX_LANDMARKS,
+		TERRAIN_COST_LAYERS, BLOCKED_TERRAIN_COST, static_cast<int>(sizeof(NavLink))
+	};
+	key = HashBytes(parameters, sizeof(parameters), key);
+	for(auto const *property : TERRAIN_COST_PROPERTIES)
+		key = HashBytes(property, std::strlen(property), key);
+	return key;
+}
+
+bool Pathfinding::LoadNavCache(std::string const &path, uint64 key)
+{
+	MappedFile file(path);
+	if(!file.IsOpen()) return false;
+
+	auto data = file.GetData();
+	NavCacheHeader header;
+	if(data.size() < sizeof(header)) return false;
+	std::memcpy(&header, data.data(), sizeof(header));
+	data = data.subspan(sizeof(header));
+
+	if(header.magic != NAV_CACHE_MAGIC || header.version != NAV_CACHE_VERSION || header.key != key)
+	{
+		LOG("Nav cache %s is outdated", path.c_str());
+		return false;
+	}
+
+	auto navGrid = std::make_unique<NavGrid>();
+	navGrid->width = header.width;
+	navGrid->height = header.height;
+
+	if(!ReadCacheVector(data, navGrid->types)
+	   || !ReadCacheVector(data, navGrid->linkOffsets)
+	   || !ReadCacheVector(data, navGrid->links)
+	   || !ReadCacheVector(data, navGrid->terrainBelow)
+	   || !ReadCacheVector(data, navGrid->landmarks)
+	   || !ReadCacheVector(data, navGrid->landmarkSlot)
+	   || !ReadCacheVector(data, navGrid->distanceFromLandmark)
+	   || !ReadCacheVector(data, navGrid->distanceToLandmark)
+	   || !ReadCacheVector(data, navGrid->terrainCosts)
+	   || !IsNavCacheValid(*navGrid))
+	{
+		LOG("Nav cache %s is corrupted", path.c_str());
+		return false;
+	}
+
+	groundMap = std::move(navGrid);
+	CreateReverseLinks();
+	CreateAirOccupancy();
+	ResetTerrainCosts();
+
+	LOG("Loaded nav graph from %s", path.c_str());
+	return true;
+}
+
+bool Pathfinding::IsNavCacheValid(NavGrid const &navGrid) const
+{
+	auto tiles = static_cast<size_t>(navGrid.width) * navGrid.height;
+	if(navGrid.width <= 0 || navGrid.height <= 0 || navGrid.types.size() != tiles
+	   || navGrid.linkOffsets.size() != tiles + 1 || navGrid.terrainBelow.size() != tiles
+	   || navGrid.terrainCosts.size() != tiles * TERRAIN_COST_LAYERS
+	   || navGrid.linkOffsets.front() != 0 || static_cast<size_t>(navGrid.linkOffsets.back()) != navGrid.links.size())
+		return false;
+
+	if(!std::ranges::is_sorted(navGrid.linkOffsets)) return false;
+
+	if(std::ranges::any_of(navGrid.links, [&navGrid](NavLink const &link) { return !navGrid.IsValid(link.destination); }))
+		return false;
+
+	// Rows of the first terrain tile at or below each tile, -1 if there is none
+	int height = navGrid.height;
+	if(std::ranges::any_of(navGrid.terrainBelow, [height](int row) { return row < -1 || row >= height; }))
+		return false;
+
+	// Every tile has a slot entry, -1 if it isn't part of a link
+	if(navGrid.landmarkSlot.size() != tiles) return false;
+	auto slots = static_cast<size_t>(std::ranges::count_if(navGrid.landmarkSlot, [](int slot) { return slot >= 0; }));
+	if(!std::ranges::all_of(navGrid.landmarkSlot, [slots](int slot) { return slot >= -1 && slot < static_cast<int>(slots); }))
+		return false;
+
+	// Landmarks are tiles with a slot, and their tables have one row per slot
+	if(navGrid.landmarks.size() > static_cast<size_t>(MAX_LANDMARKS)) return false;
+	if(!std::ranges::all_of(navGrid.landmarks, [&navGrid, tiles](int tile)
+	{
+		return tile >= 0 && static_cast<size_t>(tile) < tiles && navGrid.landmarkSlot[tile] >= 0;
+	}))
+		return false;
+
+	auto tableSize = slots * navGrid.landmarks.size();
+	return navGrid.distanceFromLandmark.size() == tableSize
+		&& navGrid.distanceToLandmark.size() == tableSize;
+}
+
+bool Pathfinding::SaveNavCache(std::string const &path, uint64 key) const
+{
+	std::FILE *file = std::fopen(path.c_str(), "wb");
+	if(!file)
+	{
+		LOG("Could not create nav cache %s", path.c_str());
+		return false;
+	}
+
+	NavCacheHeader header;
+	header.key = key;
+	header.width = groundMap->width;
+	header.height = groundMap->height;
+
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+		&& WriteCacheVector(file, groundMap->types)
+		&& WriteCacheVector(file, groundMap->linkOffsets)
+		&& WriteCacheVector(file, groundMap->links)
+		&& WriteCacheVector(file, groundMap->terrainBelow)
+		&& WriteCacheVector(file, groundMap->landmarks)
+		&& WriteCacheVector(file, groundMap->landmarkSlot)
+		&& WriteCacheVector(file, groundMap->distanceFromLandmark)
+		&& WriteCacheVector(file, groundMap->distanceToLandmark)
+		&& WriteCacheVector(file, groundMap->terrainCosts);
+
+	written = (std::fclose(file) == 0) && written;
+
+	// A partial file would only be rejected on the next load, so we don't keep it
+	if(!written)
+	{
+		LOG("Could not write nav cache %s", path.c_str());
+		std::remove(path.c_str());
+	}
+
+	return written;
+}
+
+// ---------- ALT heuristic ---------
+void Pathfinding::CreateLandmarks()
+{
+	groundMap->landmarks.clear();
+	groundMap->landmarkSlot.assign(groundMap->types.size(), -1);
+	groundMap->distanceFromLandmark.clear();
+	groundMap->distanceToLandmark.clear();
+
+	// Only tiles that are part of a link get a slot
+	std::vector<int> slotTile;
+	for(int i = 0; i < std::ssize(groundMap->types); i++)
+	{
+		for(int j = groundMap->linkOffsets[i]; j < groundMap->linkOffsets[i + 1]; j++)
+		{
+			groundMap->landmarkSlot[i] = 0;
+			groundMap->landmarkSlot[groundMap->Index(groundMap->links[j].destination)] = 0;
+		}
+	}
+	for(int i = 0; i < std::ssize(groundMap->types); i++)
+	{
+		if(groundMap->landmarkSlot[i] < 0) continue;
+		groundMap->landmarkSlot[i] = static_cast<int>(slotTile.size());
+		slotTile.push_back(i);
+	}
+
+	int slots = static_cast<int>(slotTile.size());
+	int count = std::min(landmarkCount, slots);
+	if(count == 0) return;
+
+	// Forward and reverse link graphs over slots, so we can search from and to a landmark
+	std::vector<int> forwardOffsets(slots + 1, 0);
+	std::vector<int> reverseOffsets(slots + 1, 0);
+	for(int s = 0; s < slots; s++)
+	{
+		for(auto const &link : groundMap->GetLinks(groundMap->ToPoint(slotTile[s])))
+		{
+			forwardOffsets[s + 1]++;
+			reverseOffsets[groundMap->landmarkSlot[groundMap->Index(link.destination)] + 1]++;
+		}
+	}
+	std::partial_sum(forwardOffsets.begin(), forwardOffsets.end(), forwardOffsets.begin());
+	std::partial_sum(reverseOffsets.begin(), reverseOffsets.end(), reverseOffsets.begin());
+
+	std::vector<std::pair<int, int>> forwardLinks(forwardOffsets.back());
+	std::vector<std::pair<int, int>> reverseLinks(reverseOffsets.back());
+	std::vector<int> reverseFill(reverseOffsets.begin(), reverseOffsets.end() - 1);
+	for(int s = 0; s < slots; s++)
 	{
-		//LOG("Path from %s, %s to %s, %s is not valid", origin.x, origin.y, destination.x, destination.y);
-		return nullptr;
+		int forwardFill = forwardOffsets[s];
+		for(auto const &link : groundMap->GetLinks(groundMap->ToPoint(slotTile[s])))
+		{
+			int destination = groundMap->landmarkSlot[groundMap->Index(link.destination)];
+			forwardLinks[forwardFill++] = {destination, link.score};
+			reverseLinks[reverseFill[destination]++] = {s, link.score};
+		}
 	}
 
-	// Counter of iterations so we can log it
-	int iterations = 0;
+	groundMap->distanceFromLandmark.assign(static_cast<size_t>(slots) * count, INT_MAX);
+	groundMap->distanceToLandmark.assign(static_cast<size_t>(slots) * count, INT_MAX);
 
-	// openList is ordered from smallest F to highest F
-	// check overloaded operator in SearchNode
-	// It stores the nodes that have not been fully evaluated
-	std::priority_queue<SearchNode> openList;
+	// Farthest-point sampling: each landmark is the tile that is farthest from the ones
+	// we already have. Tiles that can't reach nor be reached by any landmark go first.
+	std::vector<int> separation(slots, INT_MAX);
+	std::vector<int> distances;
+	int next = 0;
+	for(int k = 0; k < count; k++)
+	{
+		groundMap->landmarks.push_back(slotTile[next]);
 
-	// The closed list will store those nodes that have been fully explored,
-	// so we can skip them later if we find them again
-	std::vector<iPoint> closedList;
+		LandmarkDijkstra(next, forwardOffsets, forwardLinks, distances);
+		for(int s = 0; s < slots; s++)
+			groundMap->distanceFromLandmark[s * count + k] = distances[s];
 
-	openList.emplace(origin, 0, HeuristicCost(origin, destination), nullptr);
+		LandmarkDijkstra(next, reverseOffsets, reverseLinks, distances);
+		for(int s = 0; s < slots; s++)
+		{
+			groundMap->distanceToLandmark[s * count + k] = distances[s];
+
+			int closest = std::min(groundMap->distanceFromLandmark[s * count + k], distances[s]);
+			separation[s] = std::min(separation[s], closest);
+		}
+
+		next = static_cast<int>(std::ranges::max_element(separation) - separation.begin());
+	}
+
+	LOG("Created %d landmarks over %d nav tiles", count, slots);
+}
+
+void Pathfinding::LandmarkDijkstra(int source, std::vector<int> const &offsets, std::vector<std::pair<int, int>> const &links, std::vector<int> &distances) const
+{
+	distances.assign(offsets.size() - 1, INT_MAX);
+	distances[source] = 0;
+
+	// <distance, slot>, smallest distance on top
+	using QueueNode = std::pair<int, int>;
+	std::priority_queue<QueueNode, std::vector<QueueNode>, std::greater<>> openList;
+	openList.emplace(0, source);
 
 	while(!openList.empty())
 	{
-		SearchNode currentNode = openList.top();
+		auto [distance, slot] = openList.top();
 		openList.pop();
+		if(distance > distances[slot]) continue;
 
-		// If we got to the goal
-		if(currentNode.position == destination)
+		for(int i = offsets[slot]; i < offsets[slot + 1]; i++)
 		{
-			// Build the path
-			auto path = std::make_unique<std::vector<iPoint>>();
-			auto node = std::make_shared<SearchNode>(currentNode);
-			while(node)
-			{
-				path->emplace_back(node->position);
-				node = node->parent;
-			}
-			// Reverse the path, as it's ordered from destination to origin
-			std::ranges::reverse(path->begin(), path->end());
+			auto [linked, score] = links[i];
+			if(distance + score >= distances[linked]) continue;
+			distances[linked] = distance + score;
+			openList.emplace(distances[linked], linked);
+		}
+	}
+}
 
-			// Log information and return the path
-			LOG("Created path of %d steps in %d iterations", path->size(), iterations);
-			return path;
+void Pathfinding::GetLandmarkDistances(int index, std::vector<int> &distances) const
+{
+	auto count = groundMap->landmarks.size();
+	distances.assign(count * 2, INT_MAX);
+
+	int slot = groundMap->landmarkSlot.empty() ? -1 : groundMap->landmarkSlot[index];
+	if(slot < 0) return;
+
+	std::copy_n(groundMap->distanceFromLandmark.begin() + slot * count, count, distances.begin());
+	std::copy_n(groundMap->distanceToLandmark.begin() + slot * count, count, distances.begin() + count);
+}
+
+int Pathfinding::LandmarkCost(int index, iPoint destination, std::vector<int> const &destinationDistances) const
+{
+	int h = HeuristicCost(groundMap->ToPoint(index), destination) * 10;
+
+	int slot = groundMap->landmarkSlot.empty() ? -1 : groundMap->landmarkSlot[index];
+	if(slot < 0) return h;
+
+	auto count = groundMap->landmarks.size();
+	int const *from = groundMap->distanceFromLandmark.data() + slot * count;
+	int const *to = groundMap->distanceToLandmark.data() + slot * count;
+	int const *destinationFrom = destinationDistances.data();
+	int const *destinationTo = destinationDistances.data() + count;
+
+	for(size_t k = 0; k < count; k++)
+	{
+		// d(n, t) >= d(L, t) - d(L, n)
+		if(from[k] != INT_MAX)
+		{
+			// L reaches n but not t, so n can't reach t either
+			if(destinationFrom[k] == INT_MAX) return UNREACHABLE_COST;
+			h = std::max(h, destinationFrom[k] - from[k]);
+		}
+		// d(n, t) >= d(n, L) - d(t, L)
+		if(destinationTo[k] != INT_MAX)
+		{
+			// t reaches L but n doesn't, so n can't reach t either
+			if(to[k] == INT_MAX) return UNREACHABLE_COST;
+			h = std::max(h, to[k] - destinationTo[k]);
 		}
+	}
+	return h;
+}
 
-		// As we are visiting the node, we add it to the closed list to skip it later
-		closedList.emplace_back(currentNode.position);
-		
-		// Get nodes that are adjacent or linked to the current node
-		std::vector<NavLink> adjacentNodes;
-		if(pTerrain == PathfindTerrain::GROUND)
+// ---------- Jump Point Search ---------
+bool Pathfinding::IsAirWalkable(int x, int y, iPoint destination) const
+{
+	if(x < 0 || y < 0 || x >= groundMap->width || y >= groundMap->height)
+		return false;
+
+	// Destination is always reachable, same as in GetAdjacentAirNodes
+	if(x == destination.x && y == destination.y) return true;
+
+	return (airBlocked[y * airRowWords + x / 64] & (1ULL << (x % 64))) == 0;
+}
+
+bool Pathfinding::JumpStraight(iPoint &current, iPoint dir, iPoint destination) const
+{
+	while(true)
+	{
+		current += dir;
+		int x = current.x;
+		int y = current.y;
+
+		if(!IsAirWalkable(x, y, destination)) return false;
+		if(current == destination) return true;
+
+		// Forced neighbours: a blocked tile at our side that opens up on the next step
+		if(dir.x != 0)
 		{
-			adjacentNodes = currentNode.GetAdjacentGroundNodes(
-				std::make_shared<SearchNode>(currentNode)
-			);
+			if((IsAirWalkable(x + dir.x, y + 1, destination) && !IsAirWalkable(x, y + 1, destination))
+			   || (IsAirWalkable(x + dir.x, y - 1, destination) && !IsAirWalkable(x, y - 1, destination)))
+				return true;
 		}
 		else
 		{
-			adjacentNodes = currentNode.GetAdjacentAirNodes(
-				std::make_shared<SearchNode>(currentNode), destination
-			);
+			if((IsAirWalkable(x + 1, y + dir.y, destination) && !IsAirWalkable(x + 1, y, destination))
+			   || (IsAirWalkable(x - 1, y + dir.y, destination) && !IsAirWalkable(x - 1, y, destination)))
+				return true;
 		}
+	}
+}
 
-		// Loop through the adjacent nodes and modify or add them to the open list if required
-		for(auto const &node : adjacentNodes)
+bool Pathfinding::Jump(iPoint &current, iPoint dir, iPoint destination) const
+{
+	if(dir.x == 0 || dir.y == 0) return JumpStraight(current, dir, destination);
+
+	while(true)
+	{
+		current += dir;
+		int x = current.x;
+		int y = current.y;
+
+		if(!IsAirWalkable(x, y, destination)) return false;
+		if(current == destination) return true;
+
+		if((IsAirWalkable(x - dir.x, y + dir.y, destination) && !IsAirWalkable(x - dir.x, y, destination))
+		   || (IsAirWalkable(x + dir.x, y - dir.y, destination) && !IsAirWalkable(x, y - dir.y, destination)))
+			return true;
+
+		// A diagonal tile is a jump point if any of its straight components finds one
+		if(iPoint horizontal = current; JumpStraight(horizontal, iPoint(dir.x, 0), destination))
+			return true;
+		if(iPoint vertical = current; JumpStraight(vertical, iPoint(0, dir.y), destination))
+			return true;
+	}
+}
+
+void Pathfinding::AddJumpPointNeighbours(iPoint position, iPoint parent, iPoint destination, std::vector<iPoint> &neighbours) const
+{
+	neighbours.clear();
+	int x = position.x;
+	int y = position.y;
+
+	// Origin node: every direction is a candidate
+	if(position == parent)
+	{
+		for(int dx = -1; dx <= 1; dx++)
+			for(int dy = -1; dy <= 1; dy++)
+				if((dx || dy) && IsAirWalkable(x + dx, y + dy, destination))
+					neighbours.emplace_back(dx, dy);
+		return;
+	}
+
+	int dx = (x > parent.x) - (x < parent.x);
+	int dy = (y > parent.y) - (y < parent.y);
+
+	// Pruned directions. Jump() discards the ones that are blocked.
+	if(dx != 0 && dy != 0)
+	{
+		neighbours.emplace_back(0, dy);
+		neighbours.emplace_back(dx, 0);
+		neighbours.emplace_back(dx, dy);
+		if(!IsAirWalkable(x - dx, y, destination)) neighbours.emplace_back(-dx, dy);
+		if(!IsAirWalkable(x, y - dy, destination)) neighbours.emplace_back(dx, -dy);
+	}
+	else if(dx != 0)
+	{
+		neighbours.emplace_back(dx, 0);
+		if(!IsAirWalkable(x, y + 1, destination)) neighbours.emplace_back(dx, 1);
+		if(!IsAirWalkable(x, y - 1, destination)) neighbours.emplace_back(dx, -1);
+	}
+	else
+	{
+		neighbours.emplace_back(0, dy);
+		if(!IsAirWalkable(x + 1, y, destination)) neighbours.emplace_back(1, dy);
+		if(!IsAirWalkable(x - 1, y, destination)) neighbours.emplace_back(-1, dy);
+	}
+}
+
+std::unique_ptr<std::vector<iPoint>> Pathfinding::JumpPointSearch(iPoint origin, iPoint destination) const
+{
+	return AStarSearch(origin, destination, PathfindTerrain::AIR);
+}
+
+// ---------- PathSearch ---------
+PathSearch::PathSearch(Pathfinding const *pathfinding) : pathfinding(pathfinding) {}
+
+void PathSearch::Start(iPoint from, iPoint to, PathfindTerrain terrain)
+{
+	origin = from;
+	destination = to;
+	pTerrain = terrain;
+	bAir = (terrain & PathfindTerrain::AIR) != PathfindTerrain::NONE;
+	expanded = 0;
+	bestIndex = -1;
+	bestH = INT_MAX;
+	foundPath.reset();
+	openList.clear();
+
+	// Check if path is valid. If it isn't there's nothing to search
+	if(!pathfinding->IsValidPosition(origin) || !pathfinding->IsValidPosition(destination))
+	{
+		status = SearchStatus::NOT_FOUND;
+		pathfinding->lastSearch = SearchStats();
+		return;
+	}
+
+	// Records are kept between searches. A new search id is enough to mark
+	// them all as unvisited, so they are only reset when the map changes.
+	width = pathfinding->GetWidth();
+	if(auto size = static_cast<size_t>(width) * pathfinding->GetHeight(); nodes.size() != size || searchId == UINT_MAX)
+	{
+		nodes.assign(size, NodeRecord());
+		searchId = 0;
+	}
+	++searchId;
+
+	// Landmark distances of the destination are the same for every node we look at.
+	// They were measured without terrain costs, which only make links more expensive,
+	// so they are still lower bounds for every mask.
+	if(!bAir)
+	{
+		pathfinding->GetLandmarkDistances(ToIndex(destination), destinationLandmarks);
+	}
+
+	status = SearchStatus::IN_PROGRESS;
+	int originIndex = ToIndex(origin);
+	// The origin is its own parent, that's where the path ends when rebuilding it
+	Push(originIndex, originIndex, 0);
+}
+
+void PathSearch::Cancel()
+{
+	status = SearchStatus::IDLE;
+	foundPath.reset();
+	openList.clear();
+}
+
+SearchStatus PathSearch::Step(int maxExpansions)
+{
+	int stepExpansions = 0;
+	while(status == SearchStatus::IN_PROGRESS && stepExpansions < maxExpansions)
+	{
+		// If the open list is empty, there is no path available
+		if(openList.empty())
 		{
-			// If node is on the closed List, we skip it
-			if(std::ranges::find(closedList, node.destination) != closedList.end())
-				continue;
+			status = SearchStatus::NOT_FOUND;
+			break;
+		}
 
-			// Add the new score to the current g
-			int cost = currentNode.g + node.score;
+		std::ranges::pop_heap(openList, std::greater<>());
+		OpenNode current = openList.back();
+		openList.pop_back();
 
-			// We'll need to know if the node is on the open list later
-			bool bNodeInOpenList = false;
+		// Stale entry, the node was already expanded with a better score
+		if(IsClosed(current.index)) continue;
+		nodes[current.index].closedId = searchId;
 
-			// Check if the node is already on the open list
-			std::priority_queue<SearchNode>tempOpen = openList;
-			while(!tempOpen.empty())
-			{
-				SearchNode nodeToCheck = tempOpen.top();
-				tempOpen.pop();
+		// Closest node to the goal so far, in case someone wants a partial path
+		if(current.h < bestH)
+		{
+			bestH = current.h;
+			bestIndex = current.index;
+		}
 
-				// If this node is not the current node, we keep looping
-				if(nodeToCheck.position != node.destination) continue;
+		// If we got to the goal
+		if(current.index == ToIndex(destination))
+		{
+			foundPath = BuildPath(current.index);
+			status = SearchStatus::FOUND;
+			LOG("Created path of %d steps in %d iterations", foundPath->size(), expanded);
+			break;
+		}
 
-				// We found the node, so we true a boolean.
-				// This is required as we won't need to add the node to the 
-				// openList when we end this loop
-				bNodeInOpenList = true;
+		if(bAir) ExpandAir(current.index);
+		else ExpandGround(current.index);
 
-				// If the cost is lower than the current one, we keep looping
-				if(nodeToCheck.g <= cost) continue;
+		++expanded;
+		++stepExpansions;
+	}
 
-				// If the cost is greater, we need to update the node
-			
-				// Remove it from the open list
-				// aka, rebuild the list without adding the node
-				std::priority_queue<SearchNode> newOpenList;
-				while(!openList.empty())
-				{
-					SearchNode aux = openList.top();
-					openList.pop();
-					if(aux.position != node.destination)
-						newOpenList.push(aux);
-				}
-				openList = newOpenList;
-
-				// Update the g of the node and the parent
-				nodeToCheck.g = cost;
-				nodeToCheck.parent = std::make_shared<SearchNode>(currentNode);
-
-				// Add the updated node to the list
-				openList.push(nodeToCheck);
-
-				// We already found our node, so we don't need to keep checking
-				break;
+	if(status != SearchStatus::IN_PROGRESS)
+	{
+		pathfinding->lastSearch = {
+			.expanded = expanded,
+			.pathLength = foundPath ? static_cast<int>(foundPath->size()) : 0
+		};
+	}
+
+	return status;
+}
+
+SearchStatus PathSearch::Run()
+{
+	return Step(INT_MAX);
+}
+
+SearchStatus PathSearch::GetStatus() const
+{
+	return status;
+}
+
+int PathSearch::GetExpanded() const
+{
+	return expanded;
+}
+
+iPoint PathSearch::GetDestination() const
+{
+	return destination;
+}
+
+std::unique_ptr<std::vector<iPoint>> PathSearch::TakePath()
+{
+	return std::move(foundPath);
+}
+
+std::unique_ptr<std::vector<iPoint>> PathSearch::GetBestPath() const
+{
+	if(bestIndex < 0) return nullptr;
+	return BuildPath(bestIndex);
+}
+
+int PathSearch::GetBestNode() const
+{
+	return bestIndex;
+}
+
+int PathSearch::ToIndex(iPoint position) const
+{
+	return position.y * width + position.x;
+}
+
+iPoint PathSearch::ToPoint(int index) const
+{
+	return {index % width, index / width};
+}
+
+bool PathSearch::IsVisited(int index) const
+{
+	return nodes[index].visitedId == searchId;
+}
+
+bool PathSearch::IsClosed(int index) const
+{
+	return nodes[index].closedId == searchId;
+}
+
+int PathSearch::Heuristic(int index) const
+{
+	if(bAir)
+		return pathfinding->OctileCost(ToPoint(index), destination);
+	return pathfinding->LandmarkCost(index, destination, destinationLandmarks);
+}
+
+void PathSearch::Push(int index, int parent, int g)
+{
+	// The landmarks tell us there is no path from this node to the destination
+	int h = Heuristic(index);
+	if(h == UNREACHABLE_COST) return;
+
+	NodeRecord &node = nodes[index];
+	node.g = g;
+	node.parent = parent;
+	node.visitedId = searchId;
+
+	// A node that gets a better score is pushed again, the old entry is skipped when popped
+	openList.push_back({g + h, h, index});
+	std::ranges::push_heap(openList, std::greater<>());
+}
+
+void PathSearch::ExpandGround(int index)
+{
+	int g = nodes[index].g;
+	// Costs are looked up on every expansion, ResetTerrainCosts may have rebuilt them since Start
+	auto terrainCosts = pathfinding->GetTerrainCosts(pTerrain);
+	// Walk and fall links are both baked by CreateWalkabilityLinks
+	for(auto const &link : pathfinding->GetNavLinks(ToPoint(index)))
+	{
+		int linkIndex = ToIndex(link.destination);
+		if(IsClosed(linkIndex) || terrainCosts[linkIndex] == BLOCKED_TERRAIN_COST) continue;
+
+		int cost = g + link.score + terrainCosts[linkIndex];
+		if(IsVisited(linkIndex) && nodes[linkIndex].g <= cost) continue;
+
+		Push(linkIndex, index, cost);
+	}
+}
+
+void PathSearch::ExpandAir(int index)
+{
+	iPoint current = ToPoint(index);
+	int g = nodes[index].g;
+
+	pathfinding->AddJumpPointNeighbours(current, ToPoint(nodes[index].parent), destination, directions);
+
+	for(auto const &dir : directions)
+	{
+		iPoint jumpPoint = current;
+		if(!pathfinding->Jump(jumpPoint, dir, destination)) continue;
+
+		int jumpIndex = ToIndex(jumpPoint);
+		if(IsClosed(jumpIndex)) continue;
+
+		int cost = g + pathfinding->OctileCost(current, jumpPoint);
+		if(IsVisited(jumpIndex) && nodes[jumpIndex].g <= cost) continue;
+
+		Push(jumpIndex, index, cost);
+	}
+}
+
+std::unique_ptr<std::vector<iPoint>> PathSearch::BuildPath(int index) const
+{
+	auto path = std::make_unique<std::vector<iPoint>>();
+	for(int i = index; ; i = nodes[i].parent)
+	{
+		iPoint to = ToPoint(i);
+		iPoint from = ToPoint(nodes[i].parent);
+
+		// Jump points are joined by straight or diagonal lines,
+		// so we fill in the tiles between them
+		if(bAir)
+		{
+			iPoint step((from.x > to.x) - (from.x < to.x), (from.y > to.y) - (from.y < to.y));
+			for(iPoint p = to; p != from; p += step)
+				path->emplace_back(p);
+		}
+		else if(to != from) path->emplace_back(to);
+
+		if(nodes[i].parent == i)
+		{
+			path->emplace_back(from);
+			break;
+		}
+	}
+	// Reverse the path, as it's ordered from destination to origin
+	std::ranges::reverse(path->begin(), path->end());
+	return path;
+}
+
+// ---------- IncrementalSearch ---------
+IncrementalSearch::IncrementalSearch(Pathfinding const *pathfinding) : pathfinding(pathfinding) {}
+
+void IncrementalSearch::Start(iPoint from, iPoint to, PathfindTerrain terrain)
+{
+	origin = from;
+	destination = to;
+	pTerrain = terrain;
+	expanded = 0;
+	keyModifier = 0;
+	openList.clear();
+
+	if(!pathfinding->IsValidPosition(origin) || !pathfinding->IsValidPosition(destination))
+	{
+		status = SearchStatus::NOT_FOUND;
+		return;
+	}
+
+	// Same as PathSearch, a new id marks every record as unvisited
+	width = pathfinding->GetWidth();
+	if(auto size = static_cast<size_t>(width) * pathfinding->GetHeight(); nodes.size() != size || searchId == UINT_MAX)
+	{
+		nodes.assign(size, NodeRecord());
+		searchId = 0;
+	}
+	++searchId;
+
+	status = SearchStatus::IN_PROGRESS;
+	int originIndex = ToIndex(origin);
+	GetRecord(originIndex).rhs = 0;
+	Open(originIndex);
+}
+
+void IncrementalSearch::Cancel()
+{
+	status = SearchStatus::IDLE;
+	openList.clear();
+}
+
+void IncrementalSearch::SetDestination(iPoint to)
+{
+	if(status == SearchStatus::IDLE || to == destination) return;
+	if(!pathfinding->IsValidPosition(to))
+	{
+		status = SearchStatus::NOT_FOUND;
+		return;
+	}
+
+	// Keys in the open list were computed with the old goal. The heuristic is a
+	// metric, so they are off by at most h(old, new): adding it to every new key
+	// keeps the old ones as lower bounds, and Step fixes them as they come up.
+	keyModifier += pathfinding->HeuristicCost(destination, to) * 10;
+	destination = to;
+	status = SearchStatus::IN_PROGRESS;
+}
+
+void IncrementalSearch::OnLinksChanged(iPoint tile)
+{
+	if(status == SearchStatus::IDLE || !pathfinding->IsValidPosition(tile)) return;
+
+	UpdateNode(ToIndex(tile));
+	for(auto const &link : pathfinding->GetNavLinks(tile))
+		UpdateNode(ToIndex(link.destination));
+
+	status = SearchStatus::IN_PROGRESS;
+}
+
+SearchStatus IncrementalSearch::Step(int maxExpansions)
+{
+	int stepExpansions = 0;
+	int goal = ToIndex(destination);
+
+	while(status == SearchStatus::IN_PROGRESS && stepExpansions < maxExpansions)
+	{
+		ClearOpenTop();
+
+		// The goal is consistent and nothing left in the open list can improve it
+		NodeRecord const &goalRecord = GetRecord(goal);
+		if(openList.empty() || (openList.front().key >= CalculateKey(goal) && goalRecord.g == goalRecord.rhs))
+		{
+			status = (goalRecord.rhs != INT_MAX) ? SearchStatus::FOUND : SearchStatus::NOT_FOUND;
+			break;
+		}
+
+		std::ranges::pop_heap(openList, std::greater<>());
+		OpenNode current = openList.back();
+		openList.pop_back();
+
+		NodeRecord &node = GetRecord(current.index);
+
+		// The key was computed for an older goal
+		if(Key newKey = CalculateKey(current.index); current.key < newKey)
+		{
+			Open(current.index);
+			continue;
+		}
+
+		node.bOpen = false;
+		iPoint position = ToPoint(current.index);
+
+		if(node.g > node.rhs)
+		{
+			// Overconsistent: the node got cheaper, which can only lower its successors
+			node.g = node.rhs;
+			for(auto const &link : pathfinding->GetNavLinks(position))
+			{
+				int linkIndex = ToIndex(link.destination);
+				int cost = LinkCost(link.score, linkIndex);
+				NodeRecord &linked = GetRecord(linkIndex);
+				if(linkIndex == ToIndex(origin) || cost == INT_MAX || node.g + cost >= linked.rhs) continue;
+				linked.rhs = node.g + cost;
+				if(linked.g != linked.rhs) Open(linkIndex);
+				else linked.bOpen = false;
 			}
+		}
+		else
+		{
+			// Underconsistent: the node got more expensive, everything that used it is checked again
+			node.g = INT_MAX;
+			UpdateNode(current.index);
+			for(auto const &link : pathfinding->GetNavLinks(position))
+				UpdateNode(ToIndex(link.destination));
+		}
 
-			// If the node was on the open list, we already updated it, so we keep looping
-			if(bNodeInOpenList) continue;
+		++expanded;
+		++stepExpansions;
+	}
 
-			// If we got to this point, the node was not in the open list nor it is the destination,
-			// so we create a new node and add it to the open list
-			openList.emplace(
-				node.destination,
-				cost,
-				HeuristicCost(node.destination, destination) * 10,
-				std::make_shared<SearchNode>(currentNode)
-			);
+	// The path is only built by GetPathFrom, so its length isn't known here
+	if(status != SearchStatus::IN_PROGRESS)
+		pathfinding->lastSearch = {.expanded = expanded};
+
+	return status;
+}
+
+SearchStatus IncrementalSearch::GetStatus() const
+{
+	return status;
+}
+
+iPoint IncrementalSearch::GetOrigin() const
+{
+	return origin;
+}
+
+iPoint IncrementalSearch::GetDestination() const
+{
+	return destination;
+}
+
+int IncrementalSearch::GetExpanded() const
+{
+	return expanded;
+}
+
+std::unique_ptr<std::vector<iPoint>> IncrementalSearch::GetPathFrom(iPoint tile) const
+{
+	if(status != SearchStatus::FOUND) return nullptr;
+
+	// Walk back from the goal through the predecessor that gives each node its g
+	auto path = std::make_unique<std::vector<iPoint>>();
+	int current = ToIndex(destination);
+	path->emplace_back(destination);
+
+	for(int steps = 0; current != ToIndex(origin) && ToPoint(current) != tile; steps++)
+	{
+		if(steps >= std::ssize(nodes)) return nullptr;
+
+		int best = -1;
+		int bestCost = INT_MAX;
+		int cost = LinkCost(0, current);
+		for(auto const &link : pathfinding->GetReverseNavLinks(ToPoint(current)))
+		{
+			int g = GetG(ToIndex(link.destination));
+			if(g == INT_MAX || cost == INT_MAX || g + link.score + cost >= bestCost) continue;
+			best = ToIndex(link.destination);
+			bestCost = g + link.score + cost;
 		}
-		++iterations;
+		if(best < 0) return nullptr;
+
+		current = best;
+		path->emplace_back(ToPoint(current));
+	}
+
+	// Tile is not on the path
+	if(ToPoint(current) != tile) return nullptr;
+
+	// Reverse the path, as it's ordered from destination to tile
+	std::ranges::reverse(path->begin(), path->end());
+	return path;
+}
+
+IncrementalSearch::NodeRecord &IncrementalSearch::GetRecord(int index)
+{
+	NodeRecord &node = nodes[index];
+	if(node.searchId != searchId)
+	{
+		node = NodeRecord();
+		node.searchId = searchId;
+	}
+	return node;
+}
+
+int IncrementalSearch::GetG(int index) const
+{
+	return (nodes[index].searchId == searchId) ? nodes[index].g : INT_MAX;
+}
+
+IncrementalSearch::Key IncrementalSearch::CalculateKey(int index) const
+{
+	NodeRecord const &node = nodes[index];
+	int g = (node.searchId == searchId) ? std::min(node.g, node.rhs) : INT_MAX;
+	if(g == INT_MAX) return {INT_MAX, INT_MAX};
+
+	return {g + pathfinding->HeuristicCost(ToPoint(index), destination) * 10 + keyModifier, g};
+}
+
+void IncrementalSearch::UpdateNode(int index)
+{
+	NodeRecord &node = GetRecord(index);
+
+	// The origin always costs 0, any other node costs its best incoming link
+	if(index != ToIndex(origin))
+	{
+		node.rhs = INT_MAX;
+		for(auto const &link : pathfinding->GetReverseNavLinks(ToPoint(index)))
+		{
+			int g = GetG(ToIndex(link.destination));
+			int cost = LinkCost(link.score, index);
+			if(g != INT_MAX && cost != INT_MAX) node.rhs = std::min(node.rhs, g + cost);
+		}
+	}
+
+	if(node.g != node.rhs) Open(index);
+	else node.bOpen = false;
+}
+
+void IncrementalSearch::Open(int index)
+{
+	NodeRecord &node = GetRecord(index);
+	node.key = CalculateKey(index);
+	node.bOpen = true;
+
+	// The old entry, if any, is left in the heap and skipped because its key doesn't match
+	openList.push_back({node.key, index});
+	std::ranges::push_heap(openList, std::greater<>());
+}
+
+void IncrementalSearch::ClearOpenTop()
+{
+	while(!openList.empty())
+	{
+		OpenNode const &top = openList.front();
+		NodeRecord const &node = nodes[top.index];
+		if(node.bOpen && node.key == top.key) return;
+
+		std::ranges::pop_heap(openList, std::greater<>());
+		openList.pop_back();
 	}
+}
+
+int IncrementalSearch::LinkCost(int score, int to) const
+{
+	auto terrainCosts = pathfinding->GetTerrainCosts(pTerrain);
+	if(terrainCosts[to] == BLOCKED_TERRAIN_COST) return INT_MAX;
+	return score + terrainCosts[to];
+}
 
-	// If we ended last while, it means there is no path available.
-	// We return an empty vector
-	return nullptr;
+int IncrementalSearch::ToIndex(iPoint position) const
+{
+	return position.y * width + position.x;
+}
+
+iPoint IncrementalSearch::ToPoint(int index) const
+{
+	return {index % width, index / width};
 }
 
 iPoint Pathfinding::GetDestinationCoordinates(iPoint position, PathfindTerrain pTerrain) const
@@ -255,8 +1473,8 @@ iPoint Pathfinding::GetDestinationCoordinates(iPoint position, PathfindTerrain p
 	position = app->map->WorldToCoordinates(position);
 	if(!IsValidPosition(position))
 	{
-		position.x = (position.x < 0) ? 2 : groundMap->size() - 2;
-		position.y = (position.y < 0) ? 2 : groundMap->at(0).size() - 2;
+		position.x = (position.x < 0) ? 2 : groundMap->width - 2;
+		position.y = (position.y < 0) ? 2 : groundMap->height - 2;
 	}
 
 	// If it's a ground enemy, we pathfind to the node
@@ -274,7 +1492,7 @@ iPoint Pathfinding::GetPatrolCoordinates(iPoint position, int dir, PathfindTerra
 
 	if(!IsValidPosition(position)) return position;
 	
-	auto type = groundMap->at(position.x)[position.y].type & (LEFT | PLATFORM | RIGHT);
+	auto type = groundMap->GetType(position) & (LEFT | PLATFORM | RIGHT);
 	auto check = NONE;
 	if(pTerrain == PathfindTerrain::GROUND)
 	{
@@ -313,8 +1531,8 @@ iPoint Pathfinding::GetPatrolMaxX(iPoint position, CL::NavType check, int patrol
 	{
 		// Check if position is valid and 
 		// if the tile at position is an ending one
-		if(std::cmp_less(position.x + i, groundMap->size()) && position.x + i >= 0 &&
-		   (groundMap->at(position.x + i)[position.y].type | check) != check)
+		if(position.x + i < groundMap->width && position.x + i >= 0 &&
+		   (groundMap->GetType({position.x + i, position.y}) | check) != check)
 			return iPoint(position.x + i - sign, position.y);
 	}
 	return iPoint(position.x + patrolRadius, position.y);
@@ -322,9 +1540,8 @@ iPoint Pathfinding::GetPatrolMaxX(iPoint position, CL::NavType check, int patrol
 
 iPoint Pathfinding::GetTerrainUnder(iPoint position) const
 {
-	for(int y = position.y; y < groundMap->at(position.x).size(); y++)
-		if(GetNavPoint({position.x, y}).type !=  CL::NavType::NONE)
-			return {position.x, y};
+	if(int y = groundMap->terrainBelow[groundMap->Index(position)]; y != -1)
+		return {position.x, y};
 
 	return position;
 }
@@ -337,27 +1554,38 @@ bool Pathfinding::PostUpdate()
 
 void Pathfinding::DrawNodeDebug() const
 {
-	for(int i = 0; i < groundMap->size(); i++)
+	DebugDraw &debugDraw = app->render->GetDebugDraw();
+
+	// Only the columns around the camera. Links only go a few tiles sideways,
+	// but falls can come from anywhere above, so every row is checked.
+	// The camera is in screen pixels: world = screen / scale
+	SDL_Rect camera = app->render->GetCamera();
+	int scale = std::max(static_cast<int>(app->win->GetScale()), 1);
+	int margin = maxJump + 1;
+	int firstColumn = std::max(0, app->map->WorldToCoordinates({-camera.x / scale, 0}).x - margin);
+	int lastColumn = std::min(groundMap->width - 1, app->map->WorldToCoordinates({(-camera.x + camera.w) / scale, 0}).x + margin);
+
+	for(int j = 0; j < groundMap->height; j++)
 	{
-		for(int j = 0; j < groundMap->at(0).size(); j++)
+		for(int i = firstColumn; i <= lastColumn; i++)
 		{
 			using enum CL::NavType;
-			auto const &tile = groundMap->at(i).at(j);
-			if(tile.type == NONE || tile.type == TERRAIN)
+			CL::NavType type = groundMap->GetType({i, j});
+			if(type == NONE || type == TERRAIN)
 				continue;
 
 			SDL_Color rgba = {0, 0, 0, 255};
-			if(tile.type == LEFT) { rgba.r = 255; rgba.g = 218; }
-			else if(tile.type == RIGHT) { rgba.r = 255; rgba.g = 143; }
-			else if(tile.type == PLATFORM) rgba.b = 255;
-			else if(tile.type == SOLO) rgba.g = 255;
+			if(type == LEFT) { rgba.r = 255; rgba.g = 218; }
+			else if(type == RIGHT) { rgba.r = 255; rgba.g = 143; }
+			else if(type == PLATFORM) rgba.b = 255;
+			else if(type == SOLO) rgba.g = 255;
 
 			iPoint pos = app->map->MapToWorld(i, j);
 			pos.x += app->map->GetTileWidth()/2;
 			pos.y += app->map->GetTileHeight();
-			app->render->DrawCircle(pos, 10, rgba);
+			debugDraw.AddCircle(pos, 10, rgba);
 
-			for(auto const &elem : tile.links)
+			for(auto const &elem : groundMap->GetLinks({i, j}))
 			{
 				using enum NavLinkType;
 				iPoint elemPos = app->map->MapToWorld(elem.destination.x, elem.destination.y);
@@ -367,7 +1595,7 @@ void Pathfinding::DrawNodeDebug() const
 				if(elem.movement == WALK) { rgba.r = 122; rgba.b = 122; }
 				if(elem.movement == FALL) { rgba.b = 122; rgba.g = 122; }
 				if(elem.movement == JUMP) { rgba.g = 122; rgba.r = 122; }
-				app->render->DrawLine(pos, elemPos, rgba);
+				debugDraw.AddLine(pos, elemPos, rgba);
 			}
 		}
 	}
@@ -375,19 +1603,28 @@ void Pathfinding::DrawNodeDebug() const
 
 bool Pathfinding::CreateWalkabilityLinks()
 {
-	for(int x = 0; x < app->map->GetWidth(); x++)
+	groundMap->links.clear();
+	groundMap->linkOffsets.assign(groundMap->types.size() + 1, 0);
+
+	// Links are stored tile by tile in row-major order,
+	// so the offsets can be filled as we go
+	for(int y = 0; y < groundMap->height; y++)
 	{
-		for(int y = 0; y < app->map->GetHeight(); y++)
+		for(int x = 0; x < groundMap->width; x++)
 		{
+			groundMap->linkOffsets[groundMap->Index({x, y})] = groundMap->links.size();
+
 			using enum CL::NavType;
+			AddWalkLinks({x, y});
+
 			CL::NavType maskFlag = NONE;
 			maskFlag = RIGHT | LEFT | SOLO;
-			if((groundMap->at(x).at(y).type & maskFlag) == NONE) continue;
+			if((groundMap->GetType({x, y}) & maskFlag) == NONE) continue;
 
 			int leftFrontier = -1;
 			int rightFrontier = 1;
 			// Tile type is not right, left or solo 
-			switch(groundMap->at(x).at(y).type)
+			switch(groundMap->GetType({x, y}))
 			{
 				case RIGHT:
 					leftFrontier = 1;
@@ -403,16 +1640,53 @@ bool Pathfinding::CreateWalkabilityLinks()
 			
 		}
 	}
+	groundMap->linkOffsets.back() = groundMap->links.size();
 	return true;
 }
 
+void Pathfinding::CreateReverseLinks()
+{
+	auto tiles = groundMap->types.size();
+	groundMap->reverseLinkOffsets.assign(tiles + 1, 0);
+	groundMap->reverseLinks.resize(groundMap->links.size());
+
+	// Count the links that end at each tile, then place them
+	for(auto const &link : groundMap->links)
+		groundMap->reverseLinkOffsets[groundMap->Index(link.destination) + 1]++;
+	std::partial_sum(groundMap->reverseLinkOffsets.begin(), groundMap->reverseLinkOffsets.end(), groundMap->reverseLinkOffsets.begin());
+
+	std::vector<int> fill(groundMap->reverseLinkOffsets.begin(), groundMap->reverseLinkOffsets.end() - 1);
+	for(int i = 0; i < tiles; i++)
+	{
+		for(int j = groundMap->linkOffsets[i]; j < groundMap->linkOffsets[i + 1]; j++)
+		{
+			NavLink const &link = groundMap->links[j];
+			groundMap->reverseLinks[fill[groundMap->Index(link.destination)]++] = NavLink(groundMap->ToPoint(i), link.score, link.movement);
+		}
+	}
+}
+
+void Pathfinding::AddWalkLinks(iPoint position)
+{
+	using enum CL::NavType;
+	CL::NavType type = groundMap->GetType(position);
+
+	iPoint right(position.x + 1, position.y);
+	if((type == LEFT || type == PLATFORM) && IsValidPosition(right) && groundMap->GetType(right) != NONE)
+		groundMap->links.emplace_back(right, 10, NavLinkType::WALK);
+
+	iPoint left(position.x - 1, position.y);
+	if((type == RIGHT || type == PLATFORM) && IsValidPosition(left) && groundMap->GetType(left) != NONE)
+		groundMap->links.emplace_back(left, 10, NavLinkType::WALK);
+}
+
 void Pathfinding::AddFallLinks(iPoint position, iPoint limit)
 {
 	for(int xToCheck = position.x + limit.x; xToCheck <= position.x + limit.y; xToCheck++)
 	{
 		if(xToCheck == position.x) continue;
 		bool found = false;
-		for(int yToCheck = position.y; !found && yToCheck < app->map->GetHeight(); yToCheck++)
+		for(int yToCheck = position.y; !found && yToCheck < groundMap->height; yToCheck++)
 		{
 			using enum CL::NavType;
 			CL::NavType nodeFlag = RIGHT | PLATFORM | SOLO | LEFT;
@@ -420,18 +1694,17 @@ void Pathfinding::AddFallLinks(iPoint position, iPoint limit)
 			// If it's a terrain tile without a linkable node or the cell is not valid.
 			// As it is not walkable, we go to next X as there will be no link in this column
 			if(!IsValidPosition({xToCheck, yToCheck}) ||
-			   (groundMap->at(xToCheck).at(yToCheck).type & TERRAIN) == TERRAIN) break;
+			   (groundMap->GetType({xToCheck, yToCheck}) & TERRAIN) == TERRAIN) break;
 
 			// If it's not a flag we are looking for we go to next tile in column
-			if((groundMap->at(xToCheck).at(yToCheck).type & nodeFlag) == NONE) continue;
+			if((groundMap->GetType({xToCheck, yToCheck}) & nodeFlag) == NONE) continue;
 
 			// Create and push the new link
-			NavLink tempNav = {
+			groundMap->links.emplace_back(
 				iPoint(xToCheck, yToCheck),
 				HeuristicCost(position, {xToCheck, yToCheck}) * 10,
 				NavLinkType::FALL
-			};
-			groundMap->at(position.x).at(position.y).links.push_back(tempNav);
+			);
 
 			found = true;
 		}
@@ -443,16 +1716,16 @@ bool Pathfinding::IsRightNode(iPoint position) const
 	auto coords = app->map->WorldToCoordinates(position);
 	coords.y -= 1;
 	if(!IsValidPosition(coords)) return false;
-	return groundMap->at(coords.x)[coords.y].type == CL::NavType::RIGHT
-		|| groundMap->at(coords.x)[coords.y].type == CL::NavType::SOLO;
+	return groundMap->GetType(coords) == CL::NavType::RIGHT
+		|| groundMap->GetType(coords) == CL::NavType::SOLO;
 }
 
 bool Pathfinding::IsLeftNode(iPoint position) const
 {
 	auto coords = app->map->WorldToCoordinates(position) - 1;
 	if(!IsValidPosition(coords)) return false;
-	return groundMap->at(coords.x)[coords.y].type == CL::NavType::LEFT
-		|| groundMap->at(coords.x)[coords.y].type == CL::NavType::SOLO;
+	return groundMap->GetType(coords) == CL::NavType::LEFT
+		|| groundMap->GetType(coords) == CL::NavType::SOLO;
 }
 
 bool Pathfinding::IsBorderNode(iPoint position) const
@@ -460,7 +1733,6 @@ bool Pathfinding::IsBorderNode(iPoint position) const
 	using enum CL::NavType;
 	auto coords = app->map->WorldToCoordinates(position);
 	if(!IsValidPosition(coords)) return false;
-	return groundMap->at(coords.x)[coords.y].type == LEFT
-		|| groundMap->at(coords.x)[coords.y].type == SOLO
-		|| groundMap->at(coords.x)[coords.y].type == RIGHT;
+	CL::NavType type = groundMap->GetType(coords);
+	return type == LEFT || type == SOLO || type == RIGHT;
 }
\ No newline at end of file
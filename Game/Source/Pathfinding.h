@@ -4,12 +4,22 @@
 #include "Module.h"
 #include "Map.h"
 
+#include "Defs.h"
 #include "Point.h"
 #include <memory>
+#include <climits>
+#include <string>
+#include <string_view>
 #include <vector>
-#include <queue>
+#include <span>
+#include <array>
+#include <utility>
 
 
+// Heuristic value of a node that can't reach the destination
+constexpr int UNREACHABLE_COST = INT_MAX;
+constexpr int MAX_LANDMARKS = 16;
+
 enum class PathfindTerrain
 {
 	NONE = 0x0000,
@@ -19,38 +29,40 @@ enum class PathfindTerrain
 	LAVA = 0x0008
 };
 
-struct SearchNode
+inline PathfindTerrain operator|(PathfindTerrain a, PathfindTerrain b)
 {
-	SearchNode() = default;
-	SearchNode(iPoint p, int score, int dist, std::shared_ptr<SearchNode>node)
-		: position(p), g(score), h(dist), parent(node) {}
-
-	iPoint position;
-	// Cost to reach node
-	int g;
-	// Estimated cost to reach the goal
-	int h;
+	return static_cast<PathfindTerrain>(static_cast<int>(a) | static_cast<int>(b));
+}
 
-	// Pointer to parent node
-	std::shared_ptr<SearchNode> parent;
-
-	std::vector<NavLink> GetAdjacentGroundNodes(std::shared_ptr<SearchNode> searchNode) const;
-	std::vector<NavLink> GetAdjacentAirNodes(std::shared_ptr<SearchNode> searchNode, iPoint destination) const;
+inline PathfindTerrain operator&(PathfindTerrain a, PathfindTerrain b)
+{
+	return static_cast<PathfindTerrain>(static_cast<int>(a) & static_cast<int>(b));
+}
 
-	bool IsWalkable(iPoint p) const;
-	
-	bool operator<(const SearchNode &right) const
-	{
-		return (g + h) > (right.g + right.h);
-	}
+// Terrain of each cost layer of the nav grid, in the order of TERRAIN_COST_PROPERTIES
+constexpr std::array<PathfindTerrain, TERRAIN_COST_LAYERS> TERRAIN_COST_TYPES = {
+	PathfindTerrain::GROUND, PathfindTerrain::WATER, PathfindTerrain::LAVA
+};
 
+// Counters of the last search, for debugging and benchmarking
+struct SearchStats
+{
+	int expanded = 0;
+	int pathLength = 0;
 };
 
 class Pathfinding : public Module
 {
 public:
+	Pathfinding();
+
+	bool Awake(pugi::xml_node &config) override;
+
 	// ------ Algorithms
 	std::unique_ptr<std::vector<iPoint>> AStarSearch(iPoint origin, iPoint destination, PathfindTerrain pTerrain = PathfindTerrain::GROUND) const;
+	// Air only. Same grid and 10/14 costs as AStarSearch, but it only
+	// pushes jump points to the open list.
+	std::unique_ptr<std::vector<iPoint>> JumpPointSearch(iPoint origin, iPoint destination) const;
 
 	iPoint GetDestinationCoordinates(iPoint position, PathfindTerrain pTerrain) const;
 
@@ -64,24 +76,273 @@ public:
 	// ------ Utils
 	// --- Set maps
 	bool SetWalkabilityMap();
+	bool SetWalkabilityMap(std::unique_ptr<NavGrid> navGrid);
 	// --- Get information
 	bool IsValidPosition(iPoint position) const;
-	NavPoint &GetNavPoint(iPoint position) const;
+	CL::NavType GetNavType(iPoint position) const;
+	std::span<const NavLink> GetNavLinks(iPoint position) const;
+	// Links that end at position, their destination is the tile they come from
+	std::span<const NavLink> GetReverseNavLinks(iPoint position) const;
 	bool IsRightNode(iPoint position) const;
 	bool IsLeftNode(iPoint position) const;
 
 	bool IsBorderNode(iPoint position) const;
+	// Solid tile, one that air units go around. False outside the map.
+	bool IsTileBlocked(iPoint position) const;
+	// Walks the tiles crossed by the segment, from and to in tile units.
+	// True if it enters a blocked tile, with the fraction of the segment where it does.
+	bool SegmentCast(fPoint from, fPoint to, float &fraction, iPoint &hitTile) const;
+	// SegmentCast for many segments at once, without the hit. visible[i] is 1 if
+	// segment i doesn't enter a blocked tile. It walks eight at a time with AVX2.
+	void LineOfSight(std::span<const fPoint> from, std::span<const fPoint> to, std::span<uchar> visible) const;
+
+	int GetWidth() const;
+	int GetHeight() const;
+	SearchStats const &GetLastSearchStats() const;
+	// Max nodes a time-sliced search may expand each frame
+	int GetExpansionsPerFrame() const;
+	// Landmarks of the ALT heuristic. Takes effect on the next SetWalkabilityMap.
+	void SetLandmarkCount(int count);
+	// Ground enemies chasing the player replan with an IncrementalSearch
+	bool IsIncrementalChaseEnabled() const;
+	// Extra cost of a link that ends at each tile, for an agent that can move through
+	// every terrain in mask: the cheapest of their cost layers. Built on first use,
+	// ResetTerrainCosts drops it, so don't keep the span past the current call.
+	std::span<const uchar> GetTerrainCosts(PathfindTerrain mask) const;
+	// Changes the cost of tile in one cost layer and returns the one it had.
+	// BLOCKED_TERRAIN_COST closes the tile. Searches see it right away, an
+	// IncrementalSearch that is running has to be told with OnLinksChanged.
+	// The landmark bounds stay valid as long as costs only go up.
+	uchar SetTerrainCost(iPoint tile, int layer, uchar cost);
+	// Comma separated terrain names, as in "Ground,Water"
+	static PathfindTerrain ParseTerrainMask(std::string_view names);
 
 private:
+	friend class PathSearch;
+	friend class IncrementalSearch;
+
 	iPoint GetTerrainUnder(iPoint position) const;
 	void DrawNodeDebug() const;
 	bool CreateWalkabilityLinks();
+	void CreateReverseLinks();
+	void AddWalkLinks(iPoint position);
 	void AddFallLinks(iPoint position, iPoint limit);
+	void CreateTerrainBelow();
+	// Drops the cost grids of the previous map
+	void ResetTerrainCosts();
 	int HeuristicCost(iPoint origin, iPoint destination) const;
+	int OctileCost(iPoint origin, iPoint destination) const;
+
+	// ------ Nav graph cache
+	// Hash of the map file and of every parameter used to build the graph. 0 if the map can't be read.
+	uint64 GetNavCacheKey(std::string const &mapFile) const;
+	bool LoadNavCache(std::string const &path, uint64 key);
+	bool IsNavCacheValid(NavGrid const &navGrid) const;
+	bool SaveNavCache(std::string const &path, uint64 key) const;
+
+	// ------ ALT heuristic
+	void CreateLandmarks();
+	void LandmarkDijkstra(int source, std::vector<int> const &offsets, std::vector<std::pair<int, int>> const &links, std::vector<int> &distances) const;
+	// Distances from every landmark to tile index, followed by the ones from the tile to every landmark
+	void GetLandmarkDistances(int index, std::vector<int> &distances) const;
+	// Ground heuristic: the best of Manhattan and the landmark bounds.
+	// UNREACHABLE_COST if the landmarks prove there is no path.
+	int LandmarkCost(int index, iPoint destination, std::vector<int> const &destinationDistances) const;
+
+	// ------ Jump Point Search
+	void CreateAirOccupancy();
+	bool IsAirWalkable(int x, int y, iPoint destination) const;
+	bool JumpStraight(iPoint &current, iPoint dir, iPoint destination) const;
+	bool Jump(iPoint &current, iPoint dir, iPoint destination) const;
+	void AddJumpPointNeighbours(iPoint position, iPoint parent, iPoint destination, std::vector<iPoint> &neighbours) const;
 
 	int maxJump = 1;
 	int minJump = 1;
-	std::unique_ptr<navPointMatrix> groundMap;
+	std::unique_ptr<NavGrid> groundMap;
+
+	mutable SearchStats lastSearch;
+
+	int expansionsPerFrame = 256;
+	int landmarkCount = 12;
+	bool incrementalChase = true;
+
+	// Combined cost grids, indexed by the cost layers of the mask
+	mutable std::array<std::vector<uchar>, 1 << TERRAIN_COST_LAYERS> terrainMaskCosts;
+
+	// One bit per tile, set if an air unit can't go through it.
+	// Rows are airRowWords long, bit x of row y is the tile (x, y).
+	std::vector<uint64> airBlocked;
+	int airRowWords = 0;
+};
+
+enum class SearchStatus
+{
+	IDLE,
+	IN_PROGRESS,
+	FOUND,
+	NOT_FOUND
+};
+
+// A* that can be stopped after a number of expansions and resumed later.
+// Its open list and node records live between calls to Step, so a long
+// search can be spread over several frames.
+// Ground searches follow the nav links, air searches use jump points.
+class PathSearch
+{
+public:
+	explicit PathSearch(Pathfinding const *pathfinding);
+
+	// Drops the previous search, if any, and pushes the origin.
+	// terrain is the mask of the agent: any search with AIR in it uses jump points,
+	// the others follow the ground links with the costs of their terrains.
+	void Start(iPoint from, iPoint to, PathfindTerrain terrain);
+	void Cancel();
+	// Expands at most maxExpansions nodes
+	SearchStatus Step(int maxExpansions);
+	// Expands until the search ends
+	SearchStatus Run();
+
+	SearchStatus GetStatus() const;
+	int GetExpanded() const;
+	iPoint GetDestination() const;
+
+	// Full path once the status is FOUND. nullptr otherwise or if it was already taken.
+	std::unique_ptr<std::vector<iPoint>> TakePath();
+	// Path to the expanded node that is closest to the destination
+	std::unique_ptr<std::vector<iPoint>> GetBestPath() const;
+	// Index of that node, -1 before the first expansion
+	int GetBestNode() const;
+
+private:
+	struct NodeRecord
+	{
+		int g = 0;
+		int parent = -1;
+		// Id of the search that last touched the node
+		uint visitedId = 0;
+		uint closedId = 0;
+	};
+
+	struct OpenNode
+	{
+		int f = 0;
+		// Ties on f are broken by the node closest to the goal
+		int h = 0;
+		int index = 0;
+		auto operator<=>(OpenNode const &) const = default;
+	};
+
+	int ToIndex(iPoint position) const;
+	iPoint ToPoint(int index) const;
+	bool IsVisited(int index) const;
+	bool IsClosed(int index) const;
+	int Heuristic(int index) const;
+	void Push(int index, int parent, int g);
+	void ExpandGround(int index);
+	void ExpandAir(int index);
+	std::unique_ptr<std::vector<iPoint>> BuildPath(int index) const;
+
+	Pathfinding const *pathfinding = nullptr;
+
+	iPoint origin;
+	iPoint destination;
+	PathfindTerrain pTerrain = PathfindTerrain::GROUND;
+	bool bAir = false;
+	SearchStatus status = SearchStatus::IDLE;
+
+	int width = 0;
+	int expanded = 0;
+	int bestIndex = -1;
+	int bestH = INT_MAX;
+	uint searchId = 0;
+
+	// One record per tile, reused by every search
+	std::vector<NodeRecord> nodes;
+	// Binary heap, smallest f on top
+	std::vector<OpenNode> openList;
+	std::vector<iPoint> directions;
+	std::vector<int> destinationLandmarks;
+	std::unique_ptr<std::vector<iPoint>> foundPath;
+};
+
+// Lifelong Planning A* over the ground links, rooted at a fixed origin.
+// g values only depend on the origin, so when the goal moves they are all kept
+// and the keys already in the open list are fixed with D* Lite's key modifier.
+// Replanning after the goal moves a tile, or after some links change, only
+// expands the nodes around the change.
+class IncrementalSearch
+{
+public:
+	explicit IncrementalSearch(Pathfinding const *pathfinding);
+
+	// Drops every previous value and searches from origin
+	void Start(iPoint from, iPoint to, PathfindTerrain terrain = PathfindTerrain::GROUND);
+	void Cancel();
+	// Moves the goal. Everything already searched is kept.
+	void SetDestination(iPoint to);
+	// The links that start or end at tile changed their cost
+	void OnLinksChanged(iPoint tile);
+	// Expands at most maxExpansions nodes
+	SearchStatus Step(int maxExpansions);
+
+	SearchStatus GetStatus() const;
+	iPoint GetOrigin() const;
+	iPoint GetDestination() const;
+	// Nodes expanded since the last Start
+	int GetExpanded() const;
+
+	// Part of the shortest path that goes from tile to the destination.
+	// nullptr if there is no path or tile is not on it.
+	std::unique_ptr<std::vector<iPoint>> GetPathFrom(iPoint tile) const;
+
+private:
+	using Key = std::pair<int, int>;
+
+	struct NodeRecord
+	{
+		int g = INT_MAX;
+		int rhs = INT_MAX;
+		Key key = {INT_MAX, INT_MAX};
+		bool bOpen = false;
+		// Id of the search that last touched the node
+		uint searchId = 0;
+	};
+
+	struct OpenNode
+	{
+		Key key;
+		int index = 0;
+		auto operator<=>(OpenNode const &) const = default;
+	};
+
+	NodeRecord &GetRecord(int index);
+	int GetG(int index) const;
+	Key CalculateKey(int index) const;
+	void UpdateNode(int index);
+	void Open(int index);
+	void ClearOpenTop();
+	// Score of a link plus the terrain cost of the tile it ends at. INT_MAX if the tile is blocked.
+	int LinkCost(int score, int to) const;
+
+	int ToIndex(iPoint position) const;
+	iPoint ToPoint(int index) const;
+
+	Pathfinding const *pathfinding = nullptr;
+
+	iPoint origin;
+	iPoint destination;
+	PathfindTerrain pTerrain = PathfindTerrain::GROUND;
+	SearchStatus status = SearchStatus::IDLE;
+
+	int width = 0;
+	int expanded = 0;
+	// Sum of the heuristic between every goal and the next one
+	int keyModifier = 0;
+	uint searchId = 0;
+
+	std::vector<NodeRecord> nodes;
+	// Binary heap, smallest key on top. Entries whose key is not the node's key are stale.
+	std::vector<OpenNode> openList;
 };
 
 #endif //__PATHFINDING_H_
\ No newline at end of file
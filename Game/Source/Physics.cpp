@@ -3,7 +3,9 @@
 #include "Input.h"
 #include "Window.h"
 #include "Player.h"
+#include "ProjectileManager.h"
 #include "Render.h"
+#include "FrameBudget.h"
 
 #include "Defs.h"
 #include "Log.h"
@@ -12,6 +14,13 @@
 
 #include <variant>
 #include <memory>
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <numeric>
 
 #include "Box2D/Box2D/Box2D.h"
 #include "SDL/include/SDL_keycode.h"
@@ -26,6 +35,25 @@ Physics::~Physics() = default;
 
 //--------------- 
 
+bool Physics::Awake(pugi::xml_node &config)
+{
+	if(auto rate = config.child("timestep").attribute("hz").as_int(); rate > 0)
+		fixedStep = 1.0f / static_cast<float>(rate);
+
+	maxStepsPerFrame = std::max(1, config.child("timestep").attribute("maxsteps").as_int(maxStepsPerFrame));
+	velocityIterations = std::max(1, config.child("iterations").attribute("velocity").as_int(velocityIterations));
+	positionIterations = std::max(1, config.child("iterations").attribute("position").as_int(positionIterations));
+
+	profileWindow = std::max(1, config.child("profile").attribute("window").as_int(profileWindow));
+	profilePath = config.child("profile").attribute("csv").as_string(profilePath.c_str());
+	profileHistory.assign(profileWindow, PhysicsStepStats());
+	statValues.reserve(profileWindow);
+
+	bThreaded = config.child("thread").attribute("enabled").as_bool(false);
+
+	return true;
+}
+
 bool Physics::Start()
 {
 	LOG("Creating Physics 2D environment");
@@ -35,16 +63,39 @@ bool Physics::Start()
 
 	// Set this module as a listener for contacts
 	world->SetContactListener(this);
+	world->SetContactFilter(this);
+
+	// Platforms never move, so they don't need contacts between them
+	IgnoreLayerPair(CL::ColliderLayers::PLATFORMS, CL::ColliderLayers::PLATFORMS);
+	collisionEvents.reserve(512);
 
 	//Setting up so we can use joints
 	b2BodyDef bd;
 	ground = world->CreateBody(&bd);
 
+	if(bThreaded)
+	{
+		LOG("Stepping physics on its own thread");
+		physicsThread = std::thread(&Physics::PhysicsThreadLoop, this);
+	}
+
 	return true;
 }
 
 bool Physics::PreUpdate()
 {
+	if (bThreaded) SyncThreadedStep();
+
+	// Fewer iterations while frames go over budget.
+	// The world is idle here, so the physics thread never sees them change mid-step.
+	stepVelocityIterations = velocityIterations;
+	stepPositionIterations = positionIterations;
+	if (app->budget->IsDegraded(BudgetStep::PHYSICS_ITERATIONS))
+	{
+		stepVelocityIterations = std::min(velocityIterations, app->budget->GetVelocityIterations());
+		stepPositionIterations = std::min(positionIterations, app->budget->GetPositionIterations());
+	}
+
 	using enum KeyState;
 	float newGrav = b2_maxFloat;
 	for (uint keyIterator = SDL_SCANCODE_1; keyIterator <= SDL_SCANCODE_0; keyIterator++)
@@ -71,14 +122,120 @@ bool Physics::PreUpdate()
 	}
 
 	// Step (update) the World
-	if (stepActive || (!stepActive && app->input->GetKey(SDL_SCANCODE_B) == KEY_DOWN))
-		world->Step(1.0f / 60.0f, 6, 2);
+	if (stepActive)
+		accumulator = std::min(accumulator + app->GetDt(), fixedStep * static_cast<float>(maxStepsPerFrame));
+	// While stopped, B advances a single step
+	else if (app->input->GetKey(SDL_SCANCODE_B) == KEY_DOWN)
+		accumulator = fixedStep;
+
+	// The physics thread gets the steps when PostUpdate is done with the world
+	if (bThreaded)
+	{
+		pendingSteps = static_cast<int>(accumulator / fixedStep);
+		accumulator -= static_cast<float>(pendingSteps) * fixedStep;
+	}
+	else StepWorld();
 
 	if (app->input->GetKey(SDL_SCANCODE_N) == KEY_DOWN) ToggleStep();
 
 	return true;
 }
 
+void Physics::StepWorld()
+{
+	while (accumulator >= fixedStep)
+	{
+		SavePreviousTransforms();
+		RunStep();
+		DispatchCollisionEvents();
+		app->projectiles->StepSwept(fixedStep);
+
+		accumulator -= fixedStep;
+	}
+	SaveSnapshot();
+}
+
+void Physics::RunStep()
+{
+	stepCallbacks = 0;
+	for (auto *controller : controllers)
+		controller->BeginStep();
+
+	bStepping = true;
+	world->Step(fixedStep, stepVelocityIterations, stepPositionIterations);
+	bStepping = false;
+
+	if (collisionGrid)
+	{
+		for (auto *controller : controllers)
+			controller->EndStep(*collisionGrid);
+	}
+
+	// The overlay reads the history while the physics thread steps
+	if (bThreaded) threadedStats.push_back(MeasureStep());
+	else RecordStepStats(MeasureStep());
+}
+
+void Physics::SavePreviousTransforms()
+{
+	previousTransforms.clear();
+	for (b2Body *b = world->GetBodyList(); b; b = b->GetNext())
+	{
+		if (b->GetType() == b2_staticBody || !b->IsActive()) continue;
+		if (auto *pBody = static_cast<PhysBody *>(b->GetUserData()); pBody)
+			previousTransforms.emplace_back(pBody, b->GetPosition());
+	}
+}
+
+void Physics::SaveSnapshot()
+{
+	// Only the last step is interpolated, however many ran this frame
+	for (auto const &[pBody, position] : previousTransforms)
+		pBody->previousPosition = position;
+	previousTransforms.clear();
+
+	for (b2Body *b = world->GetBodyList(); b; b = b->GetNext())
+	{
+		if (b->GetType() == b2_staticBody || !b->IsActive()) continue;
+		if (auto *pBody = static_cast<PhysBody *>(b->GetUserData()); pBody)
+		{
+			pBody->snapshotPosition = b->GetPosition();
+			pBody->snapshotVelocity = b->GetLinearVelocity();
+		}
+	}
+}
+
+PhysicsStepStats Physics::MeasureStep() const
+{
+	PhysicsStepStats stats;
+	stats.profile = world->GetProfile();
+	stats.bodies = world->GetBodyCount();
+	stats.contacts = world->GetContactCount();
+	stats.callbacks = stepCallbacks;
+	stats.events = static_cast<int>(collisionEvents.size());
+
+	stats.awakeBodies = 0;
+	for (b2Body const *b = world->GetBodyList(); b; b = b->GetNext())
+	{
+		if (b->GetType() != b2_staticBody && b->IsActive() && b->IsAwake()) stats.awakeBodies++;
+	}
+
+	stats.touchingContacts = 0;
+	for (b2Contact const *c = world->GetContactList(); c; c = c->GetNext())
+	{
+		if (c->IsTouching()) stats.touchingContacts++;
+	}
+
+	return stats;
+}
+
+void Physics::RecordStepStats(PhysicsStepStats const &stats)
+{
+	profileHistory[profileHead] = stats;
+	profileHead = (profileHead + 1) % profileWindow;
+	profileCount = std::min(profileCount + 1, profileWindow);
+}
+
 bool Physics::PostUpdate()
 {
 	// Activate or deactivate debug mode
@@ -88,7 +245,20 @@ bool Physics::PostUpdate()
 	if (app->input->GetKey(SDL_SCANCODE_F2) == KeyState::KEY_DOWN)
 		debugWhileSelected = !debugWhileSelected;
 
-	if (!debug) return true;
+	if (app->input->GetKey(SDL_SCANCODE_F7) == KeyState::KEY_DOWN && DumpProfileCSV(profilePath))
+		LOG("Physics profile of the last %d steps saved to %s", profileCount, profilePath.c_str());
+
+	if (IsDebugActive()) DrawWorldDebug();
+
+	// The world is left to the physics thread until the next PreUpdate
+	if (bThreaded && pendingSteps > 0) LaunchStep();
+
+	return true;
+}
+
+void Physics::DrawWorldDebug()
+{
+	DebugDraw &debugDraw = app->render->GetDebugDraw();
 
 	//  Iterate all objects in the world and draw the bodies until
 	//  there are no more bodies OR
@@ -107,33 +277,33 @@ bool Physics::PostUpdate()
 				// Draw circles ------------------------------------------------
 				case b2Shape::Type::e_circle:
 				{
-					auto const *circleShape = dynamic_cast<b2CircleShape *>(f->GetShape());
-					b2Vec2 pos = f->GetBody()->GetPosition() + circleShape->m_p;
-					app->render->DrawCircle(METERS_TO_PIXELS(pos), METERS_TO_PIXELS(circleShape->m_radius), SDL_Color(255,255,255,255));
+					auto const *circleShape = static_cast<b2CircleShape const *>(f->GetShape());
+					b2Vec2 pos = b->GetWorldPoint(circleShape->m_p);
+					debugDraw.AddCircle(METERS_TO_PIXELS(pos), METERS_TO_PIXELS(circleShape->m_radius), SDL_Color(255,255,255,255));
 					break;
 				}
 				// Draw polygons ------------------------------------------------
 				case b2Shape::Type::e_polygon:
 				{
-					auto const *itemToDraw = dynamic_cast<b2PolygonShape *>(f->GetShape());
+					auto const *itemToDraw = static_cast<b2PolygonShape const *>(f->GetShape());
 					DrawDebug(b, itemToDraw->m_count, itemToDraw->m_vertices, SDL_Color(255, 255, 0, 255));
 					break;
 				}
 				// Draw chains contour -------------------------------------------
 				case b2Shape::Type::e_chain:
 				{
-					auto const *itemToDraw = dynamic_cast<b2ChainShape *>(f->GetShape());
+					auto const *itemToDraw = static_cast<b2ChainShape const *>(f->GetShape());
 					DrawDebug(b, itemToDraw->m_count, itemToDraw->m_vertices, SDL_Color(100, 255, 100, 255));
 					break;
 				}
 				// Draw a single segment(edge) ----------------------------------
 				case b2Shape::Type::e_edge:
 				{
-					auto const *edgeShape = dynamic_cast<b2EdgeShape *>(f->GetShape());
-					b2Vec2 v1 = b->GetWorldPoint(edgeShape->m_vertex0);
-					b2Vec2 v2 = b->GetWorldPoint(edgeShape->m_vertex1);
+					auto const *edgeShape = static_cast<b2EdgeShape const *>(f->GetShape());
+					b2Vec2 v1 = b->GetWorldPoint(edgeShape->m_vertex1);
+					b2Vec2 v2 = b->GetWorldPoint(edgeShape->m_vertex2);
 
-					app->render->DrawLine(METERS_TO_PIXELS(v1), METERS_TO_PIXELS(v2), SDL_Color(100, 100, 255, 255));
+					debugDraw.AddLine(METERS_TO_PIXELS(v1), METERS_TO_PIXELS(v2), SDL_Color(100, 100, 255, 255));
 					break;
 				}
 				case b2Shape::Type::e_typeCount:
@@ -146,8 +316,6 @@ bool Physics::PostUpdate()
 	}
 
 	if (selected) DragSelectedObject();
-
-	return true;
 }
 
 
@@ -157,7 +325,23 @@ bool Physics::CleanUp()
 {
 	LOG("Destroying physics world");
 
+	if(physicsThread.joinable())
+	{
+		{
+			std::scoped_lock lock(stepMutex);
+			bQuitThread = true;
+		}
+		stepCondition.notify_all();
+		physicsThread.join();
+	}
+	bodyCommands.clear();
+
 	world.reset();
+	contactPairs.Clear();
+	collisionEvents.clear();
+	controllers.clear();
+	previousTransforms.clear();
+	collisionGrid = nullptr;
 	
 	return true;
 }
@@ -167,98 +351,69 @@ bool Physics::CleanUp()
 
 void Physics::BeginContact(b2Contact *contact)
 {
+	stepCallbacks++;
+
 	// our custom PhysBody classes
 	auto pBodyA = static_cast<PhysBody *>(contact->GetFixtureA()->GetBody()->GetUserData());
 	auto pBodyB = static_cast<PhysBody *>(contact->GetFixtureB()->GetBody()->GetUserData());
 
-	if((pBodyA->ctype & pBodyB->ctype) == CL::ColliderLayers::PLATFORMS)
+	if(!pBodyA || !pBodyB) return;
+
+	// Only the first contact between two bodies starts their collision
+	if(contactPairs.Add(pBodyA->body, pBodyB->body) > 1)
 	{
 		contact->SetEnabled(false);
 		return;
 	}
 
-	if(pBodyA && pBodyB)
-	{	
-		if(auto [i, success] = collisionMap[pBodyA->body].insert(pBodyB->body);
-		   success)
-		{
-			collisionMap[pBodyB->body].insert(pBodyA->body);
-			auto fA = contact->GetFixtureA();
-			auto fB = contact->GetFixtureB();
-
-			if(pBodyA->listener) pBodyA->listener->BeforeCollisionStart(fA, fB, pBodyA, pBodyB);
-			else if(pBodyA->pListener) pBodyA->pListener->BeforeCollisionStart(fA, fB, pBodyA, pBodyB);
-			if(pBodyB->listener) pBodyB->listener->BeforeCollisionStart(fB, fA, pBodyB, pBodyA);
-			else if(pBodyB->pListener) pBodyB->pListener->BeforeCollisionStart(fB, fA, pBodyB, pBodyA);
-		}
-		else contact->SetEnabled(false);
-	}
+	RecordCollisionEvent({
+		.type = CollisionEventType::BEFORE_START,
+		.fixtureA = contact->GetFixtureA(),
+		.fixtureB = contact->GetFixtureB(),
+		.bodyA = pBodyA,
+		.bodyB = pBodyB
+	});
 }
 
 void Physics::EndContact(b2Contact *contact)
 {
+	stepCallbacks++;
+
 	// our custom PhysBody classes
 	auto pBodyA = static_cast<PhysBody *>(contact->GetFixtureA()->GetBody()->GetUserData());
 	auto pBodyB = static_cast<PhysBody *>(contact->GetFixtureB()->GetBody()->GetUserData());
 
-	if(pBodyA && pBodyB)
-	{
-		auto itA = pBodyA->body->GetContactList();
-		auto itB = pBodyB->body->GetContactList();
-		
-		while(itA && itB)
-		{
-			// if the current iterator contact is not the contact we are ending 
-			// AND the contact is not touching
-			// AND the other body of the current iterator contact is the same
-			// as the one we are ending contact right now we don't end the collision
-			if((itA->contact->IsTouching() && itA->other->GetUserData() == pBodyB) ||
-			   (itB->contact->IsTouching() && itB->other->GetUserData() == pBodyA))
-			{
-				return;
-			}
-			itA = itA->next;
-			itB = itB->next;
-		}
-		
-		// if we got here, it means there are no more contacts in the list
-		// we erase the bodies of our custom collisionSet and collisionMap
-		// and, if there is a listener, send the OnCollisionEnd function
-		if(auto i = collisionMap.find(pBodyA->body); i != collisionMap.end())
-		{
-			i->second.erase(pBodyB->body);
-			if(collisionMap.at(pBodyA->body).empty()) collisionMap.erase(i);
-			if(pBodyA->listener) pBodyA->listener->OnCollisionEnd(pBodyA, pBodyB);
-			else if(pBodyA->pListener) pBodyA->pListener->OnCollisionEnd(pBodyA, pBodyB);
-		}
-		
-		if(auto i = collisionMap.find(pBodyB->body); i != collisionMap.end())
-		{
-			i->second.erase(pBodyA->body);
-			if(collisionMap.at(pBodyB->body).empty()) collisionMap.erase(i);
-			if(pBodyB->listener) pBodyB->listener->OnCollisionEnd(pBodyB, pBodyA);
-			else if(pBodyB->pListener) pBodyB->pListener->OnCollisionEnd(pBodyB, pBodyA);
-		}
-	}
+	if(!pBodyA || !pBodyB) return;
+
+	// The collision only ends when the last contact between both bodies does
+	if(contactPairs.Remove(pBodyA->body, pBodyB->body) != 0) return;
+
+	RecordCollisionEvent({
+		.type = CollisionEventType::END,
+		.fixtureA = contact->GetFixtureA(),
+		.fixtureB = contact->GetFixtureB(),
+		.bodyA = pBodyA,
+		.bodyB = pBodyB
+	});
 }
 
 void Physics::PreSolve(b2Contact *contact, const b2Manifold *oldManifold)
 {
-	b2WorldManifold worldManifold;
-	contact->GetWorldManifold(&worldManifold);
+	stepCallbacks++;
+
 	// our custom PhysBody classes
 	auto pBodyA = static_cast<PhysBody *>(contact->GetFixtureA()->GetBody()->GetUserData());
 	auto pBodyB = static_cast<PhysBody *>(contact->GetFixtureB()->GetBody()->GetUserData());
 
 	if(pBodyA && pBodyB)
 	{
-		auto fA = contact->GetFixtureA();
-		auto fB = contact->GetFixtureB();
-
-		if(pBodyA->listener) pBodyA->listener->OnCollisionStart(fA, fB,pBodyA, pBodyB);
-		else if(pBodyA->pListener) pBodyA->pListener->OnCollisionStart(fA, fB, pBodyA, pBodyB);
-		if(pBodyB->listener) pBodyB->listener->OnCollisionStart(fB, fA, pBodyB, pBodyA);
-		else if(pBodyB->pListener) pBodyB->pListener->OnCollisionStart(fB, fA, pBodyB, pBodyA);
+		RecordCollisionEvent({
+			.type = CollisionEventType::START,
+			.fixtureA = contact->GetFixtureA(),
+			.fixtureB = contact->GetFixtureB(),
+			.bodyA = pBodyA,
+			.bodyB = pBodyB
+		});
 	}
 	/*
 	auto bodyA = contact->GetFixtureA()->GetBody();
@@ -290,13 +445,118 @@ void Physics::PreSolve(b2Contact *contact, const b2Manifold *oldManifold)
 
 void Physics::PostSolve(b2Contact *contact, const b2ContactImpulse *impulse)
 {
-	
+	stepCallbacks++;
+}
+
+bool Physics::ShouldCollide(b2Fixture *fixtureA, b2Fixture *fixtureB)
+{
+	stepCallbacks++;
+
+	// Category and mask bits
+	if(!b2ContactFilter::ShouldCollide(fixtureA, fixtureB)) return false;
+
+	auto pBodyA = static_cast<PhysBody const *>(fixtureA->GetBody()->GetUserData());
+	auto pBodyB = static_cast<PhysBody const *>(fixtureB->GetBody()->GetUserData());
+	if(!pBodyA || !pBodyB) return true;
+
+	auto layersA = static_cast<uint16>(pBodyA->ctype);
+	auto layersB = static_cast<uint16>(pBodyB->ctype);
+	for(uint16 layers = layersA; layers; layers &= layers - 1)
+	{
+		if(ignoredLayers[std::countr_zero(layers)] & layersB) return false;
+	}
+	return true;
+}
+
+void Physics::IgnoreLayerPair(CL::ColliderLayers a, CL::ColliderLayers b)
+{
+	auto layerA = static_cast<uint16>(a);
+	auto layerB = static_cast<uint16>(b);
+	ignoredLayers[std::countr_zero(layerA)] |= layerB;
+	ignoredLayers[std::countr_zero(layerB)] |= layerA;
+}
+
+void Physics::RecordCollisionEvent(CollisionEvent const &event)
+{
+	if(bStepping)
+	{
+		collisionEvents.push_back(event);
+		return;
+	}
+
+	SendToEntity(event, event.bodyA, event.bodyB, event.fixtureA, event.fixtureB);
+	SendToEntity(event, event.bodyB, event.bodyA, event.fixtureB, event.fixtureA);
+	SendToProjectile(event, event.bodyA, event.bodyB, event.fixtureA, event.fixtureB);
+	SendToProjectile(event, event.bodyB, event.bodyA, event.fixtureB, event.fixtureA);
+}
+
+void Physics::DispatchCollisionEvents()
+{
+	// Listeners may destroy bodies, which clears them from the events still waiting
+	for(auto const &event : collisionEvents)
+	{
+		if(!event.bodyA || !event.bodyB) continue;
+		SendToEntity(event, event.bodyA, event.bodyB, event.fixtureA, event.fixtureB);
+		if(!event.bodyA || !event.bodyB) continue;
+		SendToEntity(event, event.bodyB, event.bodyA, event.fixtureB, event.fixtureA);
+	}
+
+	for(auto const &event : collisionEvents)
+	{
+		if(!event.bodyA || !event.bodyB) continue;
+		SendToProjectile(event, event.bodyA, event.bodyB, event.fixtureA, event.fixtureB);
+		if(!event.bodyA || !event.bodyB) continue;
+		SendToProjectile(event, event.bodyB, event.bodyA, event.fixtureB, event.fixtureA);
+	}
+
+	collisionEvents.clear();
+}
+
+void Physics::SendToEntity(CollisionEvent const &event, PhysBody *self, PhysBody *other, b2Fixture *selfFixture, b2Fixture *otherFixture)
+{
+	if(!self->listener) return;
+
+	using enum CollisionEventType;
+	switch(event.type)
+	{
+		case BEFORE_START:
+			self->listener->BeforeCollisionStart(selfFixture, otherFixture, self, other);
+			break;
+		case START:
+			self->listener->OnCollisionStart(selfFixture, otherFixture, self, other);
+			break;
+		case END:
+			self->listener->OnCollisionEnd(self, other);
+			break;
+	}
+}
+
+void Physics::SendToProjectile(CollisionEvent const &event, PhysBody *self, PhysBody *other, b2Fixture *selfFixture, b2Fixture *otherFixture)
+{
+	// Bodies with an entity listener don't send to their projectile one
+	if(self->listener || !self->pListener) return;
+
+	using enum CollisionEventType;
+	switch(event.type)
+	{
+		case BEFORE_START:
+			self->pListener->BeforeCollisionStart(selfFixture, otherFixture, self, other);
+			break;
+		case START:
+			self->pListener->OnCollisionStart(selfFixture, otherFixture, self, other);
+			break;
+		case END:
+			self->pListener->OnCollisionEnd(self, other);
+			break;
+	}
 }
 
 //---------------- Body Creation
 
 b2Body *Physics::CreateBody(iPoint pos, BodyType type, float angle, fPoint damping, float gravityScale, bool fixedRotation, bool bullet) const
 {
+	WaitForStep();
+
 	b2BodyDef body;
 	switch(type)
 	{
@@ -343,6 +603,38 @@ std::unique_ptr<PhysBody> Physics::CreatePhysBody(b2Body *body, iPoint width_hei
 {
 	auto pBody = std::make_unique<PhysBody>(body, width_height, cType);
 	body->SetUserData(pBody.get());
+	pBody->ResetInterpolation();
+
+	return pBody;
+}
+
+std::unique_ptr<PhysBody> Physics::CreatePhysBody(BodyArchetype const &archetype, iPoint position)
+{
+	auto body = CreateBody(
+		position + archetype.colliderOffset,
+		archetype.bodyType,
+		0.0f,
+		archetype.damping,
+		archetype.gravityScale
+	);
+
+	auto pBody = CreatePhysBody(body, archetype.size, archetype.type);
+
+	for(auto const &fixture : archetype.fixtures)
+	{
+		auto fixturePtr = body->CreateFixture(&fixture.def);
+
+		if(StrEquals(fixture.name, "ground"))
+			pBody->ground = std::make_unique<FixtureData>(fixture.name, fixturePtr);
+		else if(StrEquals(fixture.name, "top"))
+			pBody->top = std::make_unique<FixtureData>(fixture.name, fixturePtr);
+	}
+
+	if(archetype.bController)
+	{
+		pBody->controller = std::make_unique<CharacterController>(body, archetype.controllerBox);
+		AddController(pBody->controller.get());
+	}
 
 	return pBody;
 }
@@ -429,7 +721,7 @@ void Physics::DragSelectedObject()
 			app->input->GetMousePosition().y - app->render->GetCamera().y
 		};
 		mouseJoint->SetTarget(PIXEL_TO_METERS(mousePos));
-		app->render->DrawLine(
+		app->render->GetDebugDraw().AddLine(
 			mousePos,
 			METERS_TO_PIXELS(selected->GetPosition()),
 			SDL_Color(0, 255, 255, 255)
@@ -452,20 +744,13 @@ void Physics::DestroyMouseJoint()
 //--------------- Utils
 
 //---- Debug
-void Physics::DrawDebug(const b2Body *body, const int32 count, const b2Vec2 *vertices, SDL_Color color) const
+void Physics::DrawDebug(const b2Body *body, const int32 count, const b2Vec2 *vertices, SDL_Color color)
 {
-	b2Vec2 prev = body->GetWorldPoint(vertices[0]);
-	b2Vec2 v;
-
-	for (int32 i = 1; i < count; ++i)
-	{
-		v = body->GetWorldPoint(vertices[i]);
-		app->render->DrawLine(METERS_TO_PIXELS(prev), METERS_TO_PIXELS(v), color);
-		prev = v;
-	}
+	debugVertices.clear();
+	for (int32 i = 0; i < count; ++i)
+		debugVertices.push_back(METERS_TO_PIXELS(body->GetWorldPoint(vertices[i])));
 
-	v = body->GetWorldPoint(vertices[0]);
-	app->render->DrawLine(METERS_TO_PIXELS(prev), METERS_TO_PIXELS(v), color);
+	app->render->GetDebugDraw().AddPolyline(debugVertices, color, true);
 }
 
 bool Physics::IsMouseOverObject(b2Fixture const *f) const
@@ -482,7 +767,7 @@ bool Physics::IsMouseOverObject(b2Fixture const *f) const
 
 bool Physics::IsDebugActive() const
 {
-	return debug;
+	return debug && !app->budget->IsDegraded(BudgetStep::OVERLAYS);
 }
 
 //---- Position
@@ -507,11 +792,484 @@ b2Vec2 Physics::GetWorldGravity() const
 	return world->GetGravity();
 }
 
+float Physics::GetFixedStep() const
+{
+	return fixedStep;
+}
+
+float Physics::GetInterpolationAlpha() const
+{
+	// Stopped worlds only move one step at a time, so we show where they are
+	if (!stepActive) return 1.0f;
+	return accumulator / fixedStep;
+}
+
+int Physics::RayCastAll(b2Vec2 from, b2Vec2 to, b2Filter const &filter, std::vector<RayCastHit> &hits) const
+{
+	class Callback : public b2RayCastCallback
+	{
+	public:
+		Callback(b2Filter const &f, std::vector<RayCastHit> &h) : filter(f), hits(h) {}
+
+		float32 ReportFixture(b2Fixture *fixture, b2Vec2 const &point, b2Vec2 const &normal, float32 fraction) override
+		{
+			// Same test as b2ContactFilter, without groups
+			b2Filter const &other = fixture->GetFilterData();
+			if((other.categoryBits & filter.maskBits) && (other.maskBits & filter.categoryBits))
+				hits.push_back({fixture, static_cast<PhysBody *>(fixture->GetBody()->GetUserData()), point, fraction});
+
+			// Keep going, every fixture along the segment is wanted
+			return 1.0f;
+		}
+
+	private:
+		b2Filter const &filter;
+		std::vector<RayCastHit> &hits;
+	};
+
+	hits.clear();
+	if((to - from).LengthSquared() <= 0.0f) return 0;
+
+	WaitForStep();
+
+	Callback callback(filter, hits);
+	world->RayCast(&callback, from, to);
+
+	std::ranges::sort(hits, std::less<>(), &RayCastHit::fraction);
+	return static_cast<int>(hits.size());
+}
+
+//---- Spatial queries
+int Physics::RunQueries(std::span<const SpatialQuery> queries, std::span<SpatialQueryResult> results, std::span<RayCastHit> hits) const
+{
+	WaitForStep();
+
+	int written = 0;
+	for(size_t i = 0; i < queries.size() && i < results.size(); i++)
+	{
+		results[i] = {.first = written};
+		RunQuery(queries[i], results[i], hits);
+		written += results[i].count;
+	}
+	return written;
+}
+
+int Physics::QueryAABB(b2AABB const &box, uint16 mask, std::span<RayCastHit> hits, b2Body const *ignore) const
+{
+	SpatialQuery query = {.type = SpatialQueryType::AABB, .a = box.lowerBound, .b = box.upperBound, .mask = mask, .ignore = ignore};
+	SpatialQueryResult result;
+	return RunQueries({&query, 1}, {&result, 1}, hits);
+}
+
+int Physics::QueryRadius(b2Vec2 center, float radius, uint16 mask, std::span<RayCastHit> hits, b2Body const *ignore) const
+{
+	SpatialQuery query = {.type = SpatialQueryType::RADIUS, .a = center, .radius = radius, .mask = mask, .ignore = ignore};
+	SpatialQueryResult result;
+	return RunQueries({&query, 1}, {&result, 1}, hits);
+}
+
+int Physics::SegmentCast(b2Vec2 from, b2Vec2 to, uint16 mask, std::span<RayCastHit> hits, bool bClosestOnly, b2Body const *ignore) const
+{
+	SpatialQuery query = {.type = SpatialQueryType::SEGMENT, .a = from, .b = to, .mask = mask, .ignore = ignore, .bClosestOnly = bClosestOnly};
+	SpatialQueryResult result;
+	return RunQueries({&query, 1}, {&result, 1}, hits);
+}
+
+void Physics::RunQuery(SpatialQuery const &query, SpatialQueryResult &result, std::span<RayCastHit> hits) const
+{
+	// Writes the hits of the query after result.first, one per body
+	class Collector
+	{
+	public:
+		Collector(SpatialQuery const &q, SpatialQueryResult &r, std::span<RayCastHit> h) : query(q), result(r), hits(h) {}
+
+		bool Accepts(b2Fixture const *fixture) const
+		{
+			if(fixture->GetBody() == query.ignore) return false;
+			if(fixture->IsSensor() && !query.bSensors) return false;
+			return (fixture->GetFilterData().categoryBits & query.mask) != 0;
+		}
+
+		// Index of the hit of the body, -1 if it has none yet
+		int Find(b2Body const *body) const
+		{
+			for(int i = result.first; i < result.first + result.count; i++)
+			{
+				if(hits[i].fixture->GetBody() == body) return i;
+			}
+			return -1;
+		}
+
+		// False once the buffer is full
+		bool Add(b2Fixture *fixture, b2Vec2 point, float fraction)
+		{
+			if(int i = Find(fixture->GetBody()); i >= 0)
+			{
+				if(fraction < hits[i].fraction) hits[i] = {fixture, hits[i].pBody, point, fraction};
+				return true;
+			}
+			if(result.first + result.count >= static_cast<int>(hits.size()))
+			{
+				result.bTruncated = true;
+				return false;
+			}
+			hits[result.first + result.count] = {fixture, static_cast<PhysBody *>(fixture->GetBody()->GetUserData()), point, fraction};
+			result.count++;
+			return true;
+		}
+
+	private:
+		SpatialQuery const &query;
+		SpatialQueryResult &result;
+		std::span<RayCastHit> hits;
+	};
+
+	class OverlapCallback : public b2QueryCallback
+	{
+	public:
+		OverlapCallback(SpatialQuery const &q, Collector &c, b2AABB const &b) : query(q), collector(c), box(b)
+		{
+			circle.m_radius = query.radius;
+			circleTransform.Set(query.a, 0.0f);
+		}
+
+		bool ReportFixture(b2Fixture *fixture) override
+		{
+			if(!collector.Accepts(fixture)) return true;
+
+			// The broad phase only knows the fat bounds of the fixture
+			b2Body const *body = fixture->GetBody();
+			for(int32 child = 0; child < fixture->GetShape()->GetChildCount(); child++)
+			{
+				bool bOverlaps = (query.type == SpatialQueryType::AABB)
+					? b2TestOverlap(fixture->GetAABB(child), box)
+					: b2TestOverlap(fixture->GetShape(), child, &circle, 0, body->GetTransform(), circleTransform);
+				if(bOverlaps) return collector.Add(fixture, body->GetPosition(), 0.0f);
+			}
+			return true;
+		}
+
+	private:
+		SpatialQuery const &query;
+		Collector &collector;
+		b2AABB box;
+		b2CircleShape circle;
+		b2Transform circleTransform;
+	};
+
+	class SegmentCallback : public b2RayCastCallback
+	{
+	public:
+		SegmentCallback(SpatialQuery const &q, Collector &c) : query(q), collector(c) {}
+
+		float32 ReportFixture(b2Fixture *fixture, b2Vec2 const &point, b2Vec2 const &normal, float32 fraction) override
+		{
+			if(!collector.Accepts(fixture)) return -1.0f;
+			if(!collector.Add(fixture, point, fraction)) return 0.0f;
+
+			// Clipping the segment makes Box2D skip everything further away
+			return query.bClosestOnly ? fraction : 1.0f;
+		}
+
+	private:
+		SpatialQuery const &query;
+		Collector &collector;
+	};
+
+	Collector collector(query, result, hits);
+
+	switch(query.type)
+	{
+		using enum SpatialQueryType;
+		case AABB:
+		case RADIUS:
+		{
+			b2AABB box;
+			if(query.type == AABB)
+			{
+				box.lowerBound = b2Min(query.a, query.b);
+				box.upperBound = b2Max(query.a, query.b);
+			}
+			else
+			{
+				b2Vec2 extents(query.radius, query.radius);
+				box.lowerBound = query.a - extents;
+				box.upperBound = query.a + extents;
+			}
+			OverlapCallback callback(query, collector, box);
+			world->QueryAABB(&callback, box);
+			break;
+		}
+		case SEGMENT:
+		{
+			if((query.b - query.a).LengthSquared() <= 0.0f) break;
+
+			SegmentCallback callback(query, collector);
+			world->RayCast(&callback, query.a, query.b);
+
+			// A closest-only cast can still have reported further fixtures before the closest one
+			auto queryHits = hits.subspan(result.first, result.count);
+			std::ranges::sort(queryHits, std::less<>(), &RayCastHit::fraction);
+			if(query.bClosestOnly && result.count > 1) result.count = 1;
+			break;
+		}
+	}
+}
+
 //---- Destroy
-void Physics::DestroyBody(b2Body *b) const
+void Physics::DestroyBody(b2Body *b)
+{
+	if(b == nullptr) return;
+
+	WaitForStep();
+
+	// Events of the body that haven't been sent yet are dropped
+	if(auto const *pBody = static_cast<PhysBody *>(b->GetUserData()); pBody)
+	{
+		for(auto &event : collisionEvents)
+		{
+			if(event.bodyA == pBody || event.bodyB == pBody)
+				event.bodyA = event.bodyB = nullptr;
+		}
+	}
+
+	std::erase_if(controllers, [b](CharacterController const *controller) { return controller->GetBody() == b; });
+	std::erase_if(previousTransforms, [b](auto const &transform) { return transform.first->body == b; });
+	if(auto const *pBody = static_cast<PhysBody *>(b->GetUserData()); pBody)
+		app->projectiles->DropHits(pBody);
+
+	world->DestroyBody(b);
+}
+
+//---- Character controllers
+void Physics::AddController(CharacterController *controller)
+{
+	WaitForStep();
+	controllers.push_back(controller);
+}
+
+void Physics::SetCollisionGrid(CollisionGrid const *grid)
+{
+	WaitForStep();
+	collisionGrid = grid;
+}
+
+//---- Body commands
+void Physics::SetLinearVelocity(b2Body *body, b2Vec2 velocity)
+{
+	BodyCommand command = {.type = BodyCommandType::LINEAR_VELOCITY, .body = body, .value = velocity};
+	if(bStepInFlight) bodyCommands.push_back(command);
+	else ApplyBodyCommand(command);
+}
+
+void Physics::ApplyLinearImpulse(b2Body *body, b2Vec2 impulse)
+{
+	BodyCommand command = {.type = BodyCommandType::LINEAR_IMPULSE, .body = body, .value = impulse};
+	if(bStepInFlight) bodyCommands.push_back(command);
+	else ApplyBodyCommand(command);
+}
+
+void Physics::SetActive(b2Body *body, bool active)
+{
+	BodyCommand command = {.type = BodyCommandType::ACTIVE, .body = body, .active = active};
+	if(bStepInFlight) bodyCommands.push_back(command);
+	else ApplyBodyCommand(command);
+}
+
+void Physics::SetTransform(b2Body *body, b2Vec2 position, float angle)
+{
+	BodyCommand command = {.type = BodyCommandType::TRANSFORM, .body = body, .value = position, .angle = angle};
+	if(bStepInFlight) bodyCommands.push_back(command);
+	else ApplyBodyCommand(command);
+}
+
+void Physics::ApplyBodyCommand(BodyCommand const &command) const
+{
+	using enum BodyCommandType;
+	switch(command.type)
+	{
+		case LINEAR_VELOCITY:
+			command.body->SetLinearVelocity(command.value);
+			break;
+		case LINEAR_IMPULSE:
+			command.body->ApplyLinearImpulse(command.value, command.body->GetWorldCenter(), true);
+			break;
+		case ACTIVE:
+			command.body->SetActive(command.active);
+			break;
+		case TRANSFORM:
+			command.body->SetTransform(command.value, command.angle);
+			break;
+	}
+}
+
+void Physics::WaitForStep() const
 {
-	if(b != nullptr) 
-		world->DestroyBody(b);
+	// The physics thread already owns the world while it steps
+	if(std::this_thread::get_id() == physicsThread.get_id()) return;
+	if(!bStepInFlight) return;
+
+	std::unique_lock lock(stepMutex);
+	stepCondition.wait(lock, [this]() { return !bStepRequested; });
+	lock.unlock();
+
+	bStepInFlight = false;
+	for(auto const &command : bodyCommands)
+		ApplyBodyCommand(command);
+	bodyCommands.clear();
+}
+
+//---- Physics thread
+void Physics::PhysicsThreadLoop()
+{
+	std::unique_lock lock(stepMutex);
+	while(true)
+	{
+		stepCondition.wait(lock, [this]() { return bStepRequested || bQuitThread; });
+		if(bQuitThread) return;
+
+		// The main thread doesn't touch the world until bStepRequested is false again
+		lock.unlock();
+		for(int i = 0; i < pendingSteps; i++)
+		{
+			SavePreviousTransforms();
+			RunStep();
+			app->projectiles->SweepStep(fixedStep);
+		}
+		lock.lock();
+
+		bStepRequested = false;
+		stepCondition.notify_all();
+	}
+}
+
+void Physics::LaunchStep()
+{
+	app->projectiles->BeginSweep();
+	bStepInFlight = true;
+	{
+		std::scoped_lock lock(stepMutex);
+		bStepRequested = true;
+	}
+	stepCondition.notify_all();
+}
+
+void Physics::SyncThreadedStep()
+{
+	WaitForStep();
+
+	for(auto const &stats : threadedStats)
+		RecordStepStats(stats);
+	threadedStats.clear();
+
+	DispatchCollisionEvents();
+	app->projectiles->EndSweep();
+	pendingSteps = 0;
+
+	SaveSnapshot();
+}
+
+//---- Profiling
+PhysicsStepStats const &Physics::GetLastStepStats() const
+{
+	return profileHistory[(profileHead + profileWindow - 1) % profileWindow];
+}
+
+StatSummary Physics::GetStatSummary(PhysicsStat stat) const
+{
+	StatSummary summary;
+	if(profileCount == 0) return summary;
+
+	// The order of the steps doesn't matter here. The overlay asks for every stat each
+	// frame, so the buffer is reused instead of allocating one per call.
+	std::vector<float> &values = statValues;
+	values.clear();
+	for(int i = 0; i < profileCount; i++)
+		values.push_back(GetStatValue(profileHistory[i], stat));
+
+	summary.min = std::ranges::min(values);
+	summary.avg = std::accumulate(values.begin(), values.end(), 0.0f) / static_cast<float>(profileCount);
+
+	auto p99 = values.begin() + static_cast<int>(0.99f * static_cast<float>(profileCount - 1) + 0.5f);
+	std::ranges::nth_element(values, p99);
+	summary.p99 = *p99;
+
+	return summary;
+}
+
+int Physics::GetProfiledStepCount() const
+{
+	return profileCount;
+}
+
+float Physics::GetStatValue(PhysicsStepStats const &stats, PhysicsStat stat)
+{
+	using enum PhysicsStat;
+	switch(stat)
+	{
+		case STEP:				return stats.profile.step;
+		case COLLIDE:			return stats.profile.collide;
+		case SOLVE:				return stats.profile.solve;
+		case SOLVE_INIT:		return stats.profile.solveInit;
+		case SOLVE_VELOCITY:	return stats.profile.solveVelocity;
+		case SOLVE_POSITION:	return stats.profile.solvePosition;
+		case BROADPHASE:		return stats.profile.broadphase;
+		case SOLVE_TOI:			return stats.profile.solveTOI;
+		case BODIES:			return static_cast<float>(stats.bodies);
+		case AWAKE_BODIES:		return static_cast<float>(stats.awakeBodies);
+		case CONTACTS:			return static_cast<float>(stats.contacts);
+		case TOUCHING_CONTACTS:	return static_cast<float>(stats.touchingContacts);
+		case CALLBACKS:			return static_cast<float>(stats.callbacks);
+		case EVENTS:			return static_cast<float>(stats.events);
+		default:				return 0.0f;
+	}
+}
+
+std::string_view Physics::GetStatName(PhysicsStat stat)
+{
+	using enum PhysicsStat;
+	switch(stat)
+	{
+		case STEP:				return "step";
+		case COLLIDE:			return "collide";
+		case SOLVE:				return "solve";
+		case SOLVE_INIT:		return "solveInit";
+		case SOLVE_VELOCITY:	return "solveVelocity";
+		case SOLVE_POSITION:	return "solvePosition";
+		case BROADPHASE:		return "broadphase";
+		case SOLVE_TOI:			return "solveTOI";
+		case BODIES:			return "bodies";
+		case AWAKE_BODIES:		return "awakeBodies";
+		case CONTACTS:			return "contacts";
+		case TOUCHING_CONTACTS:	return "touchingContacts";
+		case CALLBACKS:			return "callbacks";
+		case EVENTS:			return "events";
+		default:				return "unknown";
+	}
+}
+
+bool Physics::DumpProfileCSV(std::string const &path) const
+{
+	std::ofstream file(path);
+	if(!file)
+	{
+		LOG("Could not open %s to save the physics profile", path.c_str());
+		return false;
+	}
+
+	constexpr auto statCount = static_cast<int>(PhysicsStat::COUNT);
+	for(int i = 0; i < statCount; i++)
+		file << GetStatName(static_cast<PhysicsStat>(i)) << (i + 1 < statCount ? ',' : '\n');
+
+	// Before the window fills up the oldest step is the first one
+	int oldest = (profileCount < profileWindow) ? 0 : profileHead;
+	for(int row = 0; row < profileCount; row++)
+	{
+		auto const &stats = profileHistory[(oldest + row) % profileWindow];
+		for(int i = 0; i < statCount; i++)
+			file << std::format("{}{}", GetStatValue(stats, static_cast<PhysicsStat>(i)), i + 1 < statCount ? ',' : '\n');
+	}
+	return true;
 }
 
 //--------------- PhysBody
@@ -528,6 +1286,19 @@ iPoint PhysBody::GetPosition() const
 	return iPoint(METERS_TO_PIXELS(body->GetPosition()));
 }
 
+iPoint PhysBody::GetInterpolatedPosition() const
+{
+	float alpha = app->physics->GetInterpolationAlpha();
+	return METERS_TO_PIXELS(previousPosition + alpha * (snapshotPosition - previousPosition));
+}
+
+void PhysBody::ResetInterpolation()
+{
+	previousPosition = body->GetPosition();
+	snapshotPosition = previousPosition;
+	snapshotVelocity = body->GetLinearVelocity();
+}
+
 float PhysBody::GetRotation() const
 {
 	return RADTODEG * body->GetAngle();
@@ -585,4 +1356,96 @@ int PhysBody::RayCast(int x1, int y1, int x2, int y2, float &normal_x, float &no
 		}
 	}
 	return -1;
-}
\ No newline at end of file
+}
+//--------------- ContactPairSet
+
+ContactPairSet::ContactPairSet()
+{
+	slots.resize(64);
+}
+
+int ContactPairSet::Add(b2Body const *a, b2Body const *b)
+{
+	// Keep the load under a half so probe chains stay short
+	if((size + 1) * 2 > slots.size()) Grow();
+
+	if(std::less<>()(b, a)) std::swap(a, b);
+	Slot &slot = slots[Find(a, b)];
+	if(slot.count == 0)
+	{
+		slot.a = a;
+		slot.b = b;
+		size++;
+	}
+	return ++slot.count;
+}
+
+int ContactPairSet::Remove(b2Body const *a, b2Body const *b)
+{
+	if(std::less<>()(b, a)) std::swap(a, b);
+	size_t i = Find(a, b);
+	if(slots[i].count == 0) return -1;
+	if(--slots[i].count > 0) return slots[i].count;
+
+	// Move back every entry after the hole that can't be found past it anymore
+	size_t mask = slots.size() - 1;
+	size_t hole = i;
+	for(size_t j = (i + 1) & mask; slots[j].count != 0; j = (j + 1) & mask)
+	{
+		size_t home = GetHomeSlot(slots[j].a, slots[j].b);
+		// Distance from home to j, and from home to the hole. The entry moves if the hole is closer.
+		if(((j - home) & mask) >= ((j - hole) & mask))
+		{
+			slots[hole] = slots[j];
+			hole = j;
+		}
+	}
+	slots[hole] = Slot();
+	size--;
+	return 0;
+}
+
+int ContactPairSet::GetCount(b2Body const *a, b2Body const *b) const
+{
+	if(std::less<>()(b, a)) std::swap(a, b);
+	return slots[Find(a, b)].count;
+}
+
+int ContactPairSet::GetSize() const
+{
+	return static_cast<int>(size);
+}
+
+void ContactPairSet::Clear()
+{
+	std::ranges::fill(slots, Slot());
+	size = 0;
+}
+
+size_t ContactPairSet::Find(b2Body const *a, b2Body const *b) const
+{
+	size_t mask = slots.size() - 1;
+	size_t i = GetHomeSlot(a, b);
+	while(slots[i].count != 0 && (slots[i].a != a || slots[i].b != b))
+		i = (i + 1) & mask;
+	return i;
+}
+
+size_t ContactPairSet::GetHomeSlot(b2Body const *a, b2Body const *b) const
+{
+	// Bodies are allocated aligned, so the low bits of the pointers carry no information
+	auto hash = static_cast<uint64>(reinterpret_cast<uintptr_t>(a)) * 0x9E3779B97F4A7C15ULL;
+	hash ^= static_cast<uint64>(reinterpret_cast<uintptr_t>(b)) + 0x632BE59BD9B4E019ULL + (hash << 6) + (hash >> 2);
+	hash ^= hash >> 32;
+	return static_cast<size_t>(hash) & (slots.size() - 1);
+}
+
+void ContactPairSet::Grow()
+{
+	std::vector<Slot> oldSlots(slots.size() * 2);
+	oldSlots.swap(slots);
+	for(auto const &slot : oldSlots)
+	{
+		if(slot.count != 0) slots[Find(slot.a, slot.b)] = slot;
+	}
+}
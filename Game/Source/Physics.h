@@ -3,14 +3,22 @@
 
 #include "Module.h"
 #include "Entity.h"
+#include "CharacterController.h"
 
 #include "Defs.h"
 #include "BitMaskColliderLayers.h"
 #include "Log.h"
 
-#include <unordered_set>
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 #include <utility>
 #include <cmath>
+#include <thread>
 #include <type_traits>
 
 #include "Box2D/Box2D/Box2D.h"
@@ -82,7 +90,7 @@ constexpr b2Vec2 PIXEL_TO_METERS(T p)
 constexpr auto DEGTORAD = 0.0174532925199432957f;
 constexpr auto RADTODEG = 57.295779513082320876f;
 
-class Projectile;
+class ProjectileManager;
 
 // if type = "circle" -> data[0] = radius
 // if type = "edge" -> data[0] = point1, data[1] = point2
@@ -218,6 +226,10 @@ public:
 
 	iPoint GetPosition() const;
 	void GetPosition(int &x, int &y) const;
+	// Position between the last two physics steps, where the body should be drawn
+	iPoint GetInterpolatedPosition() const;
+	// Forgets the previous step, so a body that was moved by hand doesn't slide to its new place
+	void ResetInterpolation();
 	float GetRotation() const;
 	bool Contains(int x, int y) const;
 	bool Contains(iPoint position) const;
@@ -227,14 +239,209 @@ public:
 	int height = 0;
 	b2Body *body = nullptr;
 	Entity *listener = nullptr;
-	Projectile *pListener = nullptr;
+	ProjectileManager *pListener = nullptr;
+	// Slot of the body in the projectile pool, -1 if it's not a projectile
+	int projectileSlot = -1;
 	CL::ColliderLayers ctype = CL::ColliderLayers::UNKNOWN;
 	std::unique_ptr<FixtureData> ground;
 	std::unique_ptr<FixtureData> top;
+	// Moves the body against the collision grid, nullptr if it collides with the tile bodies
+	std::unique_ptr<CharacterController> controller;
+	// Body position before the last physics step
+	b2Vec2 previousPosition = {0.0f, 0.0f};
+	// Body position and velocity after the last physics step. Unlike the body,
+	// they can be read while the world steps on the physics thread.
+	b2Vec2 snapshotPosition = {0.0f, 0.0f};
+	b2Vec2 snapshotVelocity = {0.0f, 0.0f};
+};
+
+// A fixture of a BodyArchetype, ready to be added to a body.
+// def.shape points to shape, which Box2D copies into every fixture made from it.
+struct FixtureArchetype
+{
+	std::unique_ptr<b2Shape> shape;
+	b2FixtureDef def;
+	// "ground" and "top" fixtures are kept in the PhysBody
+	std::string name;
+};
+
+// The body of an entity class, built once from its config.
+// Every entity of the class spawns from it without reading the config again.
+struct BodyArchetype
+{
+	BodyType bodyType = BodyType::STATIC;
+	CL::ColliderLayers type = CL::ColliderLayers::UNKNOWN;
+	float gravityScale = 1.0f;
+	fPoint damping = {0.0f, 0.01f};
+	// Body origin relative to the entity position, in pixels
+	iPoint colliderOffset = {0, 0};
+	iPoint size = {0, 0};
+	std::vector<FixtureArchetype> fixtures;
+
+	// <controller/>, see CharacterController
+	bool bController = false;
+	SDL_Rect controllerBox = {0, 0, 0, 0};
+};
+
+// Bodies that are touching, with the number of fixture contacts between them.
+// Open addressing with linear probing. Removing an entry shifts back the ones
+// after it, so lookups never have to skip deleted slots.
+class ContactPairSet
+{
+public:
+	ContactPairSet();
+
+	// Number of contacts of the pair after adding one
+	int Add(b2Body const *a, b2Body const *b);
+	// Number of contacts left after removing one, -1 if the pair was not in the set
+	int Remove(b2Body const *a, b2Body const *b);
+	int GetCount(b2Body const *a, b2Body const *b) const;
+	int GetSize() const;
+	void Clear();
+
+private:
+	struct Slot
+	{
+		b2Body const *a = nullptr;
+		b2Body const *b = nullptr;
+		int count = 0;
+	};
+
+	// Slot of the pair, or the empty one where it would go
+	size_t Find(b2Body const *a, b2Body const *b) const;
+	size_t GetHomeSlot(b2Body const *a, b2Body const *b) const;
+	void Grow();
+
+	std::vector<Slot> slots;
+	size_t size = 0;
+};
+
+enum class CollisionEventType
+{
+	BEFORE_START,
+	START,
+	END
+};
+
+// A contact change recorded during a step. Fixture A belongs to body A.
+struct CollisionEvent
+{
+	CollisionEventType type = CollisionEventType::START;
+	b2Fixture *fixtureA = nullptr;
+	b2Fixture *fixtureB = nullptr;
+	PhysBody *bodyA = nullptr;
+	PhysBody *bodyB = nullptr;
+};
+
+// A fixture crossed by a segment. fraction goes from 0 at its start to 1 at its end.
+struct RayCastHit
+{
+	b2Fixture *fixture = nullptr;
+	PhysBody *pBody = nullptr;
+	b2Vec2 point = {0.0f, 0.0f};
+	float fraction = 1.0f;
+};
+
+enum class SpatialQueryType
+{
+	// Fixtures overlapping the box from a to b
+	AABB,
+	// Fixtures overlapping the circle at a
+	RADIUS,
+	// Fixtures crossed going from a to b
+	SEGMENT
+};
+
+// A question about what's somewhere in the world, in meters.
+// Only fixtures whose category is in mask are reported, and at most one per body.
+struct SpatialQuery
+{
+	SpatialQueryType type = SpatialQueryType::AABB;
+	b2Vec2 a = {0.0f, 0.0f};
+	b2Vec2 b = {0.0f, 0.0f};
+	float radius = 0.0f;
+	uint16 mask = 0xFFFF;
+	bool bSensors = true;
+	// Usually the body asking, so it doesn't find itself
+	b2Body const *ignore = nullptr;
+	// SEGMENT only: stop at the first fixture crossed
+	bool bClosestOnly = false;
+};
+
+// Hits of a query are hits[first] .. hits[first + count], closest first for segments.
+// bTruncated is set if the hit buffer filled up before the query was done.
+struct SpatialQueryResult
+{
+	int first = 0;
+	int count = 0;
+	bool bTruncated = false;
+};
+
+enum class BodyCommandType
+{
+	LINEAR_VELOCITY,
+	LINEAR_IMPULSE,
+	ACTIVE,
+	TRANSFORM
+};
+
+// A change to a body sent while the world was stepping
+struct BodyCommand
+{
+	BodyCommandType type = BodyCommandType::LINEAR_VELOCITY;
+	b2Body *body = nullptr;
+	b2Vec2 value = {0.0f, 0.0f};
+	float angle = 0.0f;
+	bool active = true;
+};
+
+// What a step of the world cost, in milliseconds, and what it had to deal with
+struct PhysicsStepStats
+{
+	b2Profile profile = {};
+	int bodies = 0;
+	// Dynamic and kinematic bodies that are active and not sleeping
+	int awakeBodies = 0;
+	int contacts = 0;
+	int touchingContacts = 0;
+	// Calls Box2D made to the contact listener and the contact filter
+	int callbacks = 0;
+	// Collision events sent to entities and projectiles after the step
+	int events = 0;
+};
+
+enum class PhysicsStat
+{
+	STEP,
+	COLLIDE,
+	SOLVE,
+	SOLVE_INIT,
+	SOLVE_VELOCITY,
+	SOLVE_POSITION,
+	BROADPHASE,
+	SOLVE_TOI,
+	BODIES,
+	AWAKE_BODIES,
+	CONTACTS,
+	TOUCHING_CONTACTS,
+	CALLBACKS,
+	EVENTS,
+	COUNT
+};
+
+struct StatSummary
+{
+	float min = 0.0f;
+	float avg = 0.0f;
+	float p99 = 0.0f;
 };
 
 // Module --------------------------------------
-class Physics : public Module, public b2ContactListener
+// With <thread enabled="true"/> the steps of a frame run on a physics thread, from the
+// end of PostUpdate until the next PreUpdate, while the frame is drawn and presented.
+// Between PreUpdate and PostUpdate the world is idle and bodies can be used as usual.
+// Outside of it, draw from the PhysBody snapshot and change bodies with the body commands.
+class Physics : public Module, public b2ContactListener, public b2ContactFilter
 {
 public:
 
@@ -243,6 +450,7 @@ public:
 	~Physics() final;
 
 	//---------------- Main module steps
+	bool Awake(pugi::xml_node &config) final;
 	bool Start() final;
 	bool PreUpdate() final;
 	bool PostUpdate() final;
@@ -254,6 +462,8 @@ public:
 	void PreSolve(b2Contact *contact, const b2Manifold *oldManifold) final;
 	void PostSolve(b2Contact *contact, const b2ContactImpulse *impule) final;
 	void EndContact(b2Contact *contact) final;
+	// Rejects the pairs of layers that never interact before Box2D creates their contact
+	bool ShouldCollide(b2Fixture *fixtureA, b2Fixture *fixtureB) final;
 
 	//---------------- Body Creation
 
@@ -284,6 +494,9 @@ public:
 		CL::ColliderLayers cType = CL::ColliderLayers::UNKNOWN
 	) const;
 
+	// Body, fixtures and controller of the archetype, with the body origin at position + colliderOffset
+	std::unique_ptr<PhysBody> CreatePhysBody(BodyArchetype const &archetype, iPoint position);
+
 	//---------------- Create Quick Shapes
 
 	std::unique_ptr<PhysBody> CreateQuickPlatform(
@@ -320,11 +533,56 @@ public:
 	//---- World
 	void ToggleStep();
 	b2Vec2 GetWorldGravity() const;
+	// Seconds simulated by each step
+	float GetFixedStep() const;
+	// How far into the next step the render is, from 0 to 1
+	float GetInterpolationAlpha() const;
+	// Fixtures crossed by the segment that a fixture with filter would collide with, sensors included.
+	// hits is cleared and filled closest first. Returns the number of hits.
+	int RayCastAll(b2Vec2 from, b2Vec2 to, b2Filter const &filter, std::vector<RayCastHit> &hits) const;
+
+	//---- Spatial queries
+	// Runs every query, writing result i for query i and their hits one after the other.
+	// The buffers are only written, never resized: results needs one entry per query and
+	// queries that don't fit in hits are truncated. Returns the number of hits written.
+	int RunQueries(std::span<const SpatialQuery> queries, std::span<SpatialQueryResult> results, std::span<RayCastHit> hits) const;
+	// A single query. Return the number of hits.
+	int QueryAABB(b2AABB const &box, uint16 mask, std::span<RayCastHit> hits, b2Body const *ignore = nullptr) const;
+	int QueryRadius(b2Vec2 center, float radius, uint16 mask, std::span<RayCastHit> hits, b2Body const *ignore = nullptr) const;
+	int SegmentCast(b2Vec2 from, b2Vec2 to, uint16 mask, std::span<RayCastHit> hits, bool bClosestOnly = false, b2Body const *ignore = nullptr) const;
 
 	//---- Destroy
-	void DestroyBody(b2Body *b = nullptr) const;
+	// Also removes the controller of the body
+	void DestroyBody(b2Body *b = nullptr);
+
+	//---- Character controllers
+	// The controller is run after every step until its body is destroyed
+	void AddController(CharacterController *controller);
+	// Grid the controllers collide with. The map sets it when it loads.
+	void SetCollisionGrid(CollisionGrid const *grid);
+
+	//---- Body commands
+	// Queued while the world steps on the physics thread and applied when it's done, otherwise applied right away
+	void SetLinearVelocity(b2Body *body, b2Vec2 velocity);
+	void ApplyLinearImpulse(b2Body *body, b2Vec2 impulse);
+	void SetActive(b2Body *body, bool active);
+	void SetTransform(b2Body *body, b2Vec2 position, float angle);
+	// Blocks until the world is idle. Queued commands are applied, so they keep their order
+	// with the ones sent after. Creating, destroying and querying bodies call it first.
+	void WaitForStep() const;
+
+	//---- Profiling
+	// Stats of the last profileWindow steps are kept
+	PhysicsStepStats const &GetLastStepStats() const;
+	StatSummary GetStatSummary(PhysicsStat stat) const;
+	int GetProfiledStepCount() const;
+	static float GetStatValue(PhysicsStepStats const &stats, PhysicsStat stat);
+	static std::string_view GetStatName(PhysicsStat stat);
+	// One row per kept step, oldest first. Returns false if the file can't be written.
+	bool DumpProfileCSV(std::string const &path) const;
 
 	//---- Debug
+	// False while the frame budget skips overlays
 	bool IsDebugActive() const;
 
 private:
@@ -335,17 +593,62 @@ private:
 		const int32 count,
 		const b2Vec2 *vertices,
 		SDL_Color color
-	) const;
+	);
+
+	//---- Step
+	void StepWorld();
+	// A single step of the world, on whichever thread is stepping it
+	void RunStep();
+	// Keeps where every moving body is before a step, on whichever thread steps
+	void SavePreviousTransforms();
+	// Copies every moving body to its PhysBody snapshot, with where it was before the last step
+	void SaveSnapshot();
+	PhysicsStepStats MeasureStep() const;
+	void RecordStepStats(PhysicsStepStats const &stats);
+
+	//---- Physics thread
+	void PhysicsThreadLoop();
+	void LaunchStep();
+	// Waits for the steps sent last frame and sends their results
+	void SyncThreadedStep();
+	void ApplyBodyCommand(BodyCommand const &command) const;
+	void DrawWorldDebug();
+
+	//---- Collision events
+	void IgnoreLayerPair(CL::ColliderLayers a, CL::ColliderLayers b);
+	// Contact callbacks only record events while the world steps. Box2D also ends
+	// contacts when a body is destroyed, those are sent right away as the body is going.
+	void RecordCollisionEvent(CollisionEvent const &event);
+	// Every event of the step, first to the entities and then to the projectiles
+	void DispatchCollisionEvents();
+	static void SendToEntity(CollisionEvent const &event, PhysBody *self, PhysBody *other, b2Fixture *selfFixture, b2Fixture *otherFixture);
+	static void SendToProjectile(CollisionEvent const &event, PhysBody *self, PhysBody *other, b2Fixture *selfFixture, b2Fixture *otherFixture);
 
 	//---- Joints
 	void DragSelectedObject();
 	bool IsMouseOverObject(b2Fixture const *f) const;
+	// Hits are written from hits[result.first], which has to be set
+	void RunQuery(SpatialQuery const &query, SpatialQueryResult &result, std::span<RayCastHit> hits) const;
 	void DestroyMouseJoint();
 
 	// Debug mode
 	bool debug = false;
 	bool debugWhileSelected = true;
 	bool stepActive = true;
+	// Reused by DrawDebug, in pixels
+	std::vector<iPoint> debugVertices;
+
+	// Fixed timestep: real time is added to the accumulator every frame
+	// and the world steps as many times as it fits.
+	float fixedStep = 1.0f / 60.0f;
+	// Catch-up cap. Time over it is dropped, so a long frame slows the game down instead of stalling it.
+	int maxStepsPerFrame = 5;
+	float accumulator = 0.0f;
+	// Solver iterations of each step, and the ones the current steps use
+	int velocityIterations = 6;
+	int positionIterations = 2;
+	int stepVelocityIterations = 6;
+	int stepPositionIterations = 2;
 
 	// Box2D World
 	std::unique_ptr<b2World>world = nullptr;
@@ -355,7 +658,43 @@ private:
 	b2Body *selected = nullptr;
 	b2MouseJoint *mouseJoint = nullptr;
 
-	std::unordered_map<b2Body *, std::unordered_set<b2Body *>> collisionMap;
+	ContactPairSet contactPairs;
+	std::vector<CollisionEvent> collisionEvents;
+	bool bStepping = false;
+	// Bit i has the layers that layer 1 << i never collides with
+	std::array<uint16, 16> ignoredLayers = {};
+
+	// Owned by the PhysBody of their body
+	std::vector<CharacterController *> controllers;
+	// Written before each step, sent to the PhysBodies by SaveSnapshot.
+	// The main thread interpolates with previousPosition while the physics thread steps.
+	std::vector<std::pair<PhysBody *, b2Vec2>> previousTransforms;
+	CollisionGrid const *collisionGrid = nullptr;
+
+	// Profiling: ring buffer with the stats of the last steps
+	std::vector<PhysicsStepStats> profileHistory;
+	int profileWindow = 300;
+	int profileHead = 0;
+	int profileCount = 0;
+	// Scratch buffer of GetStatSummary
+	mutable std::vector<float> statValues;
+	int stepCallbacks = 0;
+	std::string profilePath = "physics_profile.csv";
+
+	// Physics thread
+	bool bThreaded = false;
+	std::thread physicsThread;
+	mutable std::mutex stepMutex;
+	mutable std::condition_variable stepCondition;
+	// Guarded by stepMutex
+	bool bStepRequested = false;
+	bool bQuitThread = false;
+	// Only used by the main thread
+	mutable bool bStepInFlight = false;
+	int pendingSteps = 0;
+	mutable std::vector<BodyCommand> bodyCommands;
+	// Stats of the steps run on the physics thread, recorded when they're sent
+	std::vector<PhysicsStepStats> threadedStats;
 };
 
 #endif // __PHYSICS_H__
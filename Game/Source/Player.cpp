@@ -4,7 +4,7 @@
 #include "Input.h"
 #include "Render.h"
 #include "Map.h"
-#include "Projectile.h"
+#include "ProjectileManager.h"
 #include "Log.h"
 #include "Physics.h"
 #include "Pathfinding.h"
@@ -35,70 +35,6 @@ Player::Player(pugi::xml_node const &itemNode = pugi::xml_node(), int newId) : C
 
 Player::~Player() = default;
 
-bool Player::LoadProjectileData()
-{
-	for(auto const &elem : parameters.children("projectile"))
-	{
-		std::vector<b2Vec2> tempData;
-		std::string shapeType = elem.attribute("shape").as_string();
-
-		if(StrEquals(shapeType, "chain") || StrEquals(shapeType, "polygon"))
-		{
-			const std::string xyStr = elem.attribute("points").as_string();
-			static const std::regex r(R"((-?\d{1,3})(?:\.\d+)*,(-?\d{1,3})(?:\.\d+)*)");
-			auto xyStrBegin = std::sregex_iterator(xyStr.begin(), xyStr.end(), r);
-			auto xyStrEnd = std::sregex_iterator();
-
-			for(std::sregex_iterator i = xyStrBegin; i != xyStrEnd; ++i)
-			{
-				std::smatch match = *i;
-				tempData.push_back(
-					{
-						PIXEL_TO_METERS(stoi(match[1].str())),
-						PIXEL_TO_METERS(stoi(match[2].str()))
-					}
-				);
-			}
-		}
-		else if(StrEquals(shapeType, "rectangle"))
-		{
-			tempData.push_back(
-				{
-					PIXEL_TO_METERS(elem.attribute("width").as_int()),
-					PIXEL_TO_METERS(elem.attribute("height").as_int())
-				}
-			);
-		}
-		else if(StrEquals(shapeType, "circle"))
-		{
-			tempData.push_back(
-				{
-					elem.attribute("radius").as_float(),
-					0
-				}
-			);
-		}
-
-		using enum CL::ColliderLayers;
-		std::string pName = elem.attribute("name").as_string();
-		projectileMap[pName] = std::make_unique<ProjectileData>(
-			ShapeData(shapeType, tempData),
-			elem.attribute("gothrough").as_bool(),
-			iPoint(
-				elem.attribute("x").as_int(),
-				elem.attribute("y").as_int()
-			),
-			iPoint(
-				elem.attribute("width").as_int(),
-				elem.attribute("height").as_int()
-			),
-			elem.attribute("speed").as_int(),
-			static_cast<ProjectileFreedom>(elem.attribute("freedom").as_uint())
-		);
-	}
-	return true;
-}
-
 bool Player::Awake()
 {
 	hp = 100;
@@ -122,18 +58,6 @@ bool Player::Awake()
 	return true;
 }
 
-bool Player::UpdateProjectiles()
-{
-	// Update Projectiles
-	for(auto it = projectiles.begin(); it < projectiles.end(); ++it)
-	{
-		if(!it->get()) continue;
-		if(it->get()->Update()) continue;
-		projectiles.erase(it);
-	}
-	return true;
-}
-
 bool Player::Update()
 {
 	if(skillCDTimer >= skillCD) skillCDTimer = 0;
@@ -141,6 +65,16 @@ bool Player::Update()
 
 	if(iFrames > 0) UpdateDamaged();
 
+	// Without tile bodies, the controller tells us when we land
+	if(pBody && pBody->controller)
+	{
+		if(b2Vec2 landingVelocity; pBody->controller->ConsumeLanding(landingVelocity))
+			Land(landingVelocity);
+
+		if(app->input->GetKey(SDL_SCANCODE_S) == KeyState::KEY_DOWN)
+			pBody->controller->DropThrough();
+	}
+
 	// If landing
 	if(bKeepMomentum)
 	{
@@ -163,13 +97,14 @@ bool Player::Update()
 	UpdateActionBooleans();
 
 	// If it's not locked, we set the texture based on priority
-	if(!bLockAnim) texture->SetCurrentAnimation(ChooseAnim());
+	if(!bLockAnim) GetAnimation()->SetCurrentAnimation(ChooseAnim());
 
+	iPoint drawPosition = pBody ? pBody->GetInterpolatedPosition() : GetPosition();
 	app->render->DrawCharacterTexture(
-		texture->UpdateAndGetFrame().get(),
-		iPoint(position.x - colliderOffset.x, position.y - colliderOffset.y),
+		GetAnimation()->UpdateAndGetFrame().get(),
+		iPoint(drawPosition.x - colliderOffset.x, drawPosition.y - colliderOffset.y),
 		(bool)dir,
-		texture->GetFlipPivot()
+		GetAnimation()->GetFlipPivot()
 	);
 
 	UpdateCamera();
@@ -193,30 +128,17 @@ void Player::BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fi
 
 			if(pBody->ground->ptr == fixtureA)
 			{
-				bLockAnim = false;
-
-				bNormalJump = false;
-				bHighJump = false;
-				bFalling = false;
-
-				bKeepMomentum = true;
-				velocityToKeep = pBody->body->GetLinearVelocity();
-				jump = {
-					.bOnAir = false,
-					.currentJumps = 0,
-					.maxJumps = jump.maxJumps,
-					.jumpImpulse = jump.jumpImpulse,
-				};
+				Land(pBody->body->GetLinearVelocity());
 			}
 			else if((pBody->top->ptr != fixtureA
 				 && pBody->ground->ptr != fixtureA
-				 && position.y < pBodyB->GetPosition().y)
-				 && (pBodyB->GetPosition().x < position.x
+				 && GetPosition().y < pBodyB->GetPosition().y)
+				 && (pBodyB->GetPosition().x < GetPosition().x
 				 && app->pathfinding->IsRightNode(pBodyB->GetPosition()))
-				 || (pBodyB->GetPosition().x > position.x
+				 || (pBodyB->GetPosition().x > GetPosition().x
 				 && app->pathfinding->IsLeftNode(pBodyB->GetPosition())))
 			{
-				texture->SetCurrentAnimation("hold");
+				GetAnimation()->SetCurrentAnimation("hold");
 				holdPosition = pBodyB->GetPosition();
 				holdPosition.y -= 10;
 				bHolding = true;
@@ -233,12 +155,14 @@ void Player::BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fi
 			break;
 		}
 		case BULLET:
-			if(pBodyB->pListener->source != ENEMIES) break;
+			if(app->projectiles->GetSource(pBodyB->projectileSlot) != ENEMIES) break;
 			[[fallthrough]];
 		case ENEMIES:
 		{
+			// Bullets hurt on contact, enemies only on the first frame of their attack
 			auto enemy = dynamic_cast<Enemy *>(pBodyB->listener);
-			if(iFrames == 0 && enemy->attackTimer == 1)
+			bool bBullet = (pBodyB->ctype == BULLET);
+			if(iFrames == 0 && (bBullet || (enemy && enemy->attackTimer == 1)))
 			{
 				if(!bGodMode)
 				{
@@ -249,21 +173,20 @@ void Player::BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fi
 				pBody->body->SetLinearVelocity(b2Vec2(0, pBody->body->GetLinearVelocity().y));
 				if(hp <= 0)
 				{
-					position.x -= 20;
-					position.y -= 10;
+					GetPosition() -= iPoint(20, 10);
 					bDead = true;
 					Disable();
-					active = true;
+					SetActive(true);
 				}
 				else
 				{
-					position.x -= 20;
-					position.y -= 10;
+					GetPosition() -= iPoint(20, 10);
 					bHurt = true;
+					iPoint hitFrom = enemy ? enemy->GetPosition() : app->projectiles->GetPosition(pBodyB->projectileSlot);
 					b2Vec2 impulse =
 					{
-						(position.x < enemy->position.x) ? -4.0f : 4.0f,
-						(position.y < enemy->position.y) ? -2.0f : -4.0f
+						(GetPosition().x < hitFrom.x) ? -4.0f : 4.0f,
+						(GetPosition().y < hitFrom.y) ? -2.0f : -4.0f
 					};
 					pBody->body->ApplyLinearImpulse(impulse, pBody->body->GetWorldCenter(), true);
 				}
@@ -283,7 +206,7 @@ void Player::BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fi
 			bLockAnim = false;
 			pBody->body->SetLinearVelocity(b2Vec2(0, pBody->body->GetLinearVelocity().y));
 			Disable();
-			active = true;
+			SetActive(true);
 			break;
 		}
 		case CHECKPOINTS:
@@ -296,6 +219,24 @@ void Player::BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fi
 	}
 }
 
+void Player::Land(b2Vec2 velocity)
+{
+	bLockAnim = false;
+
+	bNormalJump = false;
+	bHighJump = false;
+	bFalling = false;
+
+	bKeepMomentum = true;
+	velocityToKeep = velocity;
+	jump = {
+		.bOnAir = false,
+		.currentJumps = 0,
+		.maxJumps = jump.maxJumps,
+		.jumpImpulse = jump.jumpImpulse,
+	};
+}
+
 bool Player::IsOnAir() const
 {
 	return jump.bOnAir;
@@ -303,20 +244,15 @@ bool Player::IsOnAir() const
 
 bool Player::Pause() const
 {
-	if(auto tex = texture->GetCurrentTexture(); tex)
+	if(auto tex = GetAnimation()->GetCurrentTexture(); tex)
 	{
 		app->render->DrawCharacterTexture(
 			tex.get(),
-			iPoint(position.x - colliderOffset.x, position.y - colliderOffset.y),
+			iPoint(GetPosition().x - colliderOffset.x, GetPosition().y - colliderOffset.y),
 			(bool)dir,
-			texture->GetFlipPivot()
+			GetAnimation()->GetFlipPivot()
 		);
 	}
-	for(auto it = projectiles.begin(); it < projectiles.end(); ++it)
-	{
-		if(!it->get()) continue;
-		if(!it->get()->Pause()) return false;
-	}
 	return true;
 }
 
@@ -327,11 +263,6 @@ bool Player::DidChangeTile() const
 
 void Player::SpecificRestart()
 {
-	for(auto &elem: projectiles)
-		elem.reset();
-
-	projectiles.clear();
-
 	changedTile = true;
 	bMoveCamera = true;
 	skillCDTimer = 0;
@@ -373,9 +304,9 @@ pugi::xml_node Player::SaveState(pugi::xml_node const &data)
 	std::string saveData6 = "<{} {}=\"{}\" {}=\"{}\" {}=\"{}\"/>\n";
 	std::string saveFloatData = "<{} {}=\"{:.2f}\" {}=\"{:.2f}\"/>\n";
 	std::string dataToSave = "<player>\n";
-	dataToSave += AddSaveData(saveData4, "position", "x", position.x, "y", position.y);
+	dataToSave += AddSaveData(saveData4, "position", "x", GetPosition().x, "y", GetPosition().y);
 	dataToSave += AddSaveData(saveFloatData, "velocity", "x", pBody->body->GetLinearVelocity().x, "y", pBody->body->GetLinearVelocity().y);
-	dataToSave += AddSaveData(saveData4, "entity", "active", active, "disablenextupdate", disableOnNextUpdate);
+	dataToSave += AddSaveData(saveData4, "entity", "active", IsActive(), "disablenextupdate", IsStopPending());
 	dataToSave += AddSaveData(saveData4, "character", "hp", hp, "iframes", iFrames);
 	dataToSave += AddSaveData(saveData6, "jump", "onair", jump.bOnAir, "currentjumps", jump.currentJumps, "keepmomentum", bKeepMomentum);
 	dataToSave += AddSaveData(saveData2, "anim", "falling", bFalling);
@@ -383,7 +314,7 @@ pugi::xml_node Player::SaveState(pugi::xml_node const &data)
 	if(bAttackQueue)
 	{
 		dataToSave += AddSaveData(saveOpenData4, "attack", "queue", bAttackQueue, "abletomove", bAbleToMove);
-		dataToSave += AddSaveData(saveData6, "queue", "attack1", bAttack1, "attack2", bAttack2, "frame", texture->GetCurrentIndex());
+		dataToSave += AddSaveData(saveData6, "queue", "attack1", bAttack1, "attack2", bAttack2, "frame", GetAnimation()->GetCurrentIndex());
 		dataToSave += AddSaveData(saveFloatData, "dir", "x", attackDir.x, "y", attackDir.y);
 		dataToSave += "</attack>";
 	}
@@ -434,33 +365,21 @@ void Player::UpdateAnimLock()
 	// If it's attacking, wait for fifth texture before creating the projectile
 	if(bAttackQueue)
 	{
-		if(texture->GetCurrentFrame() >= 5)
+		if(GetAnimation()->GetCurrentFrame() >= 5)
 		{
-			std::unique_ptr<Projectile>projPtr;
 			if(bAttack1)
 			{
 				bAttack1 = false;
-				projPtr = std::make_unique<Projectile>(
-					texture->GetAnim("fire"),
-					iPoint(position.x + 30, position.y),
-					projectileMap["fire"],
-					attackDir
-				);
+				FireProjectile("fire", iPoint(GetPosition().x + 30, GetPosition().y), attackDir);
 			}
 			else if(bAttack2)
 			{
 				skillCDTimer++;
 				bAttack2 = false;
-				projPtr = std::make_unique<Projectile>(
-					texture->GetAnim("fire_Extra"),
-					iPoint(position.x + 30, position.y),
-					projectileMap["fire_Extra"],
-					attackDir
-				);
+				FireProjectile("fire_Extra", iPoint(GetPosition().x + 30, GetPosition().y), attackDir);
 			}
-			projectiles.push_back(std::move(projPtr));
 		}
-		else if(texture->GetAnimFinished())
+		else if(GetAnimation()->GetAnimFinished())
 		{
 			bLockAnim = false;
 			bAbleToMove = true;
@@ -479,13 +398,13 @@ void Player::UpdateDamaged()
 	// If player is dead
 	if(bDead)
 	{
-		if(texture->IsLastFrame()) texture->Pause();
+		if(GetAnimation()->IsLastFrame()) GetAnimation()->Pause();
 		if(iFrames >= 100)
 		{
 			iFrames = 0;
-			active = false;
+			SetActive(false);
 			Start();
-			active = true;
+			SetActive(true);
 			bDead = false;
 			bAbleToMove = true;
 			bLockAnim = false;
@@ -493,7 +412,7 @@ void Player::UpdateDamaged()
 		}
 	}
 	// If it's not dead and iFrame timer expired
-	else if(texture->IsAnimFinished())
+	else if(GetAnimation()->IsAnimFinished())
 	{
 		iFrames = 0;
 		bHurt = false;
@@ -552,18 +471,18 @@ void Player::UpdateJumpImpulse(b2Vec2 &impulse)
 			impulse.y = jump.jumpImpulse * -1.5f;
 			impulse.x /= 1.5f;
 			bHighJump = true;
-			texture->SetCurrentAnimation("high_Jump");
+			GetAnimation()->SetCurrentAnimation("high_Jump");
 		}
 		else
 		{
 			impulse.y = jump.jumpImpulse * -1.0f;
 			bNormalJump = true;
-			texture->SetCurrentAnimation("jump");
+			GetAnimation()->SetCurrentAnimation("jump");
 		}
 
 		// Check if it is currently jumping, if it is, restart the animation
 		if(bFalling) bFalling = false;
-		else texture->SetCurrentFrame(0);
+		else GetAnimation()->SetCurrentFrame(0);
 
 		jump.bOnAir = true;
 		jump.currentJumps++;
@@ -586,7 +505,7 @@ void Player::UpdateAttacks(b2Vec2 &impulse)
 			app->input->GetMousePosition().x - app->render->GetCamera().x,
 			app->input->GetMousePosition().y - app->render->GetCamera().y
 		};
-		attackDir = PIXEL_TO_METERS(currentMousePos - position);
+		attackDir = PIXEL_TO_METERS(currentMousePos - GetPosition());
 		bAttack1 = true;
 		bAttackQueue = true;
 		if(pBody->body->GetPosition().x > PIXEL_TO_METERS(currentMousePos.x))
@@ -605,7 +524,7 @@ void Player::UpdateAttacks(b2Vec2 &impulse)
 			app->input->GetMousePosition().x - app->render->GetCamera().x,
 			app->input->GetMousePosition().y - app->render->GetCamera().y
 		};
-		attackDir = PIXEL_TO_METERS(currentMousePos - position);
+		attackDir = PIXEL_TO_METERS(currentMousePos - GetPosition());
 		bAttack2 = true;
 		bAttackQueue = true;
 		if(pBody->body->GetPosition().x > PIXEL_TO_METERS(currentMousePos.x))
@@ -629,7 +548,7 @@ void Player::UpdateActionBooleans()
 			if(pBody->body->GetLinearVelocity().y > 0.0f)
 			{
 				bFalling = true;
-				texture->SetCurrentAnimation("short_Fall");
+				GetAnimation()->SetCurrentAnimation("short_Fall");
 			}
 		}
 		else
@@ -637,7 +556,7 @@ void Player::UpdateActionBooleans()
 			if(pBody->body->GetLinearVelocity().y > 1.0f)
 			{
 				bFalling = true;
-				texture->SetCurrentAnimation("short_Fall");
+				GetAnimation()->SetCurrentAnimation("short_Fall");
 			}
 		}
 	}
@@ -660,7 +579,7 @@ void Player::UpdateVelocity(const b2Vec2 impulse)
 {
 	if(!pBody) return;
 
-	if(bHolding && position.y >= holdPosition.y)
+	if(bHolding && GetPosition().y >= holdPosition.y)
 	{
 		pBody->body->SetGravityScale(0);
 		pBody->body->SetLinearVelocity(b2Vec2(0.0f, 0.0f));
@@ -676,15 +595,14 @@ void Player::UpdateVelocity(const b2Vec2 impulse)
 	app->scene->IncreaseBGScrollSpeed(speed.x);
 
 	// Set image position and draw character
-	position.x = METERS_TO_PIXELS(pBody->body->GetTransform().p.x);
-	position.y = METERS_TO_PIXELS(pBody->body->GetTransform().p.y);
+	ReadBody();
 
 	UpdateNewCoordinates();
 }
 
 void Player::UpdateNewCoordinates()
 {
-	if(auto currentCoords = app->map->WorldToCoordinates(position);
+	if(auto currentCoords = app->map->WorldToCoordinates(GetPosition());
 	   currentCoords != coordinates)
 	{
 		changedTile = true;
@@ -696,9 +614,9 @@ void Player::UpdateNewCoordinates()
 
 void Player::UpdateCamera()
 {
-	// Move camera
+	// Move camera. It follows the position we draw, or the player would shake on screen.
 	if(bMoveCamera)
-		app->render->AdjustCamera(position);
+		app->render->AdjustCamera(pBody ? pBody->GetInterpolatedPosition() : GetPosition());
 
 	if(app->input->GetKey(SDL_SCANCODE_M) == KeyState::KEY_DOWN)
 		bMoveCamera = !bMoveCamera;
@@ -2,7 +2,6 @@
 #define __PLAYER_H__
 
 #include "Character.h"
-#include "Projectile.h"
 #include <deque>
 #include <vector>
 
@@ -16,12 +15,13 @@ public:
 
 	bool Awake() final;
 
-	bool UpdateProjectiles() override;
-
 	bool Update() final;
 
 	void BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fixtureB, PhysBody const *pBodyA, PhysBody const *pBodyB) final;
 
+	// Resets the jumps and keeps the horizontal momentum it had while falling
+	void Land(b2Vec2 velocity);
+
 	bool IsOnAir() const;
 
 	bool Pause() const final;
@@ -35,8 +35,6 @@ public:
 	pugi::xml_node SaveState(pugi::xml_node const &data) final;
 
 private:
-	bool LoadProjectileData();
-
 	//---------- Update utils
 	b2Vec2 GetHorizontalInput();
 	void UpdateJumpImpulse(b2Vec2 &impulse);
@@ -54,9 +52,6 @@ private:
 
 	std::string playerCharacter;
 
-	std::unordered_map<std::string, std::unique_ptr<ProjectileData>, StringHash, std::equal_to<>> projectileMap;
-	std::vector<std::unique_ptr<Projectile>> projectiles;
-
 	bool bMoveCamera = true;
 
 	int skillCDTimer = 0;
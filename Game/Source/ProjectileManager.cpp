@@ -0,0 +1,526 @@
+#include "ProjectileManager.h"
+#include "App.h"
+
+#include "Physics.h"
+#include "Render.h"
+#include "Textures.h"
+#include "Map.h"
+#include "Pathfinding.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+ProjectileManager::ProjectileManager() : Module()
+{
+	name = "projectiles";
+}
+
+ProjectileManager::~ProjectileManager() = default;
+
+bool ProjectileManager::Awake(pugi::xml_node &config)
+{
+	defaultCapacity = std::max(1, config.attribute("capacity").as_int(defaultCapacity));
+
+	return true;
+}
+
+bool ProjectileManager::Start()
+{
+	// Types registered before the physics world existed get their bodies now
+	for(auto &projectileType : types)
+		CreatePool(projectileType);
+
+	bStarted = true;
+	return true;
+}
+
+bool ProjectileManager::CleanUp()
+{
+	for(auto &pBody : bodies)
+	{
+		if(pBody && pBody->body) app->physics->DestroyBody(pBody->body);
+		pBody.reset();
+	}
+
+	for(auto &projectileType : types)
+		projectileType.freeSlots.clear();
+
+	activeSlots.clear();
+	activeSwept = 0;
+	bStarted = false;
+	return true;
+}
+
+bool ProjectileManager::PostUpdate()
+{
+	// Backwards, so a finished slot can be swapped with the last one
+	for(int i = static_cast<int>(activeSlots.size()) - 1; i >= 0; i--)
+	{
+		int slot = activeSlots[i];
+
+		animTimers[slot]++;
+		if(animTimers[slot] >= frameDuration)
+		{
+			currentFrames[slot]++;
+			animTimers[slot] = 0;
+		}
+
+		if(states[slot] == ProjectileState::EXPLODING)
+		{
+			if(currentFrames[slot] >= static_cast<int>(types[slotTypes[slot]].frames.size()))
+			{
+				Release(slot);
+				activeSlots[i] = activeSlots.back();
+				activeSlots.pop_back();
+				continue;
+			}
+		}
+		else
+		{
+			// Projectiles only draw from their position, so it can follow the render
+			if(IsSwept(slot))
+			{
+				b2Vec2 previous = previousSweptPositions[slot];
+				positions[slot] = METERS_TO_PIXELS(previous + app->physics->GetInterpolationAlpha() * (sweptPositions[slot] - previous));
+			}
+			else positions[slot] = bodies[slot]->GetInterpolatedPosition();
+
+			if(currentFrames[slot] >= flyingFrames) currentFrames[slot] = 0;
+		}
+
+		Draw(slot);
+	}
+	return true;
+}
+
+bool ProjectileManager::Pause(int phase)
+{
+	for(int slot : activeSlots)
+		Draw(slot);
+
+	return true;
+}
+
+// ------ Types
+
+int ProjectileManager::AddProjectileType(std::string const &typeName, std::unique_ptr<ProjectileData> data, int capacity)
+{
+	if(auto id = GetProjectileType(typeName); id >= 0) return id;
+
+	if(!data || !data->fixPtr)
+	{
+		LOG("Projectile type %s could not be added. Fixture not found.", typeName.c_str());
+		return -1;
+	}
+
+	ProjectileType &projectileType = types.emplace_back();
+	projectileType.name = typeName;
+	projectileType.data = std::move(data);
+	projectileType.capacity = capacity > 0 ? capacity : defaultCapacity;
+	projectileType.firstSlot = static_cast<int>(states.size());
+
+	auto slotCount = states.size() + projectileType.capacity;
+	states.resize(slotCount, ProjectileState::FREE);
+	slotTypes.resize(slotCount, static_cast<int>(types.size()) - 1);
+	bodies.resize(slotCount);
+	sources.resize(slotCount, CL::ColliderLayers::UNKNOWN);
+	positions.resize(slotCount, {0, 0});
+	rotationCenters.resize(slotCount, {0, 0});
+	degrees.resize(slotCount, 0.0f);
+	flips.resize(slotCount, 0);
+	currentFrames.resize(slotCount, 0);
+	animTimers.resize(slotCount, 0);
+	sweptPositions.resize(slotCount, {0.0f, 0.0f});
+	previousSweptPositions.resize(slotCount, {0.0f, 0.0f});
+	sweptVelocities.resize(slotCount, {0.0f, 0.0f});
+	lastHits.resize(slotCount, nullptr);
+	generations.resize(slotCount, 0);
+	activeSlots.reserve(slotCount);
+
+	if(bStarted) CreatePool(projectileType);
+
+	return static_cast<int>(types.size()) - 1;
+}
+
+int ProjectileManager::GetProjectileType(std::string_view typeName) const
+{
+	auto it = std::ranges::find(types, typeName, &ProjectileType::name);
+	return it != types.end() ? static_cast<int>(std::distance(types.begin(), it)) : -1;
+}
+
+void ProjectileManager::SetProjectileFrames(int type, std::vector<std::shared_ptr<SDL_Texture>> const &frames)
+{
+	if(type < 0 || type >= static_cast<int>(types.size())) return;
+
+	ProjectileType &projectileType = types[type];
+	projectileType.frames = frames;
+	projectileType.frameHeight = 0;
+	if(!frames.empty())
+	{
+		uint tw = 0;
+		uint th = 0;
+		app->tex->GetSize(frames[0].get(), tw, th);
+		projectileType.frameHeight = static_cast<int>(th);
+	}
+}
+
+void ProjectileManager::CreatePool(ProjectileType &projectileType)
+{
+	projectileType.freeSlots.clear();
+	projectileType.freeSlots.reserve(projectileType.capacity);
+
+	// Pushed backwards, so the first slot is the first one used
+	for(int slot = projectileType.firstSlot + projectileType.capacity - 1; slot >= projectileType.firstSlot; slot--)
+	{
+		states[slot] = ProjectileState::FREE;
+		projectileType.freeSlots.push_back(slot);
+
+		auto bodyPtr = app->physics->CreateBody(iPoint(0, 0), BodyType::DYNAMIC);
+		bodyPtr->SetGravityScale(0);
+		bodyPtr->CreateFixture(projectileType.data->fixPtr.get());
+
+		// Swept projectiles never activate theirs. It follows the sweep and is
+		// the body and fixture listeners receive when the projectile hits them.
+		if(projectileType.data->motion == ProjectileMotion::SWEPT)
+			bodyPtr->GetFixtureList()->SetSensor(true);
+		else
+			bodyPtr->SetBullet(true);
+
+		auto pBody = app->physics->CreatePhysBody(bodyPtr, projectileType.data->width_height, CL::ColliderLayers::BULLET);
+		pBody->pListener = this;
+		pBody->projectileSlot = slot;
+		bodyPtr->SetActive(false);
+
+		bodies[slot] = std::move(pBody);
+	}
+}
+
+// ------ Projectiles
+
+int ProjectileManager::Fire(int type, iPoint origin, b2Vec2 direction, CL::ColliderLayers source)
+{
+	if(type < 0 || type >= static_cast<int>(types.size())) return -1;
+
+	ProjectileType &projectileType = types[type];
+	if(projectileType.frames.empty())
+	{
+		LOG("Projectile %s could not be fired. Anim not found.", projectileType.name.c_str());
+		return -1;
+	}
+	if(projectileType.freeSlots.empty()) return -1;
+
+	int slot = projectileType.freeSlots.back();
+	projectileType.freeSlots.pop_back();
+
+	ProjectileData const &data = *projectileType.data;
+
+	direction.Normalize();
+
+	SDL_Point rotationCenter = {data.position.x, data.position.y};
+	uchar flipValue = 0;
+
+	if(direction.x < 0)
+	{
+		flipValue = 2;
+
+		if(data.freedom == ProjectileFreedom::TWODIR)
+		{
+			direction.x = -0.5f;
+			direction.y = 0;
+			origin.x -= 20;
+			origin.y += 16;
+		}
+
+		if(data.position.y == 0)
+		{
+			rotationCenter.y = 0;
+			origin.y += projectileType.frameHeight;
+		}
+		else
+			rotationCenter.y = projectileType.frameHeight - rotationCenter.y;
+	}
+	else if(data.freedom == ProjectileFreedom::TWODIR)
+	{
+		direction.x = 0.5f;
+		direction.y = 0;
+		origin.x += 40;
+		origin.y += 16;
+	}
+
+	float degree = atan2f(direction.y, direction.x) * 180.0f / std::numbers::pi_v<float>;
+
+	auto s = PIXEL_TO_METERS(data.speed);
+	b2Vec2 velocity = {direction.x * s, direction.y * s};
+
+	if(data.motion == ProjectileMotion::SWEPT)
+	{
+		sweptPositions[slot] = PIXEL_TO_METERS(origin);
+		previousSweptPositions[slot] = sweptPositions[slot];
+		sweptVelocities[slot] = velocity;
+		lastHits[slot] = nullptr;
+		positions[slot] = origin;
+		activeSwept++;
+	}
+	else
+	{
+		// Hits platforms and whoever didn't shoot it
+		using enum CL::ColliderLayers;
+		PhysBody *pBody = bodies[slot].get();
+		b2Fixture *fixture = pBody->body->GetFixtureList();
+		b2Filter filter = fixture->GetFilterData();
+		filter.maskBits = static_cast<uint16>((PLAYER | ENEMIES) & ~source) | static_cast<uint16>(PLATFORMS);
+		fixture->SetFilterData(filter);
+
+		pBody->body->SetTransform(PIXEL_TO_METERS(origin), DEGTORAD * degree);
+		pBody->body->SetActive(true);
+		pBody->body->SetLinearVelocity(velocity);
+		pBody->body->SetAngularVelocity(0);
+		pBody->ResetInterpolation();
+		positions[slot] = pBody->GetInterpolatedPosition();
+	}
+
+	states[slot] = ProjectileState::FLYING;
+	generations[slot]++;
+	sources[slot] = source;
+	rotationCenters[slot] = rotationCenter;
+	degrees[slot] = degree;
+	flips[slot] = flipValue;
+	currentFrames[slot] = 0;
+	animTimers[slot] = 0;
+	activeSlots.push_back(slot);
+
+	return slot;
+}
+
+void ProjectileManager::Clear()
+{
+	for(int slot : activeSlots)
+		Release(slot);
+
+	activeSlots.clear();
+	activeSwept = 0;
+}
+
+CL::ColliderLayers ProjectileManager::GetSource(int slot) const
+{
+	if(slot < 0 || slot >= static_cast<int>(sources.size())) return CL::ColliderLayers::UNKNOWN;
+	return sources[slot];
+}
+
+iPoint ProjectileManager::GetPosition(int slot) const
+{
+	if(slot < 0 || slot >= static_cast<int>(positions.size())) return {0, 0};
+	return positions[slot];
+}
+
+int ProjectileManager::GetActiveCount() const
+{
+	return static_cast<int>(activeSlots.size());
+}
+
+void ProjectileManager::StepSwept(float step)
+{
+	if(activeSwept == 0) return;
+
+	BeginSweep();
+	SweepStep(step);
+	EndSweep();
+}
+
+void ProjectileManager::BeginSweep()
+{
+	sweeps.clear();
+	sweepHits.clear();
+	if(activeSwept == 0) return;
+
+	for(int slot : activeSlots)
+	{
+		if(states[slot] != ProjectileState::FLYING || !IsSwept(slot)) continue;
+
+		sweeps.push_back({
+			.slot = slot,
+			.generation = generations[slot],
+			.previous = previousSweptPositions[slot],
+			.position = sweptPositions[slot],
+			.velocity = sweptVelocities[slot],
+			.source = sources[slot],
+			.bGoThrough = types[slotTypes[slot]].data->fixPtr->isSensor,
+			.lastHit = lastHits[slot]
+		});
+	}
+}
+
+void ProjectileManager::SweepStep(float step)
+{
+	for(int i = 0; i < static_cast<int>(sweeps.size()); i++)
+	{
+		if(!sweeps[i].bExploded) SweepOne(i, step);
+	}
+}
+
+void ProjectileManager::EndSweep()
+{
+	// Slots that were cleared or fired again since BeginSweep keep what they have now
+	for(auto &sweep : sweeps)
+	{
+		int slot = sweep.slot;
+		if(states[slot] != ProjectileState::FLYING || generations[slot] != sweep.generation)
+		{
+			sweep.slot = -1;
+			continue;
+		}
+
+		previousSweptPositions[slot] = sweep.previous;
+		sweptPositions[slot] = sweep.position;
+		positions[slot] = METERS_TO_PIXELS(sweep.position);
+		lastHits[slot] = sweep.lastHit;
+		app->physics->SetTransform(bodies[slot]->body, sweep.position, DEGTORAD * degrees[slot]);
+		if(sweep.bExploded) Explode(slot);
+	}
+
+	// Listeners may destroy bodies, which drops them from the hits still waiting
+	for(auto const &hit : sweepHits)
+	{
+		int slot = sweeps[hit.sweep].slot;
+		if(slot < 0 || !hit.pBody || !hit.pBody->listener) continue;
+		PhysBody *self = bodies[slot].get();
+		hit.pBody->listener->BeforeCollisionStart(hit.fixture, self->body->GetFixtureList(), hit.pBody, self);
+	}
+
+	sweeps.clear();
+	sweepHits.clear();
+}
+
+void ProjectileManager::DropHits(PhysBody const *pBody)
+{
+	for(auto &hit : sweepHits)
+	{
+		if(hit.pBody == pBody) hit.pBody = nullptr;
+	}
+}
+
+void ProjectileManager::SweepOne(int index, float step)
+{
+	Sweep &sweep = sweeps[index];
+	b2Vec2 from = sweep.position;
+	b2Vec2 to = from + step * sweep.velocity;
+	sweep.previous = from;
+
+	// Tiles, in tile units
+	float tileWidth = static_cast<float>(app->map->GetTileWidth()) * METER_PER_PIXEL;
+	float tileHeight = static_cast<float>(app->map->GetTileHeight()) * METER_PER_PIXEL;
+	float end = 1.0f;
+	iPoint hitTile;
+	bool bHitTile = app->pathfinding->SegmentCast(
+		fPoint(from.x / tileWidth, from.y / tileHeight),
+		fPoint(to.x / tileWidth, to.y / tileHeight),
+		end,
+		hitTile
+	);
+	to = from + end * (to - from);
+
+	// Characters, up to the tile it hit
+	using enum CL::ColliderLayers;
+	b2Filter filter;
+	filter.categoryBits = static_cast<uint16>(BULLET);
+	filter.maskBits = static_cast<uint16>((PLAYER | ENEMIES) & ~sweep.source);
+
+	app->physics->RayCastAll(from, to, filter, hits);
+
+	// Same as a bullet body, sensors are only crossed
+	bool bGoThrough = sweep.bGoThrough;
+	auto stop = std::ranges::find_if(hits, [bGoThrough](RayCastHit const &hit) { return !bGoThrough && !hit.fixture->IsSensor(); });
+	bool bHitCharacter = (stop != hits.end());
+	if(bHitCharacter)
+	{
+		to = stop->point;
+		++stop;
+	}
+
+	sweep.position = to;
+	if(bHitCharacter) sweep.bExploded = true;
+
+	// Listeners run in EndSweep, on the main thread
+	for(auto it = hits.begin(); it != stop; ++it)
+	{
+		if(!it->pBody || it->pBody == sweep.lastHit) continue;
+		sweep.lastHit = it->pBody;
+		sweepHits.push_back({.sweep = index, .fixture = it->fixture, .pBody = it->pBody});
+	}
+
+	if(bHitCharacter) return;
+
+	// Every projectile explodes on the terrain. The ones that leave the map are gone too.
+	if(bHitTile || !app->pathfinding->IsValidPosition(app->map->WorldToCoordinates(METERS_TO_PIXELS(to))))
+		sweep.bExploded = true;
+}
+
+bool ProjectileManager::IsSwept(int slot) const
+{
+	return types[slotTypes[slot]].data->motion == ProjectileMotion::SWEPT;
+}
+
+void ProjectileManager::Explode(int slot)
+{
+	if(slot < 0 || slot >= static_cast<int>(states.size()) || states[slot] != ProjectileState::FLYING) return;
+
+	states[slot] = ProjectileState::EXPLODING;
+	animTimers[slot] = 0;
+
+	if(IsSwept(slot))
+	{
+		activeSwept--;
+		return;
+	}
+
+	// Collision events are sent after the step, so the body can leave the world right away
+	app->physics->SetActive(bodies[slot]->body, false);
+}
+
+void ProjectileManager::Release(int slot)
+{
+	if(states[slot] == ProjectileState::FREE) return;
+
+	if(states[slot] == ProjectileState::FLYING && IsSwept(slot)) activeSwept--;
+
+	// Slots are released while drawing, when the world may be stepping
+	if(auto *body = bodies[slot]->body; body)
+		app->physics->SetActive(body, false);
+
+	states[slot] = ProjectileState::FREE;
+	types[slotTypes[slot]].freeSlots.push_back(slot);
+}
+
+void ProjectileManager::Draw(int slot) const
+{
+	auto const &projectileType = types[slotTypes[slot]];
+	iPoint animOffset = projectileType.data->position;
+
+	app->render->DrawCharacterTexture(
+		projectileType.frames[currentFrames[slot]].get(),
+		iPoint(positions[slot].x - animOffset.x, positions[slot].y - animOffset.y),
+		false,
+		rotationCenters[slot],
+		iPoint(INT_MAX, INT_MAX),
+		degrees[slot],
+		flips[slot]
+	);
+}
+
+// ------ Collisions
+
+void ProjectileManager::BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fixtureB, PhysBody const *pBodyA, PhysBody const *pBodyB)
+{
+	if((pBodyB->ctype & CL::ColliderLayers::PLATFORMS) == CL::ColliderLayers::PLATFORMS)
+	{
+		OnCollisionStart(fixtureA, fixtureB, pBodyA, pBodyB);
+	}
+}
+
+void ProjectileManager::OnCollisionStart([[maybe_unused]] b2Fixture const *fixtureA, [[maybe_unused]] b2Fixture const *fixtureB, PhysBody const *pBodyA, [[maybe_unused]] PhysBody const *pBodyB)
+{
+	Explode(pBodyA->projectileSlot);
+}
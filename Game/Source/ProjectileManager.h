@@ -0,0 +1,166 @@
+#ifndef __PROJECTILEMANAGER_H__
+#define __PROJECTILEMANAGER_H__
+
+#include "Module.h"
+#include "Projectile.h"
+
+#include "Defs.h"
+#include "Point.h"
+#include "BitMaskColliderLayers.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SDL/include/SDL_rect.h"
+
+struct SDL_Texture;
+
+enum class ProjectileState : uchar
+{
+	FREE,
+	FLYING,
+	EXPLODING
+};
+
+// Every projectile in the game, from any entity.
+// Each kind of projectile gets a fixed number of slots when it's registered, and
+// every slot owns a Box2D body that is created once and kept inactive while unused.
+// Firing only moves and activates a free body, so shooting doesn't allocate.
+class ProjectileManager : public Module
+{
+public:
+	ProjectileManager();
+	~ProjectileManager() final;
+
+	bool Awake(pugi::xml_node &config) final;
+	bool Start() final;
+	// Moves, animates and draws every projectile in one pass
+	bool PostUpdate() final;
+	bool Pause(int phase) final;
+	bool CleanUp() final;
+
+	// ------ Types
+	// Returns the id of the type. A name that was already registered keeps its data.
+	// capacity 0 uses the default of the config.
+	int AddProjectileType(std::string const &name, std::unique_ptr<ProjectileData> data, int capacity = 0);
+	// -1 if no type has that name
+	int GetProjectileType(std::string_view name) const;
+	// Animation of the type: the first frames loop while it flies, the rest play once when it hits
+	void SetProjectileFrames(int type, std::vector<std::shared_ptr<SDL_Texture>> const &frames);
+
+	// ------ Projectiles
+	// Returns the slot of the projectile, -1 if every slot of the type is in use.
+	// It collides with platforms and with every character layer except the one of source.
+	int Fire(int type, iPoint origin, b2Vec2 direction, CL::ColliderLayers source);
+	// Returns every projectile to the pool
+	void Clear();
+	CL::ColliderLayers GetSource(int slot) const;
+	// Where the projectile is drawn, in pixels
+	iPoint GetPosition(int slot) const;
+	int GetActiveCount() const;
+
+	// Moves the SWEPT projectiles one physics step and sends their hits.
+	// Physics calls it after every step of the world.
+	void StepSwept(float step);
+	// The same in three parts, for the physics thread. BeginSweep copies the SWEPT
+	// projectiles, SweepStep moves the copy after each step on the physics thread,
+	// so the main thread keeps drawing them meanwhile, and EndSweep moves the
+	// projectiles to where the copy ended and sends the hits.
+	void BeginSweep();
+	void SweepStep(float step);
+	void EndSweep();
+	// Physics calls it when it destroys the body, so it's not sent a hit later
+	void DropHits(PhysBody const *pBody);
+
+	// ------ Collisions
+	void BeforeCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fixtureB, PhysBody const *pBodyA, PhysBody const *pBodyB);
+	void OnCollisionStart(b2Fixture const *fixtureA, b2Fixture const *fixtureB, PhysBody const *pBodyA, PhysBody const *pBodyB);
+	void OnCollisionEnd(PhysBody const *physA, PhysBody const *physB) const { /* Nothing to do */ };
+
+private:
+	struct ProjectileType
+	{
+		std::string name;
+		std::unique_ptr<ProjectileData> data;
+		std::vector<std::shared_ptr<SDL_Texture>> frames;
+		int frameHeight = 0;
+		// Slots firstSlot .. firstSlot + capacity belong to the type
+		int firstSlot = -1;
+		int capacity = 0;
+		std::vector<int> freeSlots;
+	};
+
+	// Creates the bodies of the slots of the type
+	void CreatePool(ProjectileType &projectileType);
+	bool IsSwept(int slot) const;
+	struct Sweep
+	{
+		int slot = -1;
+		uint generation = 0;
+		// In meters
+		b2Vec2 previous = {0.0f, 0.0f};
+		b2Vec2 position = {0.0f, 0.0f};
+		b2Vec2 velocity = {0.0f, 0.0f};
+		CL::ColliderLayers source = CL::ColliderLayers::UNKNOWN;
+		bool bGoThrough = false;
+		PhysBody const *lastHit = nullptr;
+		bool bExploded = false;
+	};
+
+	struct SweepHit
+	{
+		int sweep = -1;
+		b2Fixture *fixture = nullptr;
+		// nullptr once the body is destroyed
+		PhysBody *pBody = nullptr;
+	};
+
+	// Moves the sweep along its path until the first thing it hits
+	void SweepOne(int index, float step);
+	void Explode(int slot);
+	// Deactivates the body and gives the slot back to its type
+	void Release(int slot);
+	void Draw(int slot) const;
+
+	int defaultCapacity = 32;
+	// Frames each animation frame is shown
+	int frameDuration = 6;
+	// Frames that loop while flying, the rest is the explosion
+	int flyingFrames = 3;
+	bool bStarted = false;
+
+	std::vector<ProjectileType> types;
+
+	// ------ Slots, one entry per slot in every array
+	std::vector<ProjectileState> states;
+	std::vector<int> slotTypes;
+	std::vector<std::unique_ptr<PhysBody>> bodies;
+	std::vector<CL::ColliderLayers> sources;
+	std::vector<iPoint> positions;
+	std::vector<SDL_Point> rotationCenters;
+	std::vector<float> degrees;
+	std::vector<uchar> flips;
+	std::vector<int> currentFrames;
+	std::vector<int> animTimers;
+	// Only used by SWEPT slots, in meters
+	std::vector<b2Vec2> sweptPositions;
+	std::vector<b2Vec2> previousSweptPositions;
+	std::vector<b2Vec2> sweptVelocities;
+	// Last body the slot was sent to, so a body isn't hit again on every step it's crossed
+	std::vector<PhysBody const *> lastHits;
+	// Times the slot was fired, a sweep of an earlier shot isn't applied to it
+	std::vector<uint> generations;
+
+	// Slots in use, in no particular order
+	std::vector<int> activeSlots;
+	int activeSwept = 0;
+	// SWEPT projectiles between BeginSweep and EndSweep, and what they hit in step order
+	std::vector<Sweep> sweeps;
+	std::vector<SweepHit> sweepHits;
+	// Reused by every sweep
+	std::vector<RayCastHit> hits;
+};
+
+#endif // __PROJECTILEMANAGER_H__
@@ -16,6 +16,14 @@
 constexpr auto ticks_for_next_frame = (1000 / 60);
 constexpr auto fps_UI_seconds_interval = 1.0f;
 
+namespace
+{
+	float MillisecondsSince(uint64 counter)
+	{
+		return static_cast<float>(SDL_GetPerformanceCounter() - counter) * 1000.0f / static_cast<float>(SDL_GetPerformanceFrequency());
+	}
+}
+
 Render::Render() : Module()
 {
 	name = "render";
@@ -81,12 +89,15 @@ bool Render::Start()
 // Called each loop iteration
 bool Render::PreUpdate()
 {
-	if(!vSyncActive)
+	idleTime = 0.0f;
+	if(!vSyncActive && !bHeadless)
 	{
+		uint64 waitStart = SDL_GetPerformanceCounter();
 		while(SDL_GetTicks() - renderLastTime < ticksForNextFrame)
 		{
 			SDL_Delay(1);
 		}
+		idleTime += MillisecondsSince(waitStart);
 	}
 	
 	SDL_RenderClear(renderer.get());
@@ -133,7 +144,15 @@ bool Render::PostUpdate()
 						   background.a
 	);
 	
-	SDL_RenderPresent(renderer.get());
+	debugDraw.Flush(renderer.get(), camera, static_cast<int>(app->win->GetScale()));
+
+	if(!bHeadless)
+	{
+		uint64 presentStart = SDL_GetPerformanceCounter();
+		SDL_RenderPresent(renderer.get());
+		// With vsync, presenting waits for the display
+		if(vSyncActive) idleTime += MillisecondsSince(presentStart);
+	}
 	
 	// I -> increases fps target || O ->decreases fps target
 	if(app->input->GetKey(SDL_SCANCODE_I) == KeyState::KEY_DOWN && fpsTarget < 1000)
@@ -193,6 +212,11 @@ bool Render::CleanUp()
 	return true;
 }
 
+DebugDraw &Render::GetDebugDraw()
+{
+	return debugDraw;
+}
+
 void Render::SetBackgroundColor(SDL_Color color)
 {
 	background = color;
@@ -520,3 +544,18 @@ void Render::AdjustCamera(iPoint position)
 
 	if(camera.y > 0) camera.y = 0;
 }
+
+void Render::SetHeadless(bool headless)
+{
+	bHeadless = headless;
+}
+
+float Render::GetFrameTime() const
+{
+	return 1000.0f / static_cast<float>(fpsTarget);
+}
+
+float Render::GetIdleTime() const
+{
+	return idleTime;
+}
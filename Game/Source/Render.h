@@ -4,6 +4,7 @@
 #include "Module.h"
 #include "Defs.h"
 #include "Point.h"
+#include "DebugDraw.h"
 
 #include <memory>
 #include <functional>
@@ -103,6 +104,9 @@ public:
 		SDL_BlendMode blendMode = SDL_BlendMode::SDL_BLENDMODE_BLEND
 	) const;
 
+	// Debug shapes are drawn together on top of the frame, right before presenting it
+	DebugDraw &GetDebugDraw();
+
 	// Set background color
 	void SetBackgroundColor(SDL_Color color);
 
@@ -117,6 +121,14 @@ public:
 
 	void AdjustCamera(iPoint position);
 
+	// Headless frames are drawn but never presented, and the FPS cap doesn't wait for them
+	void SetHeadless(bool headless);
+
+	// Milliseconds each frame has at the FPS target
+	float GetFrameTime() const;
+	// Milliseconds this frame waited for the FPS cap or vsync
+	float GetIdleTime() const;
+
 private:
 
 	void SetViewPort(const SDL_Rect &rect) const;
@@ -128,6 +140,10 @@ private:
 	SDL_Color background;
 	SDL_Rect camera;
 
+	bool bHeadless = false;
+
+	DebugDraw debugDraw;
+
 	// -------- Vsync
 	bool vSyncActive = true;
 	bool vSyncOnRestart = true;
@@ -141,6 +157,8 @@ private:
 	uint32 ticksForNextFrame = 0;
 	// Last tick in which we updated render
 	uint32 renderLastTime = 0;
+	// Time waited this frame, in milliseconds
+	float idleTime = 0.0f;
 	// Remember last fps for the 30fps toggle option
 	uint32 prevFPSTarget = 0;
 	
@@ -8,6 +8,7 @@
 #include "Player.h"
 #include "Textures.h"
 #include "Input.h"
+#include "FrameBudget.h"
 
 #include "Defs.h"
 #include "Point.h"
@@ -98,6 +99,9 @@ bool UI::PostUpdate()
 		DrawPlayerAnimation(pTopLeft);
 	}
 
+	// The profile is an overlay too, the frame budget may skip it
+	if(bDrawPhysicsProfile && !app->budget->IsDegraded(BudgetStep::OVERLAYS)) DrawPhysicsProfile(pTopLeft);
+
 	DrawPlayerHP(pBottomLeft);
 	DrawPlayerSkill(pBottomRight);
 
@@ -109,6 +113,9 @@ bool UI::PostUpdate()
 	if(app->input->GetKey(SDL_SCANCODE_F3) == KeyState::KEY_DOWN)
 		bDrawUI = !bDrawUI;
 
+	if(app->input->GetKey(SDL_SCANCODE_F4) == KeyState::KEY_DOWN)
+		bDrawPhysicsProfile = !bDrawPhysicsProfile;
+
 	return true;
 }
 
@@ -120,8 +127,8 @@ void UI::DrawPlayerHP(iPoint &position)
 		auto const &player = app->entityManager->player;
 		if(player->bHurt)
 		{
-			auto frame = (player->texture->GetFloatCurrentFrame() != 0) ? player->texture->GetFloatCurrentFrame() : static_cast<float>(player->texture->GetFrameCount());
-			auto lastFrame = static_cast<float>(player->texture->GetFrameCount());
+			auto frame = (player->GetAnimation()->GetFloatCurrentFrame() != 0) ? player->GetAnimation()->GetFloatCurrentFrame() : static_cast<float>(player->GetAnimation()->GetFrameCount());
+			auto lastFrame = static_cast<float>(player->GetAnimation()->GetFrameCount());
 			auto decrease = static_cast<int>(frame / lastFrame * static_cast<float>(player->damageTaken));
 			int originalHP = player->hp + player->damageTaken;
 			int hpToDraw = originalHP - decrease;
@@ -209,7 +216,7 @@ void UI::DrawPlayerSkill(iPoint &position) const
 {
 	const auto &player = app->entityManager->player;
 
-	auto tex = (player->skillCDTimer == 0) ? player->texture->GetAnimationByName("skill") : player->texture->GetAnimationByName("skill_CD");
+	auto tex = (player->skillCDTimer == 0) ? player->GetAnimation()->GetAnimationByName("skill") : player->GetAnimation()->GetAnimationByName("skill_CD");
 	
 	if(!tex) return;
 
@@ -261,6 +268,28 @@ void UI::DrawFPS(iPoint &position) const
 	position.y += IncreaseY(fCleanCraters);
 }
 
+void UI::DrawPhysicsProfile(iPoint &position) const
+{
+	app->fonts->Draw(
+		std::format("Physics, last {} steps: min / avg / p99", app->physics->GetProfiledStepCount()),
+		position,
+		fCleanCraters
+	);
+	position.y += IncreaseY(fCleanCraters);
+
+	for(int i = 0; i < static_cast<int>(PhysicsStat::COUNT); i++)
+	{
+		auto stat = static_cast<PhysicsStat>(i);
+		auto [min, avg, p99] = app->physics->GetStatSummary(stat);
+		// Times are in milliseconds, the rest are counts
+		auto text = (stat < PhysicsStat::BODIES) ?
+			std::format("{}: {:.3f} / {:.3f} / {:.3f} ms", app->physics->GetStatName(stat), min, avg, p99) :
+			std::format("{}: {:.0f} / {:.1f} / {:.0f}", app->physics->GetStatName(stat), min, avg, p99);
+		app->fonts->Draw(text, position, fCleanCraters);
+		position.y += IncreaseY(fCleanCraters);
+	}
+}
+
 void UI::DrawGravity(iPoint &position) const
 {
 	app->fonts->Draw(
@@ -281,8 +310,8 @@ void UI::DrawPlayerPosition(iPoint &position) const
 	app->fonts->Draw(
 		std::format(
 			"Player position: \"{},{}\"",
-			app->entityManager->player->position.x,
-			app->entityManager->player->position.y
+			app->entityManager->player->GetPosition().x,
+			app->entityManager->player->GetPosition().y
 		),
 		position,
 		fCleanCraters
@@ -352,7 +381,7 @@ void UI::DrawPlayerAnimation(iPoint &position) const
 	position.y += IncreaseY(fCleanCraters);
 	app->fonts->Draw(std::format("Locked Animation: {}", player->bLockAnim ? "Yes." : "No."), position, fCleanCraters);
 	position.y += IncreaseY(fCleanCraters);
-	const auto &velocity = (player->pBody) ? player->pBody->body->GetLinearVelocity() : b2Vec2(0,0);
+	const auto &velocity = player->GetVelocity();
 	app->fonts->Draw(std::format("Current Veloicty: {:.1f}, {:.1f}", velocity.x, velocity.y), position, fCleanCraters);
 }
 
@@ -4,6 +4,7 @@
 #include "Module.h"
 #include "Entity.h"
 #include "Player.h"
+#include "Render.h"
 
 #include "Defs.h"
 #include "Point.h"
@@ -90,6 +91,7 @@ private:
 	void DrawSaving(iPoint &position);
 	void DrawSavingCheck(iPoint &position);
 	void DrawPlayerSkill(iPoint &position) const;
+	void DrawPhysicsProfile(iPoint &position) const;
 
 	int IncreaseY(int font) const;
 
@@ -99,6 +101,7 @@ private:
 	int laps = 0;
 
 	bool bDrawUI = false;
+	bool bDrawPhysicsProfile = false;
 	bool bSavingGame = false;
 	bool bDrawPause = false;
 	int fCleanCraters = 0;